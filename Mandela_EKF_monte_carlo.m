@@ -0,0 +1,90 @@
+% Monte Carlo campaign of the "Mandela EKF" experiment of Mandela_EKF_native_engine.m: n_runs
+% independent truth + EKF runs with different sensor noise and initial mismatches of the EKF,
+% run in parallel by the compiled engine (mandela_ekf_engine, compile it once with make_mandela_ekf.m).
+% Every run has its own counter-based random number stream, so the results are reproducible for a
+% given seed, whatever the number of threads. The per-run summaries are also written to a csv file
+% as the runs finish.
+
+% Authors: Krishnakumar Gopalakrishnan, Davide M. Raimondo
+% License: MIT License
+
+%% Basic settings for MATLAB IDE, plotting, numerical display etc.
+clear;clc; format short g; format compact;
+close all;
+set(0,'defaultaxesfontsize',12,'defaultaxeslinewidth',2,'defaultlinelinewidth',2.5,'defaultpatchlinewidth',2,'DefaultFigureWindowStyle','docked');
+
+%% Constant Model Parameters for this chemical reactor
+model_params.alpha_1    = 1.3708e12/3600; % kg/gmol/s
+model_params.E1_over_R  = 9.2984e3;       % K
+model_params.alpha_m1   = 1.6215e20/3600; % 1/s
+model_params.Em1_over_R = 1.3108e4;       % K
+model_params.alpha_2    = 5.2282e12/3600; % kg g/mol/s
+model_params.E2_over_R  = 9.5999e3;       % K
+model_params.K1         = 2.575e-16;      % gmol/kg  (appears only in algebaric equations)
+model_params.K2         = 4.876e-14;      % gmol/kg  (appears only in algebaric equations)
+model_params.K3         = 1.7884e-16;     % gmol/kg  (appears only in algebaric equations)
+model_params.Q_plus     = 0.0131;         % gmol/kg  (appears only in algebaric equations)
+
+%% User-entered data: Simulation Conditions and campaign settings
+load time_profile; load Temp_profile; % Load the apriori available input (Temperature (degC) vs time(sec)) profile for he given chemical reactor problem
+Ts = 60;
+t0 = 0;          % initial time at start of simulation [sec]
+tf = 0.35*3600;  % simulation end time [sec]
+n_diff = 6; n_alg = 4;
+
+campaign.n_runs              = 200;
+campaign.seed                = 1;
+campaign.n_threads           = 0;     % 0: one thread per core
+campaign.batched             = 1;     % step the EKFs of 8 runs together (vectorised covariance update)
+campaign.enable_sensor_noise = 1;
+campaign.X_init_ekf_std      = 0.02*[1.6;8.3;0;0;0;0.0014];  % random initial mismatch of the EKF around X_init_ekf
+campaign.tf                  = tf;
+campaign.output_file         = 'mandela_ekf_monte_carlo.csv';
+
+%% EKF and truth plant (as in Mandela_EKF_native_engine.m)
+ekf_config.model_params = model_params;
+ekf_config.Ts           = Ts;
+ekf_config.t0           = t0;
+ekf_config.Q            = diag(0.001*ones(1,n_diff))/Ts;
+ekf_config.ProcessNoise = 'continuous';
+ekf_config.R            = 0.0001;
+ekf_config.output_index = n_diff+3;
+ekf_config.P_EKF        = diag([0.004*ones(1,n_diff) zeros(1,n_alg)]);
+ekf_config.X_init_ekf   = [1.6;8.3;0;0;0;0.0014];
+ekf_config.time_profile = time_profile;
+ekf_config.Temp_profile = Temp_profile;
+
+plant_config.model_params = model_params;
+plant_config.Ts           = Ts;
+plant_config.t0           = t0;
+plant_config.X_init       = [1.5776;8.32;0;0;0;0.00142];
+plant_config.time_profile = time_profile;
+plant_config.Temp_profile = Temp_profile;
+plant_config.enable_process_noise = 1;
+
+campaign.ekf_config   = ekf_config;
+campaign.plant_config = plant_config;
+clear ekf_config plant_config model_params time_profile Temp_profile;
+
+%% Run the campaign
+tic;
+summary = mandela_ekf_monte_carlo_mex(campaign);
+toc;
+
+ok = summary(:,2) == 0;
+rmse = summary(ok,4:3+n_diff);
+mean_nees = summary(ok,4+n_diff);
+fprintf('%d of %d runs successful\n',nnz(ok),campaign.n_runs);
+fprintf('median RMSE of x_0 ... x_%d: %s\n',n_diff-1,mat2str(median(rmse,1),4));
+fprintf('average NEES: %g (%d for a consistent filter)\n',mean(mean_nees),n_diff);
+
+%% Plot the distributions of the RMSE of x_0 and of the NEES
+figure(1);clf;
+histogram(rmse(:,1));
+xlabel('RMSE of x_0'); ylabel('no. of runs'); title('Monte Carlo: RMSE of x_0');
+figure(2);clf;
+histogram(mean_nees);
+xlabel('time-averaged NEES'); ylabel('no. of runs'); title('Monte Carlo: NEES');
+clear ok;
+
+% vim: set nospell nowrap textwidth=0 wrapmargin=0 formatoptions-=t:
@@ -0,0 +1,157 @@
+% This code runs the same "Mandela EKF" experiment as Mandela_EKF_using_alg_measurement.m,
+% but the EKF itself (prediction, gain, update, re-projection of the algebraic
+% variables and covariance update) runs in the compiled engine in the folder
+% mandela_ekf_engine (compile it once with make_mandela_ekf.m).
+% The "truth" plant (same model and pseudo white process noise as in the original script) is
+% simulated by the compiled plant of the engine. The plant and the EKF each own an IDA instance
+% that lives for the whole simulation: the plant is never re-initialised, and the EKF only after
+% its measurement updates (the original script calls IDAInit for both at every sample, since
+% sundialsTB has a single IDA instance).
+
+% Authors: Krishnakumar Gopalakrishnan, Davide M. Raimondo
+% License: MIT License
+
+%% Basic settings for MATLAB IDE, plotting, numerical display etc.
+% NOTE: In this problem statement/code, 'X', 'Z' etc. are vectors, whereas 'x' , 'z' etc. represent scalar quantities
+clear;clc; format short g; format compact;
+close all;
+set(0,'defaultaxesfontsize',12,'defaultaxeslinewidth',2,'defaultlinelinewidth',2.5,'defaultpatchlinewidth',2,'DefaultFigureWindowStyle','docked');
+
+%% Constant Model Parameters for this chemical reactor
+model_params.alpha_1    = 1.3708e12/3600; % kg/gmol/s
+model_params.E1_over_R  = 9.2984e3;       % K
+model_params.alpha_m1   = 1.6215e20/3600; % 1/s
+model_params.Em1_over_R = 1.3108e4;       % K
+model_params.alpha_2    = 5.2282e12/3600; % kg g/mol/s
+model_params.E2_over_R  = 9.5999e3;       % K
+model_params.K1         = 2.575e-16;      % gmol/kg  (appears only in algebaric equations)
+model_params.K2         = 4.876e-14;      % gmol/kg  (appears only in algebaric equations)
+model_params.K3         = 1.7884e-16;     % gmol/kg  (appears only in algebaric equations)
+model_params.Q_plus     = 0.0131;         % gmol/kg  (appears only in algebaric equations)
+
+%% User-entered data: Simulation Conditions
+load time_profile; load Temp_profile; % Load the apriori available input (Temperature (degC) vs time(sec)) profile for he given chemical reactor problem
+Ts = 60; % How often is simulation results needed ?
+enable_sensor_noise = 1;
+enable_process_noise = 1;
+
+% Specify simulation interval
+t0 = 0;          % initial time at start of simulation [sec]
+tf = 0.35*3600;  % simulation end time [sec]
+
+n_diff = 6; n_alg  = 4; % no. of differential and algebraic variables in this DAE problem
+
+X_init_truth = [1.5776;8.32;0;0;0;0.00142]; % Vector representing initial values of differential states (init, i.e. at time t=0)
+
+% Define absolute and relative tolerances for time-stepping solver (IDA)
+opt_IDA.AbsTol = 1e-6;
+opt_IDA.RelTol = 1e-6;
+
+user_data_struct.n_diff = n_diff;
+n_outputs = length(outputFunction_only_algebraic_vars(zeros(n_diff+n_alg,1),user_data_struct));
+
+%% EKF parameterisation & initialisation (in the compiled engine)
+ekf_config.model_params = model_params;
+ekf_config.Ts           = Ts;
+ekf_config.t0           = t0;
+ekf_config.Q            = diag(0.001*ones(1,n_diff))/Ts;   % Tuning parameters of the EKF (continuous-time intensity, i.e. Qd is approx. Gamma*Q*Gamma'*Ts)
+ekf_config.ProcessNoise = 'continuous';                    % 'discrete': Gamma*Q*Gamma' per sample as in the original script (use Q without the /Ts)
+ekf_config.Covariance   = 'full';                          % 'reduced': propagate only the n_diff-by-n_diff covariance of X, P = Gamma*P_xx*Gamma'
+ekf_config.R            = diag(0.0001*ones(n_outputs,1));  % Tuning parameters of the EKF
+ekf_config.MeasurementUpdate = 'simultaneous';             % 'sequential': one scalar update per output (R whitened with chol(R))
+ekf_config.Transition   = 'expm';                          % 'sensitivity': phi_EKF from the IDAS sensitivities of the prediction instead of expm(A_aug_EKF*Ts)
+ekf_config.RelinRelTol  = 0;                               % lazy relinearisation: re-use phi_EKF/Gamma_EKF while abs(XZ-XZ_lin) <= RelinRelTol*abs(XZ_lin)+RelinAbsTol
+ekf_config.RelinAbsTol  = 0;                               % (and T within RelinInputTol degC); 0: relinearise at every sample
+ekf_config.RelinInputTol = 0;
+ekf_config.output_index = n_diff+3;                        % same measured variable as in outputFunction_only_algebraic_vars
+ekf_config.P_EKF        = diag([0.004*ones(1,n_diff) zeros(1,n_alg)]);
+ekf_config.X_init_ekf   = [1.6;8.3;0;0;0;0.0014];
+ekf_config.time_profile = time_profile;
+ekf_config.Temp_profile = Temp_profile;
+ekf_config.RelTol       = opt_IDA.RelTol;
+ekf_config.AbsTol       = opt_IDA.AbsTol;
+
+ekf_handle = mandela_ekf_mex('new',ekf_config);
+XZ_EKF_t_local_finish = mandela_ekf_mex('get',ekf_handle);
+
+estimated_state_vars_EKF_stored = nan(n_diff,ceil(tf/Ts));
+estimated_state_vars_EKF_stored(:,1) = XZ_EKF_t_local_finish(1:n_diff);
+
+%% True plant initialisation (in the compiled engine)
+plant_config.model_params = model_params;
+plant_config.Ts           = Ts;
+plant_config.t0           = t0;
+plant_config.X_init       = X_init_truth;
+plant_config.time_profile = time_profile;
+plant_config.Temp_profile = Temp_profile;
+plant_config.enable_process_noise = enable_process_noise;
+plant_config.ProcessNoise = 'pseudo_white';   % 'piecewise_constant': random noise per bin of NoiseBinWidth sec, reproducible under adaptive stepping
+plant_config.Q            = diag([1e-6*ones(1,4) 0 0]); % intensity of the 'piecewise_constant' noise (the pseudo white noise acts on the first four states)
+plant_config.NoiseBinWidth = Ts;
+plant_config.RelTol       = opt_IDA.RelTol;
+plant_config.AbsTol       = opt_IDA.AbsTol;
+
+plant_handle = batch_reactor_plant_mex('new',plant_config);
+XZ_truth_t_local_finish = batch_reactor_plant_mex('get',plant_handle);
+clear X_init_truth plant_config;
+
+state_vars_truth_results_stored = nan(n_diff,ceil(tf/Ts));
+state_vars_truth_results_stored(:,1) = XZ_truth_t_local_finish(1:n_diff);
+
+t_local_finish = t0 + Ts;
+sim_time_vector = nan(ceil(tf/Ts),1);
+sim_time_vector(1) = t0;
+clear t0;
+
+%% Time-stepper code
+k = 1;      % iteration number (sample number)
+
+while (t_local_finish < tf)
+    XZ_truth_t_local_finish = batch_reactor_plant_mex('advance',plant_handle,t_local_finish);
+
+    state_vars_truth_results_stored(:,k+1) = XZ_truth_t_local_finish(1:n_diff);
+
+    measured_outputs = outputFunction_only_algebraic_vars(XZ_truth_t_local_finish,user_data_struct);
+    if enable_sensor_noise == 1
+        measured_outputs = measured_outputs + chol(ekf_config.R)*randn(n_outputs,1); % Measurements are corrupted by zero mean, gaussian noise
+    end
+
+    %% EKF step (compiled)
+    T_degC_at_t_local_finish = interp1(time_profile,Temp_profile,t_local_finish);  % Temperature at current time, t (degC)
+    XZ_EKF_t_local_finish = mandela_ekf_mex('step',ekf_handle,measured_outputs,T_degC_at_t_local_finish);
+    estimated_state_vars_EKF_stored(:,k+1) = XZ_EKF_t_local_finish(1:n_diff);
+
+    %% Prepare for next iteration
+    sim_time_vector(k+1) = t_local_finish;
+    k = k + 1;
+
+    t_local_finish = t_local_finish + Ts;
+end
+
+relin_stats = mandela_ekf_mex('stats',ekf_handle);
+fprintf('%d of %d samples re-used the last linearisation\n',relin_stats.n_reused_linearisations, ...
+    relin_stats.n_reused_linearisations + relin_stats.n_relinearisations - 1);
+mandela_ekf_mex('delete',ekf_handle);
+batch_reactor_plant_mex('delete',plant_handle);
+clear ekf_handle plant_handle relin_stats ekf_config model_params opt_IDA time_profile Temp_profile user_data_struct;
+clear t_local_finish measured_outputs k enable_process_noise;
+clear XZ_truth_t_local_finish XZ_EKF_t_local_finish T_degC_at_t_local_finish;
+
+%% Plot truth and estimated results
+close all;
+for plot_no = 1:n_diff
+    figure(plot_no);clf;
+    plot(sim_time_vector/3600,state_vars_truth_results_stored(plot_no,:),'s-','linewidth',1.5);hold on;
+    plot(sim_time_vector/3600,estimated_state_vars_EKF_stored(plot_no,:),'kx-','linewidth',2.5);
+    hold off;
+    label_str = ['State Variable x_' num2str(plot_no-1)];
+    xlabel('Time [hours]'); ylabel(label_str);xlim([0 tf/3600]);
+    title(['Sim result: ' label_str]);axis square;
+    legend('truth','Mandela EKF (native)','location','best');
+end
+
+% Adjust figure properties to match the graph reported in paper
+figure(1); ylim([0.7 1.6]); xlim([0 0.35]);shg;
+clear plot_no label_str;
+
+% vim: set nospell nowrap textwidth=0 wrapmargin=0 formatoptions-=t:
@@ -0,0 +1,84 @@
+% Estimator service for many reactor vessels: one native Mandela EKF per reactor, all fed from one
+% named pipe. The samples that arrive while a batch is processed are queued and processed together
+% as the next batch, with the reactors of a batch in parallel. Run Mandela_EKF_service_replay.m in a
+% second MATLAB session (e.g. matlab -batch Mandela_EKF_service_replay) as the plants: it writes the
+% samples of n_reactors simulated reactors at the pace of the sampling interval. POSIX only.
+
+% Authors: Krishnakumar Gopalakrishnan, Davide M. Raimondo
+% License: MIT License
+
+%% Basic settings for MATLAB IDE, plotting, numerical display etc.
+clear;clc; format short g; format compact;
+close all;
+set(0,'defaultaxesfontsize',12,'defaultaxeslinewidth',2,'defaultlinelinewidth',2.5,'defaultpatchlinewidth',2,'DefaultFigureWindowStyle','docked');
+
+%% Constant Model Parameters for this chemical reactor
+model_params.alpha_1    = 1.3708e12/3600; % kg/gmol/s
+model_params.E1_over_R  = 9.2984e3;       % K
+model_params.alpha_m1   = 1.6215e20/3600; % 1/s
+model_params.Em1_over_R = 1.3108e4;       % K
+model_params.alpha_2    = 5.2282e12/3600; % kg g/mol/s
+model_params.E2_over_R  = 9.5999e3;       % K
+model_params.K1         = 2.575e-16;      % gmol/kg  (appears only in algebaric equations)
+model_params.K2         = 4.876e-14;      % gmol/kg  (appears only in algebaric equations)
+model_params.K3         = 1.7884e-16;     % gmol/kg  (appears only in algebaric equations)
+model_params.Q_plus     = 0.0131;         % gmol/kg  (appears only in algebaric equations)
+
+%% User-entered data: Simulation Conditions and service
+load time_profile; load Temp_profile; % Load the apriori available input (Temperature (degC) vs time(sec)) profile for he given chemical reactor problem
+Ts = 60;
+t0 = 0;          % initial time at start of simulation [sec]
+n_diff = 6; n_alg = 4;
+
+service_config.input        = '/tmp/mandela_ekf_service_samples';  % named pipe shared with Mandela_EKF_service_replay.m
+service_config.output       = 'mandela_ekf_service_estimates.txt';
+service_config.max_reactors = 1000;  % reactor ids 0..999
+service_config.n_threads    = 0;     % 0: one per hardware thread
+service_config.idle_timeout = 60;    % give up if the plants are silent for a minute [sec]
+
+%% EKF parameterisation & initialisation of every reactor (as in Mandela_EKF_native_engine.m)
+ekf_config.model_params = model_params;
+ekf_config.Ts           = Ts;
+ekf_config.t0           = t0;
+ekf_config.Q            = diag(0.001*ones(1,n_diff))/Ts;
+ekf_config.ProcessNoise = 'continuous';
+ekf_config.R            = 0.0001;
+ekf_config.output_index = n_diff+3;
+ekf_config.P_EKF        = diag([0.004*ones(1,n_diff) zeros(1,n_alg)]);
+ekf_config.X_init_ekf   = [1.6;8.3;0;0;0;0.0014];
+ekf_config.time_profile = time_profile;
+ekf_config.Temp_profile = Temp_profile;
+service_config.ekf_config = ekf_config;
+clear ekf_config model_params time_profile Temp_profile;
+
+%% Serve until the plants send 'end' (blocks until Mandela_EKF_service_replay.m opens the pipe)
+if ~exist(service_config.input,'file')
+    system(['mkfifo ' service_config.input]);
+end
+disp('Waiting for the samples of Mandela_EKF_service_replay.m ...');
+[timing,summary] = mandela_ekf_service_mex(service_config);
+
+fprintf('%d samples of %d reactors in %d batches, %d dropped, %d failed\n',summary.n_samples,summary.n_reactors,size(timing,1),summary.n_dropped,summary.n_failed);
+fprintf('batch: median %.0f samples, %.0f us; latency: max %.0f us\n',median(timing(:,1)),median(timing(:,3)),summary.max_latency_us);
+
+%% Plot the batch sizes and timing, and the estimates of the first reactors
+estimates = load(service_config.output);  % id t status XZ' sqrt(diag(P))' latency_us
+figure(1);clf;
+subplot(2,1,1); plot(timing(:,1),'x'); ylabel('samples per batch');
+subplot(2,1,2); plot(timing(:,3),'x',timing(:,4),'s'); ylabel('[\mus]'); xlabel('batch');
+legend('processing','max. latency','location','best');
+figure(2);clf;hold on;
+if exist('mandela_ekf_service_truth.mat','file')
+    truth = load('mandela_ekf_service_truth.mat');
+end
+for id = 0:min(3,max(estimates(:,1)))
+    e = estimates(estimates(:,1) == id,:);
+    h = plot(e(:,2)/3600,e(:,4),'x-');
+    if exist('truth','var')
+        plot(truth.t/3600,squeeze(truth.X(1,:,id+1)),'--','color',get(h,'color'),'linewidth',1.5);
+    end
+end
+hold off;
+xlabel('Time [hours]'); ylabel('State Variable x_0'); title('Service estimates (x) and truth (--) of the first reactors');
+
+% vim: set nospell nowrap textwidth=0 wrapmargin=0 formatoptions-=t:
@@ -0,0 +1,85 @@
+% Stand-in for the plants of Mandela_EKF_service.m: simulates n_reactors batch reactors
+% (batch_reactor_plant_mex) from scattered initial states and, at every sampling instant, writes
+% one sample "id t T_degC y" per reactor to the named pipe read by the estimator service, at the
+% pace of the sampling interval divided by speedup. Run it in a second MATLAB session once
+% Mandela_EKF_service.m is waiting for the samples. The truth is saved to
+% mandela_ekf_service_truth.mat for comparison.
+
+% Authors: Krishnakumar Gopalakrishnan, Davide M. Raimondo
+% License: MIT License
+
+%% Basic settings for MATLAB IDE, numerical display etc.
+clear;clc; format short g; format compact;
+
+%% Constant Model Parameters for this chemical reactor
+model_params.alpha_1    = 1.3708e12/3600; % kg/gmol/s
+model_params.E1_over_R  = 9.2984e3;       % K
+model_params.alpha_m1   = 1.6215e20/3600; % 1/s
+model_params.Em1_over_R = 1.3108e4;       % K
+model_params.alpha_2    = 5.2282e12/3600; % kg g/mol/s
+model_params.E2_over_R  = 9.5999e3;       % K
+model_params.K1         = 2.575e-16;      % gmol/kg  (appears only in algebaric equations)
+model_params.K2         = 4.876e-14;      % gmol/kg  (appears only in algebaric equations)
+model_params.K3         = 1.7884e-16;     % gmol/kg  (appears only in algebaric equations)
+model_params.Q_plus     = 0.0131;         % gmol/kg  (appears only in algebaric equations)
+
+%% User-entered data: Simulation Conditions and replay
+load time_profile; load Temp_profile; % Load the apriori available input (Temperature (degC) vs time(sec)) profile for he given chemical reactor problem
+Ts = 60;
+t0 = 0;          % initial time at start of simulation [sec]
+tf = 0.35*3600;  % simulation end time [sec]
+n_diff = 6;
+n_reactors = 100;         % reactor ids 0..n_reactors-1 (< max_reactors of the service)
+output_index = n_diff+3;  % measured variable, as in the EKF
+R = 0.0001;               % sensor noise covariance
+enable_sensor_noise = 1;
+speedup = 60;             % 60: one sampling instant per second
+pipe_name = '/tmp/mandela_ekf_service_samples';
+
+%% Truth plants (as in Mandela_EKF_native_engine.m, with scattered initial states)
+plant_config.model_params = model_params;
+plant_config.Ts           = Ts;
+plant_config.t0           = t0;
+plant_config.time_profile = time_profile;
+plant_config.Temp_profile = Temp_profile;
+plant_config.enable_process_noise = 1;
+X_init = [1.5776;8.32;0;0;0;0.00142];
+plant_handles = zeros(1,n_reactors);
+for id = 1:n_reactors
+    plant_config.X_init = X_init.*(1 + 0.02*randn(n_diff,1));
+    plant_handles(id) = batch_reactor_plant_mex('new',plant_config);
+end
+clear plant_config model_params;
+
+%% Replay: the samples of all the reactors of an instant in one write
+if ~exist(pipe_name,'file')
+    system(['mkfifo ' pipe_name]);
+end
+fid = fopen(pipe_name,'w');
+t = t0 + Ts:Ts:tf-1e-9;
+X = nan(n_diff,length(t),n_reactors);
+replay_start = tic;
+for k = 1:length(t)
+    T_degC = interp1(time_profile,Temp_profile,t(k));
+    lines = cell(1,n_reactors);
+    for id = 1:n_reactors
+        XZ = batch_reactor_plant_mex('advance',plant_handles(id),t(k));
+        X(:,k,id) = XZ(1:n_diff);
+        y = XZ(output_index);
+        if enable_sensor_noise == 1
+            y = y + chol(R)*randn(size(y));
+        end
+        lines{id} = sprintf('%d %.6f %.6f%s\n',id-1,t(k),T_degC,sprintf(' %.17g',y));
+    end
+    pause(max(0,(k-1)*Ts/speedup - toc(replay_start)));  % real-time pace
+    fprintf(fid,'%s',[lines{:}]);
+end
+fprintf(fid,'end\n');
+fclose(fid);
+for id = 1:n_reactors
+    batch_reactor_plant_mex('delete',plant_handles(id));
+end
+save('mandela_ekf_service_truth.mat','t','X');
+clear fid k id XZ y lines T_degC plant_handles replay_start time_profile Temp_profile;
+
+% vim: set nospell nowrap textwidth=0 wrapmargin=0 formatoptions-=t:
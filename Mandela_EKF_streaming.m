@@ -0,0 +1,87 @@
+% Real-time ("streaming") run of the native Mandela EKF: the estimator reads timestamped
+% temperature and measurement samples from a named pipe, updates on their arrival and publishes
+% every estimate (with its latency) to a file or pipe. Run Mandela_EKF_stream_replay.m in a second
+% MATLAB session (e.g. matlab -batch Mandela_EKF_stream_replay) as the plant: it writes the samples
+% of a simulated truth at the pace of the sampling interval. POSIX (Linux, macOS) only.
+
+% Authors: Krishnakumar Gopalakrishnan, Davide M. Raimondo
+% License: MIT License
+
+%% Basic settings for MATLAB IDE, plotting, numerical display etc.
+clear;clc; format short g; format compact;
+close all;
+set(0,'defaultaxesfontsize',12,'defaultaxeslinewidth',2,'defaultlinelinewidth',2.5,'defaultpatchlinewidth',2,'DefaultFigureWindowStyle','docked');
+
+%% Constant Model Parameters for this chemical reactor
+model_params.alpha_1    = 1.3708e12/3600; % kg/gmol/s
+model_params.E1_over_R  = 9.2984e3;       % K
+model_params.alpha_m1   = 1.6215e20/3600; % 1/s
+model_params.Em1_over_R = 1.3108e4;       % K
+model_params.alpha_2    = 5.2282e12/3600; % kg g/mol/s
+model_params.E2_over_R  = 9.5999e3;       % K
+model_params.K1         = 2.575e-16;      % gmol/kg  (appears only in algebaric equations)
+model_params.K2         = 4.876e-14;      % gmol/kg  (appears only in algebaric equations)
+model_params.K3         = 1.7884e-16;     % gmol/kg  (appears only in algebaric equations)
+model_params.Q_plus     = 0.0131;         % gmol/kg  (appears only in algebaric equations)
+
+%% User-entered data: Simulation Conditions and streams
+load time_profile; load Temp_profile; % Load the apriori available input (Temperature (degC) vs time(sec)) profile for he given chemical reactor problem
+Ts = 60;
+t0 = 0;          % initial time at start of simulation [sec]
+n_diff = 6; n_alg = 4;
+
+stream_config.input        = '/tmp/mandela_ekf_samples';   % named pipe shared with Mandela_EKF_stream_replay.m
+stream_config.output       = 'mandela_ekf_stream_estimates.txt';
+stream_config.deadline     = 0.05;  % latency budget per sample [sec]
+stream_config.idle_timeout = 60;    % give up if the plant is silent for a minute [sec]
+stream_config.checkpoint   = 'mandela_ekf_stream.ckpt';    % EKF state, for a restart with mandela_ekf_mex('load',...)
+stream_config.checkpoint_interval = 10;  % samples
+resume = false;  % true: continue from the checkpoint of an interrupted run instead of X_init_ekf
+
+%% EKF parameterisation & initialisation (as in Mandela_EKF_native_engine.m)
+ekf_config.model_params = model_params;
+ekf_config.Ts           = Ts;
+ekf_config.t0           = t0;
+ekf_config.Q            = diag(0.001*ones(1,n_diff))/Ts;
+ekf_config.ProcessNoise = 'continuous';
+ekf_config.R            = 0.0001;
+ekf_config.output_index = n_diff+3;
+ekf_config.P_EKF        = diag([0.004*ones(1,n_diff) zeros(1,n_alg)]);
+ekf_config.X_init_ekf   = [1.6;8.3;0;0;0;0.0014];
+ekf_config.time_profile = time_profile;
+ekf_config.Temp_profile = Temp_profile;
+ekf_handle = mandela_ekf_mex('new',ekf_config);
+if resume
+    mandela_ekf_mex('load',ekf_handle,stream_config.checkpoint);
+end
+clear ekf_config model_params time_profile Temp_profile;
+
+%% Run until the plant sends 'end' (blocks until Mandela_EKF_stream_replay.m opens the pipe)
+if ~exist(stream_config.input,'file')
+    system(['mkfifo ' stream_config.input]);
+end
+disp('Waiting for the samples of Mandela_EKF_stream_replay.m ...');
+[timing,summary] = mandela_ekf_mex('stream',ekf_handle,stream_config);
+mandela_ekf_mex('delete',ekf_handle);
+clear ekf_handle;
+
+fprintf('%d samples, %d dropped, %d above the deadline of %g ms\n',summary.n_samples,summary.n_dropped,summary.n_deadline_misses,1000*stream_config.deadline);
+fprintf('latency: median %.0f us, max %.0f us; EKF step: median %.0f us\n',median(timing(:,3)),summary.max_latency_us,median(timing(:,4)));
+
+%% Plot the per-step timing and the published estimates against the truth of the replay
+estimates = load(stream_config.output);  % t status XZ' sqrt(diag(P))' latency_us
+figure(1);clf;
+plot(timing(:,1)/3600,timing(:,3),'s-',timing(:,1)/3600,timing(:,4),'x-');
+xlabel('Time [hours]'); ylabel('[\mus]'); legend('latency','EKF step','location','best');
+title('Per-sample timing of the streaming EKF');
+figure(2);clf;
+plot(estimates(:,1)/3600,estimates(:,3),'kx-');hold on;
+if exist('mandela_ekf_stream_truth.mat','file')
+    truth = load('mandela_ekf_stream_truth.mat');
+    plot(truth.t/3600,truth.X(1,:),'s-','linewidth',1.5);
+    legend('Mandela EKF (streaming)','truth','location','best');
+end
+hold off;
+xlabel('Time [hours]'); ylabel('State Variable x_0'); title('Streaming estimate of x_0');
+
+% vim: set nospell nowrap textwidth=0 wrapmargin=0 formatoptions-=t:
@@ -0,0 +1,100 @@
+% Q/R/P0 tuning sweep of the "Mandela EKF" experiment of Mandela_EKF_native_engine.m: a grid of
+% candidate process noise, measurement noise and initial covariances is evaluated in parallel by
+% the compiled engine (mandela_ekf_engine, compile it once with make_mandela_ekf.m) against one
+% recorded truth trajectory. Candidates whose running cost exceeds the best cost found so far are
+% aborted early.
+
+% Authors: Krishnakumar Gopalakrishnan, Davide M. Raimondo
+% License: MIT License
+
+%% Basic settings for MATLAB IDE, plotting, numerical display etc.
+clear;clc; format short g; format compact;
+close all;
+set(0,'defaultaxesfontsize',12,'defaultaxeslinewidth',2,'defaultlinelinewidth',2.5,'defaultpatchlinewidth',2,'DefaultFigureWindowStyle','docked');
+
+%% Constant Model Parameters for this chemical reactor
+model_params.alpha_1    = 1.3708e12/3600; % kg/gmol/s
+model_params.E1_over_R  = 9.2984e3;       % K
+model_params.alpha_m1   = 1.6215e20/3600; % 1/s
+model_params.Em1_over_R = 1.3108e4;       % K
+model_params.alpha_2    = 5.2282e12/3600; % kg g/mol/s
+model_params.E2_over_R  = 9.5999e3;       % K
+model_params.K1         = 2.575e-16;      % gmol/kg  (appears only in algebaric equations)
+model_params.K2         = 4.876e-14;      % gmol/kg  (appears only in algebaric equations)
+model_params.K3         = 1.7884e-16;     % gmol/kg  (appears only in algebaric equations)
+model_params.Q_plus     = 0.0131;         % gmol/kg  (appears only in algebaric equations)
+
+%% User-entered data: Simulation Conditions and tuning grid
+load time_profile; load Temp_profile; % Load the apriori available input (Temperature (degC) vs time(sec)) profile for he given chemical reactor problem
+Ts = 60;
+t0 = 0;          % initial time at start of simulation [sec]
+tf = 0.35*3600;  % simulation end time [sec]
+n_diff = 6; n_alg = 4;
+
+q_grid  = logspace(-5,-1,9);   % Q = diag(q*ones(1,n_diff))/Ts (continuous-time intensity)
+r_grid  = logspace(-6,-2,9);   % R = r
+p0_grid = [0.0004 0.004 0.04]; % P_EKF = diag([p0*ones(1,n_diff) zeros(1,n_alg)])
+
+sweep.tf                  = tf;
+sweep.seed                = 1;
+sweep.n_threads           = 0;     % 0: one thread per core
+sweep.enable_sensor_noise = 1;
+sweep.sensor_R            = 0.0001; % sensor noise of the recorded measurements
+sweep.cost_weights        = 1./[1.6;8.3;0.1;0.1;0.1;0.01].^2; % squared errors relative to the typical magnitude of each state
+
+%% EKF and truth plant (as in Mandela_EKF_native_engine.m)
+ekf_config.model_params = model_params;
+ekf_config.Ts           = Ts;
+ekf_config.t0           = t0;
+ekf_config.Q            = diag(0.001*ones(1,n_diff))/Ts;
+ekf_config.ProcessNoise = 'continuous';
+ekf_config.R            = 0.0001;
+ekf_config.output_index = n_diff+3;
+ekf_config.P_EKF        = diag([0.004*ones(1,n_diff) zeros(1,n_alg)]);
+ekf_config.X_init_ekf   = [1.6;8.3;0;0;0;0.0014];
+ekf_config.time_profile = time_profile;
+ekf_config.Temp_profile = Temp_profile;
+
+plant_config.model_params = model_params;
+plant_config.Ts           = Ts;
+plant_config.t0           = t0;
+plant_config.X_init       = [1.5776;8.32;0;0;0;0.00142];
+plant_config.time_profile = time_profile;
+plant_config.Temp_profile = Temp_profile;
+plant_config.enable_process_noise = 1;
+
+sweep.ekf_config   = ekf_config;
+sweep.plant_config = plant_config;
+clear ekf_config plant_config model_params time_profile Temp_profile;
+
+%% Candidates: all combinations of the grids
+[q,r,p0] = ndgrid(q_grid,r_grid,p0_grid);
+n_candidates = numel(q);
+sweep.Q     = zeros(n_diff,n_diff,n_candidates);
+sweep.R     = zeros(1,1,n_candidates);
+sweep.P_EKF = zeros(n_diff+n_alg,n_diff+n_alg,n_candidates);
+for c = 1:n_candidates
+    sweep.Q(:,:,c)     = diag(q(c)*ones(1,n_diff))/Ts;
+    sweep.R(:,:,c)     = r(c);
+    sweep.P_EKF(:,:,c) = diag([p0(c)*ones(1,n_diff) zeros(1,n_alg)]);
+end
+
+%% Run the sweep
+tic;
+[results,best] = mandela_ekf_tuning_mex(sweep);
+toc;
+
+fprintf('%d candidates, %d aborted early, %d failed\n',n_candidates,nnz(results(:,4)),nnz(results(:,1)));
+fprintf('best: Q = %g*I/Ts, R = %g, P0 = %g*I (cost %g)\n',q(best),r(best),p0(best),results(best,3));
+
+%% Plot the costs of the finished candidates over the (q, r) grid, for the best P0
+cost = reshape(results(:,3),size(q));
+cost(reshape(results(:,4) ~= 0 | results(:,1) ~= 0,size(q))) = NaN;
+[~,~,k] = ind2sub(size(q),best);
+figure(1);clf;
+contourf(log10(q_grid),log10(r_grid),log10(cost(:,:,k)).');
+colorbar; xlabel('log_{10} q'); ylabel('log_{10} r');
+title(sprintf('log_{10} cost of the finished candidates, P0 = %g*I',p0_grid(k)));
+clear c k;
+
+% vim: set nospell nowrap textwidth=0 wrapmargin=0 formatoptions-=t:
@@ -37,6 +37,9 @@ load time_profile; load Temp_profile; % Load the apriori available input (Temper
 Ts = 60; % How often is simulation results needed ?
 enable_sensor_noise = 1;
 enable_process_noise = 1;
+ekf_covariance_form = 'full'; % 'full': propagate P_EKF itself, 'square_root': propagate its Cholesky factor through QR (qr1) of pre-arrays (needs matrix_factorisations_mex_fileexchg on the path)
+algebraic_solver = 'native'; % 'native': safeguarded scalar Newton solver of the algebraic equations (algebraic_equations_mex, needs mandela_ekf_engine on the path), 'fsolve': fsolve on all four equations
+ekf_linearisation_backend = 'casadi_function'; % 'casadi_function': evaluate the EKF Jacobians through CasADi's Function call interface, 'compiled': generated C code with an LU solve of gz, loaded as a shared library (needs ekf_linearisation_codegen on the path and a C compiler)
 
 % Specify simulation interval
 t0 = 0;          % initial time at start of simulation [sec]
@@ -47,20 +50,20 @@ n_inputs = 1;           % no. of input variables
 % n_outputs = 1;          % no. of output variables
 
 X_init_truth = [1.5776;8.32;0;0;0;0.00142]; % Vector representing initial values of differential states (init, i.e. at time t=0)
-Z_init_guess = zeros(n_alg,1);  % user's initial guess for algebraic variables (this will be refined by fsolve before time-stepping)
+Z_init_guess = zeros(n_alg,1);  % user's initial guess for algebraic variables (this will be refined by solve_algebraic_equations before time-stepping)
 
 % Define absolute and relative tolerances for time-stepping solver (IDA)
 opt_IDA.AbsTol = 1e-6;
 opt_IDA.RelTol = 1e-6;
 
-% 'fsolve' is used to solve the system of algebraic equations (g(x,z) = 0) and obtain the algebraic variables by keeping the differential variables constant at their latest values.
+% 'fsolve' (or its native replacement, see algebraic_solver) is used to solve the system of algebraic equations (g(x,z) = 0) and obtain the algebraic variables by keeping the differential variables constant at their latest values.
 opt_fsolve             = optimset;
 opt_fsolve.Display     = 'off';
 opt_fsolve.FunValCheck = 'on';
 % opt_fsolve.TolX      = 1e-6;
 % opt_fsolve.TolFun    = 1e-6;
 
-[Z_init_truth_fsolve_refined,~,~,~,~] = fsolve(@algebraicEquations,Z_init_guess,opt_fsolve,X_init_truth,model_params);
+Z_init_truth_fsolve_refined = solve_algebraic_equations(Z_init_guess,X_init_truth,model_params,algebraic_solver,opt_fsolve);
 
 %% Set up a few other required settings
 id = [ones(n_diff,1);zeros(n_alg,1)]; % 1-> differential variables, 0-> algebraic variables. % Tell IDA how to identify the algebraic and differential variables in the combined XZ (differential+algebraic state) vector.
@@ -105,11 +108,11 @@ fz = jacobian(sym_rhs_stateeqn,XZsym(n_diff+1:end)); % B_EKF
 
 A_aug_EKF_symbolic = [fx fz; -inv(gz)*gx*fx -inv(gz)*gx*fz];
 A_aug_EKF_fcn = Function('A_Mandela_EKF',{XZsym,Usym},{A_aug_EKF_symbolic}); % This function will later enable numerical evaluation of the appropriate symbolic Jacobian for a given set of differential and algebraic variables.. This helps in variable name correspondence
-clear fx fz A_aug_EKF_symbolic;
+clear A_aug_EKF_symbolic;
 
 Gamma_bottom_EKF_symbolic = -inv(gz)*gx;
 Gamma_bottom_EKF_fcn = Function('Gamma_bottom_Mandela_EKF',{XZsym,Usym},{Gamma_bottom_EKF_symbolic});
-clear Usym gx gz Gamma_bottom_EKF_symbolic;
+clear Gamma_bottom_EKF_symbolic;
 
 sym_h_vector_ekf = outputFunction_only_algebraic_vars(XZsym,user_data_struct);
 n_outputs = length(sym_h_vector_ekf);
@@ -119,7 +122,21 @@ clear sym_h_vector_ekf;
 H_aug_EKF_symbolic = sym_Jac_ekf_h_wrt_XZ;
 clear sym_Jac_ekf_h_wrt_XZ;
 H_aug_EKF_fcn = Function('H_aug_EKF',{XZsym},{H_aug_EKF_symbolic});
-clear XZsym dXZ_dt_sym H_aug_EKF_symbolic sym_Jac_ekf_h_wrt_XZ;
+
+ekf_linearisation.n_diff = n_diff;
+ekf_linearisation.n_alg = n_alg;
+ekf_linearisation.n_outputs = n_outputs;
+if strcmp(ekf_linearisation_backend,'compiled')
+    % fx, fz, gx, gz and H are generated as one C function (with shared subexpressions), and inv(gz) is replaced by an LU solve in mandela_ekf_linearisation.c
+    ekf_jacobians_fcn = Function('mandela_ekf_jacobians',{XZsym,Usym},{densify(fx),densify(fz),densify(gx),densify(gz),densify(H_aug_EKF_symbolic)});
+    ekf_linearisation.library_name = build_ekf_linearisation_library(ekf_jacobians_fcn);
+    clear ekf_jacobians_fcn;
+else
+    ekf_linearisation.A_aug_EKF_fcn = A_aug_EKF_fcn;
+    ekf_linearisation.Gamma_bottom_EKF_fcn = Gamma_bottom_EKF_fcn;
+    ekf_linearisation.H_aug_EKF_fcn = H_aug_EKF_fcn;
+end
+clear XZsym dXZ_dt_sym Usym fx fz gx gz H_aug_EKF_symbolic sym_Jac_ekf_h_wrt_XZ;
 
 %% Set initial time for simulation time-stepping and prepare for time-stepping of the true model that produces "experimental" data
 t_local_start = t0;
@@ -131,9 +148,14 @@ Q = diag(0.001*ones(1,n_diff));         % Tuning parameters of the EKF
 R = diag(0.0001*ones(n_outputs,1)); % Tuning parameters of the EKF
 P_EKF = diag([0.004*ones(1,n_diff) zeros(1,n_alg)]);
 % P_EKF = diag([0.004*ones(1,n_diff) 0.000001*ones(1,n_alg)]);
+if strcmp(ekf_covariance_form,'square_root')
+    S_EKF = diag(sqrt(diag(P_EKF))); % upper triangular factor, P_EKF = S_EKF'*S_EKF (P_EKF is diagonal here, and singular, so chol cannot be used)
+    chol_Q = chol(Q);
+    chol_R = chol(R);
+end
 
 X_init_ekf = [1.6;8.3;0;0;0;0.0014];
-[Z_init_ekf_fsolve_refined,~,~,~,~] = fsolve(@algebraicEquations,Z_init_guess,opt_fsolve,X_init_ekf,model_params);
+Z_init_ekf_fsolve_refined = solve_algebraic_equations(Z_init_guess,X_init_ekf,model_params,algebraic_solver,opt_fsolve);
 
 XZ_EKF_t_local_finish = [X_init_ekf;Z_init_ekf_fsolve_refined]; % initial value of augmented vector
 clear X_init_ekf Z_init_ekf_fsolve_refined Z_init_guess;
@@ -179,9 +201,9 @@ sim_time_vector(1) = t0;
 T_degC_init = interp1(time_profile,Temp_profile,t0);  % Temperature at time t (degC)  % For time-stepping by IDA (or even by IDACalcIC), a symbolic 'U' is not acceptable.
 clear t0;
 
-A_aug_EKF = full(A_aug_EKF_fcn(XZ_EKF_t_local_finish,T_degC_init));
+[A_aug_EKF,Gamma_bottom_EKF] = evaluate_ekf_linearisation(XZ_EKF_t_local_finish,T_degC_init,ekf_linearisation);
 phi_EKF = expm(A_aug_EKF*Ts);
-Gamma_EKF = [eye(n_diff);full(Gamma_bottom_EKF_fcn(XZ_EKF_t_local_finish,T_degC_init))];
+Gamma_EKF = [eye(n_diff);Gamma_bottom_EKF];
 
 k = 1;      % iteration number (sample number)
 
@@ -210,22 +232,32 @@ while (t_local_finish < tf)
     
     T_degC_at_t_local_finish = interp1(time_profile,Temp_profile,t_local_finish);  % Temperature at current time, t (degC)
     
-    P_EKF = phi_EKF*P_EKF*phi_EKF' + Gamma_EKF*Q*Gamma_EKF'; % This line is definitely within the loop
-    
-    H_aug_EKF_at_present_oppoint = full(H_aug_EKF_fcn(XZ_EKF_t_local_finish));
-    K_aug_EKF = P_EKF*H_aug_EKF_at_present_oppoint'*inv(H_aug_EKF_at_present_oppoint*P_EKF*H_aug_EKF_at_present_oppoint' + R);
-    XZ_EKF_t_local_finish = XZ_EKF_t_local_finish + K_aug_EKF*(measured_outputs - outputFunction_only_algebraic_vars(XZ_EKF_t_local_finish,user_data_struct));
+    H_aug_EKF_at_present_oppoint = evaluate_ekf_output_jacobian(XZ_EKF_t_local_finish,T_degC_at_t_local_finish,ekf_linearisation);
+    if strcmp(ekf_covariance_form,'square_root')
+        S_EKF = srekf_time_update(S_EKF,phi_EKF,Gamma_EKF,chol_Q);
+        [S_EKF,K_aug_EKF] = srekf_measurement_update(S_EKF,H_aug_EKF_at_present_oppoint,chol_R); % S_EKF is already the factor of the updated covariance
+    else
+        P_EKF = phi_EKF*P_EKF*phi_EKF' + Gamma_EKF*Q*Gamma_EKF'; % This line is definitely within the loop
+        K_aug_EKF = P_EKF*H_aug_EKF_at_present_oppoint'*inv(H_aug_EKF_at_present_oppoint*P_EKF*H_aug_EKF_at_present_oppoint' + R);
+    end
+    dXZ_EKF_update = K_aug_EKF*(measured_outputs - outputFunction_only_algebraic_vars(XZ_EKF_t_local_finish,user_data_struct));
+    if strcmp(algebraic_solver,'native')
+        dXZ_EKF_update(n_diff+1:end) = Gamma_bottom_EKF*dXZ_EKF_update(1:n_diff); % warm start of the algebraic solver: predicted Z plus Gamma_bottom*dX
+    end
+    XZ_EKF_t_local_finish = XZ_EKF_t_local_finish + dXZ_EKF_update;
     estimated_state_vars_EKF_stored(:,k+1) = XZ_EKF_t_local_finish(1:n_diff);
     
-    [XZ_EKF_t_local_finish(n_diff+1:end),~,~,~,~] = fsolve(@algebraicEquations,XZ_EKF_t_local_finish(n_diff+1:end),opt_fsolve,estimated_state_vars_EKF_stored(:,k+1),model_params);
+    XZ_EKF_t_local_finish(n_diff+1:end) = solve_algebraic_equations(XZ_EKF_t_local_finish(n_diff+1:end),estimated_state_vars_EKF_stored(:,k+1),model_params,algebraic_solver,opt_fsolve);
+    [A_aug_EKF,Gamma_bottom_EKF] = evaluate_ekf_linearisation(XZ_EKF_t_local_finish,T_degC_at_t_local_finish,ekf_linearisation); % Gamma_bottom is needed here, A_aug_EKF (same operating point) for the next prediction
     dXZ_dt_EKF_t_local_finish = -1*(batchChemReactorModel_IDA(0,XZ_EKF_t_local_finish,[zeros(n_diff,1);XZ_EKF_t_local_finish(n_diff+1:end)],user_data_struct));
-    dXZ_dt_EKF_t_local_finish(n_diff+1:end) = full(Gamma_bottom_EKF_fcn(XZ_EKF_t_local_finish,T_degC_at_t_local_finish))*dXZ_dt_EKF_t_local_finish(1:n_diff);
+    dXZ_dt_EKF_t_local_finish(n_diff+1:end) = Gamma_bottom_EKF*dXZ_dt_EKF_t_local_finish(1:n_diff);
     
-    P_EKF = (eye(n_diff+n_alg) - K_aug_EKF*H_aug_EKF_at_present_oppoint)*P_EKF;
+    if strcmp(ekf_covariance_form,'full')
+        P_EKF = (eye(n_diff+n_alg) - K_aug_EKF*H_aug_EKF_at_present_oppoint)*P_EKF;
+    end
     
-    A_aug_EKF = full(A_aug_EKF_fcn(XZ_EKF_t_local_finish,T_degC_at_t_local_finish));
     phi_EKF = expm(A_aug_EKF*Ts);
-    Gamma_EKF = [eye(n_diff);full(Gamma_bottom_EKF_fcn(XZ_EKF_t_local_finish,T_degC_at_t_local_finish))];
+    Gamma_EKF = [eye(n_diff);Gamma_bottom_EKF];
     
     %% Prepare for next iteration
     sim_time_vector(k+1) = t_local_finish;
@@ -248,7 +280,9 @@ clear time_profile Temp_profile user_data_struct;
 clear t_local_start t_local_finish;
 clear ans Q R ida_options_struct measured_outputs;
 clear k XZ_truth_t_local_finish true_model_outputs T_degC_at_t_local_finish K_aug_EKF;
-clear A_aug_EKF phi_EKF Gamma_EKF P_EKF H_aug_EKF_at_present_oppoint;
+clear A_aug_EKF phi_EKF Gamma_EKF Gamma_bottom_EKF P_EKF H_aug_EKF_at_present_oppoint;
+clear ekf_linearisation_backend ekf_linearisation algebraic_solver dXZ_EKF_update;
+clear ekf_covariance_form S_EKF chol_Q chol_R;
 
 %% Plot truth and estimated results
 close all;
@@ -287,6 +321,69 @@ flag     = 0;
 new_data = [];
 end
 
+%% Square-root EKF: time update
+% With P_EKF = S'*S and Q = chol_Q'*chol_Q, the predicted covariance phi*P*phi' + Gamma*Q*Gamma'
+% equals M'*M for the pre-array M = [S*phi'; chol_Q*Gamma']. The triangular factor R of M = Q_M*R
+% is therefore a (square-root) factor of the predicted covariance.
+function S_pred = srekf_time_update(S,phi,Gamma,chol_Q)
+S_pred = qr1([S*phi'; chol_Q*Gamma'],0);
+end
+
+%% Square-root EKF: measurement update
+% The QR factorisation of the pre-array [chol_R 0; S*H' S] yields the post-array [Re W; 0 S_upd],
+% where Re'*Re = H*P*H' + R (innovation covariance), Re'*W = H*P and S_upd'*S_upd = P - P*H'*inv(H*P*H'+R)*H*P.
+% The gain P*H'*inv(Re'*Re) = (Re\W)' then follows from a single triangular solve.
+function [S_upd,K] = srekf_measurement_update(S,H,chol_R)
+n_y = size(H,1);
+n_x = size(S,1);
+post_array = qr1([chol_R zeros(n_y,n_x); S*H' S],0);
+Re = post_array(1:n_y,1:n_y);
+W = post_array(1:n_y,n_y+1:end);
+S_upd = post_array(n_y+1:end,n_y+1:end);
+K = linsolve(Re,W,struct('UT',true))';
+end
+
+%% EKF linearisation: A_aug_EKF and Gamma_bottom = -inv(gz)*gx at (XZ,U)
+% Evaluated through the CasADi functions, or through the compiled library built by build_ekf_linearisation_library
+function [A_aug_EKF,Gamma_bottom_EKF] = evaluate_ekf_linearisation(XZ,U,ekf_linearisation)
+if isfield(ekf_linearisation,'library_name')
+    [A_aug_EKF,Gamma_bottom_EKF] = call_ekf_linearisation_library(XZ,U,ekf_linearisation);
+else
+    A_aug_EKF = full(ekf_linearisation.A_aug_EKF_fcn(XZ,U));
+    Gamma_bottom_EKF = full(ekf_linearisation.Gamma_bottom_EKF_fcn(XZ,U));
+end
+end
+
+function H_aug_EKF = evaluate_ekf_output_jacobian(XZ,U,ekf_linearisation)
+if isfield(ekf_linearisation,'library_name')
+    [~,~,H_aug_EKF] = call_ekf_linearisation_library(XZ,U,ekf_linearisation);
+else
+    H_aug_EKF = full(ekf_linearisation.H_aug_EKF_fcn(XZ));
+end
+end
+
+function [A_aug_EKF,Gamma_bottom_EKF,H_aug_EKF] = call_ekf_linearisation_library(XZ,U,ekf_linearisation)
+n_diff = ekf_linearisation.n_diff;
+n_xz = n_diff + ekf_linearisation.n_alg;
+[status,A_aug_EKF,Gamma_bottom_EKF,H_aug_EKF] = calllib(ekf_linearisation.library_name,'mandela_ekf_linearisation',XZ,U,...
+    zeros(n_xz,n_xz),zeros(ekf_linearisation.n_alg,n_diff),zeros(ekf_linearisation.n_outputs,n_xz));
+if status ~= 0
+    error('Mandela_EKF:linearisation','The compiled EKF linearisation failed (status %d, see mandela_ekf_linearisation.h).',status);
+end
+A_aug_EKF = reshape(A_aug_EKF,n_xz,n_xz);
+Gamma_bottom_EKF = reshape(Gamma_bottom_EKF,ekf_linearisation.n_alg,n_diff);
+H_aug_EKF = reshape(H_aug_EKF,ekf_linearisation.n_outputs,n_xz);
+end
+
+%% Algebraic variables Z from g(X,Z) = 0 (X kept constant)
+function Z = solve_algebraic_equations(Z_guess,X,model_params,algebraic_solver,opt_fsolve)
+if strcmp(algebraic_solver,'native')
+    Z = algebraic_equations_mex(Z_guess,X,model_params);
+else
+    [Z,~,~,~,~] = fsolve(@algebraicEquations,Z_guess,opt_fsolve,X,model_params);
+end
+end
+
 function ida_options_struct = compute_updated_ida_options(opt_IDA,id,user_data_struct)
 ida_options_struct = IDASetOptions('RelTol', opt_IDA.RelTol,...
     'AbsTol'        , opt_IDA.AbsTol,...
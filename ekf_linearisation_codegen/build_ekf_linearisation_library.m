@@ -0,0 +1,59 @@
+function library_name = build_ekf_linearisation_library(ekf_jacobians_fcn)
+%BUILD_EKF_LINEARISATION_LIBRARY Generates, compiles and loads the EKF linearisation library
+%   LIBRARY_NAME = BUILD_EKF_LINEARISATION_LIBRARY(EKF_JACOBIANS_FCN) generates C
+%   code for the CasADi function EKF_JACOBIANS_FCN, which must be named
+%   'mandela_ekf_jacobians' and map (XZ,U) to the dense Jacobian blocks
+%   fx, fz, gx, gz and H_aug (in this order). The generated code is compiled
+%   together with mandela_ekf_linearisation.c (LU solve of gz, assembly of
+%   A_aug_EKF and Gamma_bottom) into a shared library, which is then loaded
+%   with LOADLIBRARY. LIBRARY_NAME is the name to be used with CALLLIB:
+%
+%   [status,A_aug,Gamma_bottom,H_aug] = calllib(LIBRARY_NAME,'mandela_ekf_linearisation',XZ,U,...
+%       zeros(n_xz),zeros(n_alg,n_diff),zeros(n_outputs,n_xz))
+%
+%   The C compiler is taken from the environment variable CC (default 'cc').
+%
+%   See also MANDELA_EKF_USING_ALG_MEASUREMENT.
+
+% Authors: Krishnakumar Gopalakrishnan, Davide M. Raimondo
+% License: MIT License
+
+if ~strcmp(ekf_jacobians_fcn.name(),'mandela_ekf_jacobians')
+    error('build_ekf_linearisation_library:name','The CasADi function must be named ''mandela_ekf_jacobians''.');
+end
+
+codegen_dir = fileparts(mfilename('fullpath'));
+library_name = 'libmandela_ekf_linearisation';
+if libisloaded(library_name)
+    unloadlibrary(library_name);
+end
+
+% The five outputs are generated as one function, so that their common subexpressions are shared
+cg = casadi.CodeGenerator('mandela_ekf_jacobians.c',struct('with_header',true));
+cg.add(ekf_jacobians_fcn);
+cg.generate([codegen_dir filesep]);
+
+if ispc
+    library_file = fullfile(codegen_dir,[library_name '.dll']);
+    cflags = '-O3 -shared';
+elseif ismac
+    library_file = fullfile(codegen_dir,[library_name '.dylib']);
+    cflags = '-O3 -fPIC -dynamiclib';
+else
+    library_file = fullfile(codegen_dir,[library_name '.so']);
+    cflags = '-O3 -fPIC -shared';
+end
+
+cc = getenv('CC');
+if isempty(cc)
+    cc = 'cc';
+end
+compile_cmd = sprintf('%s %s "%s" "%s" -o "%s" -lm',cc,cflags,...
+    fullfile(codegen_dir,'mandela_ekf_linearisation.c'),fullfile(codegen_dir,'mandela_ekf_jacobians.c'),library_file);
+[status,compiler_output] = system(compile_cmd);
+if status ~= 0
+    error('build_ekf_linearisation_library:compile','Compilation of the EKF linearisation library failed:\n%s',compiler_output);
+end
+
+loadlibrary(library_file,fullfile(codegen_dir,'mandela_ekf_linearisation.h'));
+end
@@ -0,0 +1,206 @@
+/*
+ * EKF linearisation of the batch reactor DAE
+ *
+ * The Jacobian blocks fx, fz, gx, gz and H are computed by one CasADi
+ * function, "mandela_ekf_jacobians", which is generated as C code by
+ * build_ekf_linearisation_library.m. The five outputs are generated
+ * together, so every common subexpression of the model (the rate
+ * coefficients, s = 10^(-Z1), ...) is evaluated only once.
+ *
+ * gz is then LU factorised (partial pivoting) and Gamma_bottom = -gz\gx is
+ * obtained by forward/back substitution, instead of building inv(gz) into
+ * the symbolic expressions as A_aug_EKF_fcn does.
+ *
+ * example compile command (see also build_ekf_linearisation_library.m):
+ * cc -O3 -fPIC -shared mandela_ekf_linearisation.c mandela_ekf_jacobians.c -o libmandela_ekf_linearisation.so
+ */
+
+#include "mandela_ekf_linearisation.h"
+#include "mandela_ekf_jacobians.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+enum { OUT_FX, OUT_FZ, OUT_GX, OUT_GZ, OUT_H, N_OUT };
+
+/* Work arrays of the generated kernel and the (dense) Jacobian blocks. They
+ * are allocated on the first call and kept for the lifetime of the library. */
+static int n_diff = 0, n_alg = 0, n_outputs = 0;
+static const casadi_real **kernel_arg = NULL;
+static casadi_real **kernel_res = NULL;
+static casadi_int *kernel_iw = NULL;
+static casadi_real *kernel_w = NULL;
+static double *blocks[N_OUT];
+static double *Gb_f = NULL;
+static int *piv = NULL;
+
+static int allocate_workspace(void)
+{
+    casadi_int sz_arg, sz_res, sz_iw, sz_w;
+    const casadi_int *sp;
+    size_t n_blocks;
+    int i;
+
+    if (mandela_ekf_jacobians_work(&sz_arg, &sz_res, &sz_iw, &sz_w) != 0) {
+        return MANDELA_EKF_LINEARISATION_KERNEL_FAIL;
+    }
+    /* sparsity pattern: [nrow, ncol, ...] (the outputs are dense) */
+    sp = mandela_ekf_jacobians_sparsity_out(OUT_FX);
+    n_diff = (int)sp[0];
+    sp = mandela_ekf_jacobians_sparsity_out(OUT_GZ);
+    n_alg = (int)sp[0];
+    sp = mandela_ekf_jacobians_sparsity_out(OUT_H);
+    n_outputs = (int)sp[0];
+
+    n_blocks = (size_t)(n_diff*n_diff + n_diff*n_alg + n_alg*n_diff + n_alg*n_alg + n_outputs*(n_diff + n_alg));
+    kernel_arg = (const casadi_real **)malloc((size_t)(sz_arg > 2 ? sz_arg : 2)*sizeof(casadi_real *));
+    kernel_res = (casadi_real **)malloc((size_t)(sz_res > N_OUT ? sz_res : N_OUT)*sizeof(casadi_real *));
+    kernel_iw = (casadi_int *)malloc((size_t)(sz_iw > 0 ? sz_iw : 1)*sizeof(casadi_int));
+    kernel_w = (casadi_real *)malloc((size_t)(sz_w > 0 ? sz_w : 1)*sizeof(casadi_real));
+    blocks[0] = (double *)malloc(n_blocks*sizeof(double));
+    Gb_f = (double *)malloc((size_t)(n_alg*(n_diff + n_alg))*sizeof(double));
+    piv = (int *)malloc((size_t)n_alg*sizeof(int));
+    if (!kernel_arg || !kernel_res || !kernel_iw || !kernel_w || !blocks[0] || !Gb_f || !piv) {
+        free((void *)kernel_arg); free(kernel_res); free(kernel_iw); free(kernel_w);
+        free(blocks[0]); free(Gb_f); free(piv);
+        kernel_arg = NULL;
+        return MANDELA_EKF_LINEARISATION_MEM_FAIL;
+    }
+    blocks[OUT_FZ] = blocks[OUT_FX] + n_diff*n_diff;
+    blocks[OUT_GX] = blocks[OUT_FZ] + n_diff*n_alg;
+    blocks[OUT_GZ] = blocks[OUT_GX] + n_alg*n_diff;
+    blocks[OUT_H]  = blocks[OUT_GZ] + n_alg*n_alg;
+    for (i=0; i<N_OUT; i++) {
+        kernel_res[i] = blocks[i];
+    }
+    return MANDELA_EKF_LINEARISATION_SUCCESS;
+}
+
+/* In-place LU factorisation with partial pivoting of the n x n matrix A.
+ * Returns 0 on success and 1 if A is singular. */
+static int lu_factor(double *A, int *p, int n)
+{
+    int i, j, k, ip;
+    double amax, t, lkk;
+
+    for (k=0; k<n; k++) {
+        ip = k;
+        amax = fabs(A[k + k*n]);
+        for (i=k+1; i<n; i++) {
+            if (fabs(A[i + k*n]) > amax) {
+                amax = fabs(A[i + k*n]);
+                ip = i;
+            }
+        }
+        p[k] = ip;
+        if (amax == 0) {
+            return 1;
+        }
+        if (ip != k) {
+            for (j=0; j<n; j++) {
+                t = A[k + j*n]; A[k + j*n] = A[ip + j*n]; A[ip + j*n] = t;
+            }
+        }
+        lkk = 1.0/A[k + k*n];
+        for (i=k+1; i<n; i++) {
+            A[i + k*n] *= lkk;
+        }
+        for (j=k+1; j<n; j++) {
+            t = A[k + j*n];
+            for (i=k+1; i<n; i++) {
+                A[i + j*n] -= A[i + k*n]*t;
+            }
+        }
+    }
+    return 0;
+}
+
+/* B = A\B for the n x nrhs matrix B, given the output of lu_factor */
+static void lu_solve(const double *LU, const int *p, int n, double *B, int nrhs)
+{
+    int i, j, c;
+    double t, *b;
+
+    for (c=0; c<nrhs; c++) {
+        b = B + c*n;
+        for (i=0; i<n; i++) {
+            if (p[i] != i) {
+                t = b[i]; b[i] = b[p[i]]; b[p[i]] = t;
+            }
+        }
+        for (j=0; j<n; j++) {
+            for (i=j+1; i<n; i++) {
+                b[i] -= LU[i + j*n]*b[j];
+            }
+        }
+        for (j=n-1; j>=0; j--) {
+            b[j] /= LU[j + j*n];
+            for (i=0; i<j; i++) {
+                b[i] -= LU[i + j*n]*b[j];
+            }
+        }
+    }
+}
+
+int mandela_ekf_linearisation(const double *XZ, const double *U,
+        double *A_aug, double *Gamma_bottom, double *H_aug)
+{
+    int i, j, k, n_xz, status;
+    const double *fx, *fz, *gx;
+    double *gz;
+
+    if (!kernel_arg) {
+        status = allocate_workspace();
+        if (status != MANDELA_EKF_LINEARISATION_SUCCESS) {
+            return status;
+        }
+    }
+    n_xz = n_diff + n_alg;
+
+    kernel_arg[0] = XZ;
+    kernel_arg[1] = U;
+    if (mandela_ekf_jacobians(kernel_arg, kernel_res, kernel_iw, kernel_w, 0) != 0) {
+        return MANDELA_EKF_LINEARISATION_KERNEL_FAIL;
+    }
+    fx = blocks[OUT_FX];
+    fz = blocks[OUT_FZ];
+    gx = blocks[OUT_GX];
+    gz = blocks[OUT_GZ];
+
+    /* Gamma_bottom = -gz\gx */
+    if (lu_factor(gz, piv, n_alg) != 0) {
+        return MANDELA_EKF_LINEARISATION_SINGULAR_GZ;
+    }
+    for (i=0; i<n_alg*n_diff; i++) {
+        Gamma_bottom[i] = -gx[i];
+    }
+    lu_solve(gz, piv, n_alg, Gamma_bottom, n_diff);
+
+    /* Gb_f = Gamma_bottom*[fx fz] */
+    for (j=0; j<n_xz; j++) {
+        const double *f = (j < n_diff) ? fx + j*n_diff : fz + (j - n_diff)*n_diff;
+        for (i=0; i<n_alg; i++) {
+            double s = 0;
+            for (k=0; k<n_diff; k++) {
+                s += Gamma_bottom[i + k*n_alg]*f[k];
+            }
+            Gb_f[i + j*n_alg] = s;
+        }
+    }
+
+    /* A_aug = [fx fz; Gb_f] */
+    for (j=0; j<n_xz; j++) {
+        const double *f = (j < n_diff) ? fx + j*n_diff : fz + (j - n_diff)*n_diff;
+        for (i=0; i<n_diff; i++) {
+            A_aug[i + j*n_xz] = f[i];
+        }
+        for (i=0; i<n_alg; i++) {
+            A_aug[n_diff + i + j*n_xz] = Gb_f[i + j*n_alg];
+        }
+    }
+
+    for (i=0; i<n_outputs*n_xz; i++) {
+        H_aug[i] = blocks[OUT_H][i];
+    }
+    return MANDELA_EKF_LINEARISATION_SUCCESS;
+}
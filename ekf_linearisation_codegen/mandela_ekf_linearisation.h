@@ -0,0 +1,38 @@
+/*
+ * EKF linearisation of the batch reactor DAE from the generated Jacobian
+ * kernel (see mandela_ekf_linearisation.c). This header is self-contained,
+ * so that it can be passed to MATLAB's loadlibrary.
+ */
+
+#ifndef MANDELA_EKF_LINEARISATION_H
+#define MANDELA_EKF_LINEARISATION_H
+
+#define MANDELA_EKF_LINEARISATION_SUCCESS        0
+#define MANDELA_EKF_LINEARISATION_MEM_FAIL       1
+#define MANDELA_EKF_LINEARISATION_KERNEL_FAIL    2
+#define MANDELA_EKF_LINEARISATION_SINGULAR_GZ    3
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define MANDELA_EKF_LINEARISATION_EXPORT __declspec(dllexport)
+#else
+#define MANDELA_EKF_LINEARISATION_EXPORT
+#endif
+
+/*
+ * A_aug_EKF    = [fx fz; -inv(gz)*gx*fx -inv(gz)*gx*fz]  (n_xz x n_xz)
+ * Gamma_bottom = -inv(gz)*gx                             (n_alg x n_diff)
+ * H_aug_EKF    = dh/dXZ                                  (n_outputs x n_xz)
+ * at (XZ, U). All matrices are column-major. Returns one of the codes above.
+ */
+MANDELA_EKF_LINEARISATION_EXPORT int mandela_ekf_linearisation(const double *XZ, const double *U,
+        double *A_aug, double *Gamma_bottom, double *H_aug);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
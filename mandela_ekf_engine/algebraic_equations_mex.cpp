@@ -0,0 +1,46 @@
+/*
+ * MATLAB interface to the solver of the algebraic equations of the batch reactor
+ *
+ * [Z,flag] = algebraic_equations_mex(Z_guess,X,model_params)
+ *
+ * drop-in replacement for fsolve(@algebraicEquations,Z_guess,opt_fsolve,X,model_params),
+ * see algebraic_equations_mex.m and make_mandela_ekf.m for the compile command
+ */
+
+#include "mex.h"
+#include "batch_reactor_model.hpp"
+#include "mex_config_fields.hpp"
+
+#include <cstring>
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    using namespace batch_reactor;
+    static const char *const usage_err_id = "algebraic_equations:usage";
+
+    if (nrhs != 3 || nlhs > 2) mexErrMsgIdAndTxt(usage_err_id, "Usage: [Z,flag] = algebraic_equations_mex(Z_guess,X,model_params)");
+    for (int i = 0; i < 2; i++) {
+        if (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i])) {
+            mexErrMsgIdAndTxt(usage_err_id, "Z_guess and X must be real, full double vectors.");
+        }
+    }
+    if (mxGetNumberOfElements(prhs[0]) != (size_t)n_alg || mxGetNumberOfElements(prhs[1]) != (size_t)n_diff) {
+        mexErrMsgIdAndTxt(usage_err_id, "Z_guess must have %d and X %d elements.", n_alg, n_diff);
+    }
+    if (!mxIsStruct(prhs[2])) mexErrMsgIdAndTxt(usage_err_id, "model_params must be a struct.");
+
+    model_params p;
+    get_model_param_fields(prhs[2], p, usage_err_id);
+
+    double XZ[n_xz];
+    std::memcpy(XZ, mxGetPr(prhs[1]), n_diff*sizeof(double));
+    std::memcpy(XZ + n_diff, mxGetPr(prhs[0]), n_alg*sizeof(double));
+    const int flag = solve_algebraic_equations(XZ, p);
+    if (flag != 0 && nlhs < 2) {
+        mexErrMsgIdAndTxt("algebraic_equations:solve", "The algebraic equations could not be solved.");
+    }
+
+    plhs[0] = mxCreateDoubleMatrix(n_alg, 1, mxREAL);
+    std::memcpy(mxGetPr(plhs[0]), XZ + n_diff, n_alg*sizeof(double));
+    if (nlhs >= 2) plhs[1] = mxCreateDoubleScalar(flag);
+}
@@ -0,0 +1,14 @@
+%ALGEBRAIC_EQUATIONS_MEX Native solver of the algebraic equations of the batch chemical reactor.
+%   Z = ALGEBRAIC_EQUATIONS_MEX(Z_GUESS,X,MODEL_PARAMS) solves
+%   algebraicEquations(Z,X,MODEL_PARAMS) = 0 for the n_alg algebraic
+%   variables Z, with the differential states X kept constant, i.e. it
+%   replaces fsolve(@algebraicEquations,Z_GUESS,opt_fsolve,X,MODEL_PARAMS).
+%   With s = 10^(-Z(1)), Z(2:4) follow in closed form from X and s, and the
+%   equations reduce to one monotone equation in Z(1). It is solved by a
+%   Newton iteration safeguarded by bisection, starting from Z_GUESS(1).
+%   An error is raised if the equations cannot be solved.
+%
+%   [Z,FLAG] = ALGEBRAIC_EQUATIONS_MEX(...) returns FLAG = 0 on success and
+%   a non-zero FLAG instead of raising an error.
+%
+%   See also MAKE_MANDELA_EKF.
@@ -0,0 +1,291 @@
+// Native implementation of the batch chemical reactor DAE (see batch_reactor_model.hpp)
+
+#include "batch_reactor_model.hpp"
+#include "dual_number.hpp"
+#include "small_dense.hpp"
+
+#include <cmath>
+#include <limits>
+
+namespace batch_reactor {
+
+model_params default_model_params()
+{
+    model_params p;
+    p.alpha_1    = 1.3708e12/3600;
+    p.E1_over_R  = 9.2984e3;
+    p.alpha_m1   = 1.6215e20/3600;
+    p.Em1_over_R = 1.3108e4;
+    p.alpha_2    = 5.2282e12/3600;
+    p.E2_over_R  = 9.5999e3;
+    p.K1         = 2.575e-16;
+    p.K2         = 4.876e-14;
+    p.K3         = 1.7884e-16;
+    p.Q_plus     = 0.0131;
+    return p;
+}
+
+void compute_rate_coeffs(const model_params &p, double T_degC, rate_coeffs &k)
+{
+    const double T_K = T_degC + 273;
+    k.k1  = p.alpha_1*std::exp(-p.E1_over_R/T_K);
+    k.k2  = p.alpha_2*std::exp(-p.E2_over_R/T_K);
+    k.k3  = k.k1;
+    k.km1 = p.alpha_m1*std::exp(-p.Em1_over_R/T_K);
+    k.km3 = 0.5*k.km1;
+}
+
+rate_coeff_cache::rate_coeff_cache()
+    : p_(default_model_params()), valid_(false), T_degC_(0.0), T_degC_anchor_(0.0), inv_T_K_anchor_(0.0), max_E_over_R_(0.0)
+{
+}
+
+void rate_coeff_cache::reset(const model_params &p)
+{
+    p_ = p;
+    max_E_over_R_ = std::fmax(std::fabs(p.E1_over_R), std::fmax(std::fabs(p.E2_over_R), std::fabs(p.Em1_over_R)));
+    valid_ = false;
+}
+
+// exp(x) for |x| <= 1e-2 (relative truncation error below 2e-15)
+static inline double exp_small(double x)
+{
+    return 1.0 + x*(1.0 + x/2*(1.0 + x/3*(1.0 + x/4*(1.0 + x/5))));
+}
+
+const rate_coeffs &rate_coeff_cache::get(double T_degC)
+{
+    if (valid_ && T_degC == T_degC_) return k_;  // constant temperature segment
+
+    const double inv_T_K = 1.0/(T_degC + 273);
+    const double du = inv_T_K - inv_T_K_anchor_;
+    if (valid_ && max_E_over_R_*std::fabs(du) <= 1e-2) {
+        k_.k1  = k_anchor_.k1*exp_small(-p_.E1_over_R*du);
+        k_.k2  = k_anchor_.k2*exp_small(-p_.E2_over_R*du);
+        k_.k3  = k_.k1;
+        k_.km1 = k_anchor_.km1*exp_small(-p_.Em1_over_R*du);
+        k_.km3 = 0.5*k_.km1;
+    } else {
+        compute_rate_coeffs(p_, T_degC, k_anchor_);
+        k_ = k_anchor_;
+        T_degC_anchor_ = T_degC;
+        inv_T_K_anchor_ = inv_T_K;
+        valid_ = true;
+    }
+    T_degC_ = T_degC;
+    return k_;
+}
+
+double rate_coeff_cache::anchor_T_degC() const
+{
+    return valid_ ? T_degC_anchor_ : std::numeric_limits<double>::quiet_NaN();
+}
+
+void rate_coeff_cache::set_anchor(double T_degC)
+{
+    valid_ = false;
+    if (!std::isnan(T_degC)) get(T_degC);
+}
+
+// The model equations are written once, for double and for dual<n_xz> arguments (Jacobians)
+template <typename T>
+static void state_equations(const T *XZ, const rate_coeffs &k, T *rhs)
+{
+    const T *X = XZ;
+    const T *Z = XZ + n_diff;
+
+    rhs[0] = -k.k2*X[1]*Z[1];
+    rhs[1] = -k.k1*X[1]*X[5] + k.km1*Z[3] - k.k2*X[1]*Z[1];
+    rhs[2] =  k.k2*X[1]*Z[1] + k.k3*X[3]*X[5] - k.km3*Z[2];
+    rhs[3] = -k.k3*X[3]*X[5] + k.km3*Z[2];
+    rhs[4] =  k.k1*X[1]*X[5] - k.km1*Z[3];
+    rhs[5] = -k.k1*X[1]*X[5] + k.km1*Z[3] - k.k3*X[3]*X[5] + k.km3*Z[2];
+}
+
+template <typename T>
+static void algebraic_equations_t(const T *XZ, const model_params &p, T *res_Z)
+{
+    const T *X = XZ;
+    const T *Z = XZ + n_diff;
+    const T s = pow10_neg(Z[0]);
+
+    res_Z[0] = p.Q_plus - X[5] + s - Z[1] - Z[2] - Z[3];
+    res_Z[1] = Z[1] - p.K2*X[0]/(p.K2 + s);
+    res_Z[2] = Z[2] - p.K3*X[2]/(p.K3 + s);
+    res_Z[3] = Z[3] - p.K1*X[4]/(p.K1 + s);
+}
+
+typedef dual<n_xz> dual_xz;
+
+// XZ as independent variables
+static void seed(const double *XZ, dual_xz *XZ_dual)
+{
+    for (int i = 0; i < n_xz; i++) XZ_dual[i] = dual_xz::variable(XZ[i], i);
+}
+
+void rhs_state_eqn(const double *XZ, const rate_coeffs &k, const double *process_noise, double *rhs)
+{
+    state_equations(XZ, k, rhs);
+    if (process_noise) {
+        for (int i = 0; i < n_diff; i++) rhs[i] += process_noise[i];
+    }
+}
+
+void pseudo_white_noise(double t, double Ts, double *process_noise)
+{
+    const double two_pi = 6.283185307179586;
+    process_noise[0] =  1e-3*std::sin(100*two_pi*t/Ts);
+    process_noise[1] =  1e-3*std::cos(90*two_pi*t/Ts);
+    process_noise[2] = -1e-3*std::sin(110*two_pi*t/Ts);
+    process_noise[3] =  1e-3*std::sin(90*two_pi*t/Ts);
+    process_noise[4] = 0.0;
+    process_noise[5] = 0.0;
+}
+
+void algebraic_equations(const double *XZ, const model_params &p, double *res_Z)
+{
+    algebraic_equations_t(XZ, p, res_Z);
+}
+
+void residual(const double *XZ, const double *XZp, const model_params &p, const rate_coeffs &k,
+              const double *process_noise, double *res)
+{
+    double rhs[n_diff];
+    rhs_state_eqn(XZ, k, process_noise, rhs);
+    for (int i = 0; i < n_diff; i++) res[i] = XZp[i] - rhs[i];
+    algebraic_equations(XZ, p, res + n_diff);
+}
+
+void algebraic_jacobian(const double *XZ, const model_params &p, double *gx, double *gz)
+{
+    dual_xz XZ_dual[n_xz], g[n_alg];
+    seed(XZ, XZ_dual);
+    algebraic_equations_t(XZ_dual, p, g);
+
+    // gx(i,j) = gx[i + j*n_alg], gz(i,j) = gz[i + j*n_alg]
+    for (int i = 0; i < n_alg; i++) {
+        for (int j = 0; j < n_diff; j++) gx[i + j*n_alg] = g[i].d[j];
+        for (int j = 0; j < n_alg; j++) gz[i + j*n_alg] = g[i].d[n_diff + j];
+    }
+}
+
+void linearisation(const double *XZ, const model_params &p, const rate_coeffs &k,
+                   double *fx, double *fz, double *gx, double *gz)
+{
+    dual_xz XZ_dual[n_xz], f[n_diff], g[n_alg];
+    seed(XZ, XZ_dual);
+    state_equations(XZ_dual, k, f);
+    algebraic_equations_t(XZ_dual, p, g);
+
+    // fx(i,j) = fx[i + j*n_diff], fz(i,j) = fz[i + j*n_diff]
+    for (int i = 0; i < n_diff; i++) {
+        for (int j = 0; j < n_diff; j++) fx[i + j*n_diff] = f[i].d[j];
+        for (int j = 0; j < n_alg; j++) fz[i + j*n_diff] = f[i].d[n_diff + j];
+    }
+    for (int i = 0; i < n_alg; i++) {
+        for (int j = 0; j < n_diff; j++) gx[i + j*n_alg] = g[i].d[j];
+        for (int j = 0; j < n_alg; j++) gz[i + j*n_alg] = g[i].d[n_diff + j];
+    }
+}
+
+// Damped Newton iteration on g(X,Z) = 0 (fallback of solve_algebraic_equations)
+static int solve_algebraic_equations_damped_newton(double *XZ, const model_params &p)
+{
+    const int max_iter = 100;
+    double gx[n_alg*n_diff], gz[n_alg*n_alg];
+    double g[n_alg], dz[n_alg], XZ_trial[n_xz], g_trial[n_alg];
+    int piv[n_alg];
+    double *Z = XZ + n_diff;
+
+    algebraic_equations(XZ, p, g);
+    double g_norm = small_dense::norm_inf<n_alg, 1>(g);
+
+    for (int iter = 0; iter < max_iter; iter++) {
+        algebraic_jacobian(XZ, p, gx, gz);
+        if (small_dense::lu_factor<n_alg>(gz, piv) != 0) return -1;
+        for (int i = 0; i < n_alg; i++) dz[i] = -g[i];
+        small_dense::lu_solve<n_alg, 1>(gz, piv, dz);
+
+        // Backtrack until the residual decreases
+        double lambda = 1.0;
+        double g_trial_norm = 0.0;
+        for (int i = 0; i < n_diff; i++) XZ_trial[i] = XZ[i];
+        for (;;) {
+            for (int i = 0; i < n_alg; i++) XZ_trial[n_diff + i] = Z[i] + lambda*dz[i];
+            algebraic_equations(XZ_trial, p, g_trial);
+            g_trial_norm = small_dense::norm_inf<n_alg, 1>(g_trial);
+            if (lambda < 1e-4 || (std::isfinite(g_trial_norm) && g_trial_norm < g_norm)) break;
+            lambda *= 0.5;
+        }
+
+        double step_norm = 0.0, z_norm = 0.0;
+        for (int i = 0; i < n_alg; i++) {
+            step_norm = std::fmax(step_norm, std::fabs(lambda*dz[i]));
+            z_norm = std::fmax(z_norm, std::fabs(Z[i]));
+            Z[i] = XZ_trial[n_diff + i];
+            g[i] = g_trial[i];
+        }
+        g_norm = g_trial_norm;
+
+        if (!std::isfinite(g_norm)) return -1;
+        if (g_norm <= 1e-15 || step_norm <= 1e-12*(1.0 + z_norm)) return 0;
+    }
+    return -1;
+}
+
+// h(s) of the scalar algebraic equation in Z(1) (see batch_reactor_model.hpp), and dh/dZ(1)
+static double scalar_algebraic_equation(double z1, const double *X, const model_params &p, double *dh_dz1)
+{
+    const double ln10 = 2.302585092994046;
+    const double s = std::pow(10.0, -z1);
+    const double d2 = p.K2 + s, d3 = p.K3 + s, d1 = p.K1 + s;
+    const double h = p.Q_plus - X[5] + s - p.K2*X[0]/d2 - p.K3*X[2]/d3 - p.K1*X[4]/d1;
+    const double dh_ds = 1.0 + p.K2*X[0]/(d2*d2) + p.K3*X[2]/(d3*d3) + p.K1*X[4]/(d1*d1);
+    *dh_dz1 = -ln10*s*dh_ds;
+    return h;
+}
+
+int solve_algebraic_equations(double *XZ, const model_params &p)
+{
+    const int max_iter = 100;
+    const double *X = XZ;
+    double *Z = XZ + n_diff;
+    double dh;
+
+    // h decreases from h(s = inf) = inf to h(s = 0) = Q_plus - X(6) - X(1) - X(3) - X(5) (non-negative X),
+    // so the root is bracketed by a large s (z_lo) and s = 10^(-z_hi), which underflows to 0
+    const double h_s0 = p.Q_plus - X[5] - X[0] - X[2] - X[4];
+    if (!(h_s0 < 0)) return solve_algebraic_equations_damped_newton(XZ, p);
+    const double s_hi = 1.0 + X[5] - p.Q_plus + std::fmax(X[0], 0.0) + std::fmax(X[2], 0.0) + std::fmax(X[4], 0.0);
+    double z_lo = -std::log10(s_hi);
+    double z_hi = 400.0;
+
+    double z = Z[0];
+    if (!(z > z_lo && z < z_hi)) z = 0.5*(z_lo + z_hi);
+    double h = scalar_algebraic_equation(z, X, p, &dh);
+
+    for (int iter = 0; ; iter++) {
+        if (h == 0) break;
+        if (iter == max_iter || !std::isfinite(h)) return -1;
+        if (h > 0) z_lo = z; else z_hi = z;
+
+        // Newton step, or bisection if it leaves the bracket
+        const double dz = -h/dh;
+        if (std::fabs(dz) <= 1e-14*(1.0 + std::fabs(z))) {
+            z += dz;
+            break;
+        }
+        z = (z + dz > z_lo && z + dz < z_hi) ? z + dz : 0.5*(z_lo + z_hi);
+        if (z_hi - z_lo <= 1e-14*(1.0 + std::fabs(z))) break;
+        h = scalar_algebraic_equation(z, X, p, &dh);
+    }
+
+    const double s = std::pow(10.0, -z);
+    Z[0] = z;
+    Z[1] = p.K2*X[0]/(p.K2 + s);
+    Z[2] = p.K3*X[2]/(p.K3 + s);
+    Z[3] = p.K1*X[4]/(p.K1 + s);
+    return 0;
+}
+
+} // namespace batch_reactor
@@ -0,0 +1,101 @@
+// Native implementation of the batch chemical reactor DAE (Becerra et al., 2001)
+// This mirrors pdae_model_eqns/batchChemReactorModel.m and algebraicEquations.m.
+// NOTE: all vectors are laid out as in the MATLAB code (XZ = [X;Z]) and all
+// matrices are stored column-major, so that they can be passed to/from MATLAB as is.
+
+#ifndef BATCH_REACTOR_MODEL_HPP
+#define BATCH_REACTOR_MODEL_HPP
+
+namespace batch_reactor {
+
+const int n_diff = 6;               // no. of differential variables
+const int n_alg  = 4;               // no. of algebraic variables
+const int n_xz   = n_diff + n_alg;  // length of the augmented vector XZ
+
+// Constant model parameters (same names and units as model_params in the MATLAB scripts)
+struct model_params {
+    double alpha_1;     // kg/gmol/s
+    double E1_over_R;   // K
+    double alpha_m1;    // 1/s
+    double Em1_over_R;  // K
+    double alpha_2;     // kg g/mol/s
+    double E2_over_R;   // K
+    double K1;          // gmol/kg  (appears only in algebraic equations)
+    double K2;          // gmol/kg  (appears only in algebraic equations)
+    double K3;          // gmol/kg  (appears only in algebraic equations)
+    double Q_plus;      // gmol/kg  (appears only in algebraic equations)
+};
+
+model_params default_model_params();
+
+// Temperature dependent coefficients of the model equations
+struct rate_coeffs {
+    double k1, k2, k3, km1, km3;
+};
+
+void compute_rate_coeffs(const model_params &p, double T_degC, rate_coeffs &k);
+
+// Rate coefficients of the last temperature that was asked for. The temperature profile is
+// constant on most of the horizon, where the coefficients are returned as they are. On ramps,
+// close to the last temperature at which they were computed with exp() (the anchor), they are
+// updated with a truncated series of exp(-E/R*(1/T_K - 1/T_K_anchor)) instead.
+// One cache serves the residual, the IDA Jacobian and the EKF linearisation of one model instance.
+class rate_coeff_cache {
+public:
+    rate_coeff_cache();
+
+    // Sets the model parameters and invalidates the cache
+    void reset(const model_params &p);
+
+    const rate_coeffs &get(double T_degC);
+
+    // Temperature of the anchor (nan if there is none), and the anchor re-computed at a given
+    // temperature, so that a restored model continues with the coefficients of the saved one
+    double anchor_T_degC() const;
+    void set_anchor(double T_degC);
+
+private:
+    model_params p_;
+    bool valid_;
+    double T_degC_;           // temperature of k_
+    double T_degC_anchor_;    // temperature of k_anchor_
+    double inv_T_K_anchor_;   // 1/T_K of k_anchor_
+    double max_E_over_R_;
+    rate_coeffs k_, k_anchor_;
+};
+
+// Right hand side of the state equations, dX/dt = f(X,Z,T) + w (process_noise may be null)
+void rhs_state_eqn(const double *XZ, const rate_coeffs &k, const double *process_noise, double *rhs);
+
+// Deterministic "pseudo white" process noise of the truth model in batchChemReactorModel.m
+// (sinusoids with periods of Ts/90 to Ts/110 on the first four state equations)
+void pseudo_white_noise(double t, double Ts, double *process_noise);
+
+// Residuals of the algebraic equations g(X,Z) = 0
+void algebraic_equations(const double *XZ, const model_params &p, double *res_Z);
+
+// Overall residual [Xp - f; g] as required by IDA
+void residual(const double *XZ, const double *XZp, const model_params &p, const rate_coeffs &k,
+              const double *process_noise, double *res);
+
+// Partial derivatives gx (n_alg x n_diff) and gz (n_alg x n_alg) of the algebraic equations
+void algebraic_jacobian(const double *XZ, const model_params &p, double *gx, double *gz);
+
+// Partial derivatives fx (n_diff x n_diff), fz (n_diff x n_alg), gx (n_alg x n_diff) and gz (n_alg x n_alg),
+// obtained by evaluating the model equations on dual numbers (forward-mode differentiation)
+void linearisation(const double *XZ, const model_params &p, const rate_coeffs &k,
+                   double *fx, double *fz, double *gx, double *gz);
+
+// Solves g(X,Z) = 0 for Z (X kept constant), starting from the value passed in XZ.
+// With s = 10^(-Z(1)), Z(2..4) are K2*X(1)/(K2 + s), K3*X(3)/(K3 + s) and K1*X(5)/(K1 + s), so that
+// the algebraic equations reduce to the scalar equation
+//   h(s) = Q_plus - X(6) + s - K2*X(1)/(K2 + s) - K3*X(3)/(K3 + s) - K1*X(5)/(K1 + s) = 0,
+// which is monotone for non-negative X. It is solved for Z(1) by Newton's method, safeguarded by
+// bisection on a bracket of the root. Only Z(1) of XZ is used as starting point. If h has no
+// sign change for s > 0, a damped Newton iteration on all four equations is tried instead.
+// Returns 0 on success.
+int solve_algebraic_equations(double *XZ, const model_params &p);
+
+} // namespace batch_reactor
+
+#endif
@@ -0,0 +1,80 @@
+// IDA callbacks for the batch reactor DAE (see batch_reactor_model_ida.hpp)
+
+#include "batch_reactor_model_ida.hpp"
+#include "process_noise.hpp"
+
+#include <cstddef>
+
+using namespace batch_reactor;
+
+int batch_reactor_ida_residual(realtype t, N_Vector yy, N_Vector yp, N_Vector rr, void *user_data)
+{
+    batch_reactor_ida_data *data = static_cast<batch_reactor_ida_data *>(user_data);
+
+    const rate_coeffs &k = data->rates.get(data->temperature_profile->eval(t));
+    if (data->process_noise) {
+        residual(NV_DATA_S(yy), NV_DATA_S(yp), data->model_params, k, data->process_noise->eval(t), NV_DATA_S(rr));
+    } else if (data->noise_Ts > 0) {
+        double process_noise[n_diff];
+        pseudo_white_noise(t, data->noise_Ts, process_noise);
+        residual(NV_DATA_S(yy), NV_DATA_S(yp), data->model_params, k, process_noise, NV_DATA_S(rr));
+    } else {
+        residual(NV_DATA_S(yy), NV_DATA_S(yp), data->model_params, k, NULL, NV_DATA_S(rr));
+    }
+    return 0;
+}
+
+int batch_reactor_ida_jacobian(realtype t, realtype cj, N_Vector yy, N_Vector yp, N_Vector rr,
+                               SUNMatrix J, void *user_data,
+                               N_Vector tmp1, N_Vector tmp2, N_Vector tmp3)
+{
+    (void)yp; (void)rr; (void)tmp1; (void)tmp2; (void)tmp3;
+    batch_reactor_ida_data *data = static_cast<batch_reactor_ida_data *>(user_data);
+    double fx[n_diff*n_diff], fz[n_diff*n_alg], gx[n_alg*n_diff], gz[n_alg*n_alg];
+
+    const rate_coeffs &k = data->rates.get(data->temperature_profile->eval(t));
+    linearisation(NV_DATA_S(yy), data->model_params, k, fx, fz, gx, gz);
+
+    // F = [XZp(1:n_diff) - f; g]  =>  J = [cj*I - fx, -fz; gx, gz]
+    for (int j = 0; j < n_diff; j++) {
+        realtype *col = SM_COLUMN_D(J, j);
+        for (int i = 0; i < n_diff; i++) col[i] = -fx[i + j*n_diff];
+        col[j] += cj;
+        for (int i = 0; i < n_alg; i++) col[n_diff + i] = gx[i + j*n_alg];
+    }
+    for (int j = 0; j < n_alg; j++) {
+        realtype *col = SM_COLUMN_D(J, n_diff + j);
+        for (int i = 0; i < n_diff; i++) col[i] = -fz[i + j*n_diff];
+        for (int i = 0; i < n_alg; i++) col[n_diff + i] = gz[i + j*n_alg];
+    }
+    return 0;
+}
+
+int batch_reactor_ida_sens_residual(int n_s, realtype t, N_Vector yy, N_Vector yp, N_Vector rr,
+                                    N_Vector *yS, N_Vector *ypS, N_Vector *rrS, void *user_data,
+                                    N_Vector tmp1, N_Vector tmp2, N_Vector tmp3)
+{
+    (void)yp; (void)rr; (void)tmp1; (void)tmp2; (void)tmp3;
+    batch_reactor_ida_data *data = static_cast<batch_reactor_ida_data *>(user_data);
+    double fx[n_diff*n_diff], fz[n_diff*n_alg], gx[n_alg*n_diff], gz[n_alg*n_alg];
+
+    const rate_coeffs &k = data->rates.get(data->temperature_profile->eval(t));
+    linearisation(NV_DATA_S(yy), data->model_params, k, fx, fz, gx, gz);
+
+    // dF/dXZ = [-fx, -fz; gx, gz], dF/dXZp = [I 0; 0 0]
+    for (int s = 0; s < n_s; s++) {
+        const realtype *sx = NV_DATA_S(yS[s]), *sz = sx + n_diff, *spx = NV_DATA_S(ypS[s]);
+        realtype *r = NV_DATA_S(rrS[s]);
+        for (int i = 0; i < n_diff; i++) r[i] = spx[i];
+        for (int i = 0; i < n_alg; i++) r[n_diff + i] = 0.0;
+        for (int j = 0; j < n_diff; j++) {
+            for (int i = 0; i < n_diff; i++) r[i] -= fx[i + j*n_diff]*sx[j];
+            for (int i = 0; i < n_alg; i++) r[n_diff + i] += gx[i + j*n_alg]*sx[j];
+        }
+        for (int j = 0; j < n_alg; j++) {
+            for (int i = 0; i < n_diff; i++) r[i] -= fz[i + j*n_diff]*sz[j];
+            for (int i = 0; i < n_alg; i++) r[n_diff + i] += gz[i + j*n_alg]*sz[j];
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+// IDA callbacks for the batch reactor DAE, i.e. the native counterparts of
+// pdae_model_eqns/batchChemReactorModel_IDA.m and of djacfn in the MATLAB scripts
+
+#ifndef BATCH_REACTOR_MODEL_IDA_HPP
+#define BATCH_REACTOR_MODEL_IDA_HPP
+
+#include "batch_reactor_model.hpp"
+#include "input_profile.hpp"
+
+#include <idas/idas.h>
+#include <nvector/nvector_serial.h>
+#include <sunmatrix/sunmatrix_dense.h>
+
+class piecewise_constant_noise;
+
+// Passed to IDA as user data
+struct batch_reactor_ida_data {
+    batch_reactor::model_params model_params;
+    const input_profile *temperature_profile;  // Temperature (degC) vs time (sec)
+    double noise_Ts;  // > 0: pseudo_white_noise(t, noise_Ts) is added to the state equations (truth model)
+    piecewise_constant_noise *process_noise;  // not null: its w(t) is added instead (truth model, see process_noise.hpp)
+    batch_reactor::rate_coeff_cache rates;  // reset with model_params
+};
+
+int batch_reactor_ida_residual(realtype t, N_Vector yy, N_Vector yp, N_Vector rr, void *user_data);
+
+// Jacobian dF/dXZ + cj*dF/dXZp of the residual, from the dual-number linearisation of the model
+int batch_reactor_ida_jacobian(realtype t, realtype cj, N_Vector yy, N_Vector yp, N_Vector rr,
+                               SUNMatrix J, void *user_data,
+                               N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+
+// Residuals dF/dXZ*s_j + dF/dXZp*s_j' of the forward sensitivities s_j of the solution with respect
+// to its initial values (F has no parameters), from the same linearisation as the Jacobian
+int batch_reactor_ida_sens_residual(int n_s, realtype t, N_Vector yy, N_Vector yp, N_Vector rr,
+                                    N_Vector *yS, N_Vector *ypS, N_Vector *rrS, void *user_data,
+                                    N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+
+#endif
@@ -0,0 +1,120 @@
+// Model equations and linearisation of the batch reactor DAE for L reactors at once, in the lane
+// layout of lane_dense.hpp (XZ[i*L + l] is XZ(i) of lane l). These are the counterparts of
+// rhs_state_eqn() and linearisation() in batch_reactor_model.hpp, with the derivatives written
+// out so that every term is one vector operation across the lanes.
+//
+// The algebraic Jacobian has the structure
+//   gz = [-ln10*s -1 -1 -1; c1 1 0 0; c2 0 1 0; c3 0 0 1],  s = 10^(-Z(1)),
+// where c1..c3 are the derivatives of the last three equations with respect to Z(1). So
+// Gamma_bottom = -inv(gz)*gx is obtained without a factorisation: its first row is
+//   -(gx(1,:) + gx(2,:) + gx(3,:) + gx(4,:))/(-ln10*s + c1 + c2 + c3)
+// and the others follow as -gx(i,:) - c(i)*Gamma_bottom(1,:). The pivot vanishes exactly when gz
+// is singular. Where gx(i,:) and c(i)*Gamma_bottom(1,:) cancel, the terms are summed without
+// the cancellation, so the small entries of Gamma_bottom are more accurate than from an LU.
+
+#ifndef BATCH_REACTOR_MODEL_LANES_HPP
+#define BATCH_REACTOR_MODEL_LANES_HPP
+
+#include "batch_reactor_model.hpp"
+
+#include <cmath>
+
+namespace batch_reactor {
+
+template <int L>
+struct lane_rate_coeffs {
+    double k1[L], k2[L], k3[L], km1[L], km3[L];
+
+    void set(int l, const rate_coeffs &k)
+    {
+        k1[l] = k.k1; k2[l] = k.k2; k3[l] = k.k3; km1[l] = k.km1; km3[l] = k.km3;
+    }
+};
+
+// dX/dt = f(X,Z,T) of every lane
+template <int L>
+inline void lane_state_equations(const double *XZ, const lane_rate_coeffs<L> &k, double *rhs)
+{
+    const double *X1 = XZ + 1*L, *X3 = XZ + 3*L, *X5 = XZ + 5*L;
+    const double *Z1 = XZ + (n_diff + 1)*L, *Z2 = XZ + (n_diff + 2)*L, *Z3 = XZ + (n_diff + 3)*L;
+    for (int l = 0; l < L; l++) {
+        const double r2 = k.k2[l]*X1[l]*Z1[l];
+        const double r1 = k.k1[l]*X1[l]*X5[l] - k.km1[l]*Z3[l];
+        const double r3 = k.k3[l]*X3[l]*X5[l] - k.km3[l]*Z2[l];
+        rhs[0*L + l] = -r2;
+        rhs[1*L + l] = -r1 - r2;
+        rhs[2*L + l] =  r2 + r3;
+        rhs[3*L + l] = -r3;
+        rhs[4*L + l] =  r1;
+        rhs[5*L + l] = -r1 - r3;
+    }
+}
+
+// fx (n_diff x n_diff), fz (n_diff x n_alg) and Gamma_bottom = -inv(gz)*gx (n_alg x n_diff) of
+// every lane. singular[l] is set to 1 if gz of lane l is singular (0 otherwise).
+// Returns the no. of singular lanes.
+template <int L>
+inline int lane_linearisation(const double *XZ, const model_params &p, const lane_rate_coeffs<L> &k,
+                              double *fx, double *fz, double *Gamma_bottom, int *singular)
+{
+    const double ln10 = 2.302585092994045684;
+    const double *X = XZ, *Z = XZ + n_diff*L;
+    for (int i = 0; i < n_diff*n_diff*L; i++) fx[i] = 0.0;
+    for (int i = 0; i < n_diff*n_alg*L; i++) fz[i] = 0.0;
+#define FX(i, j) fx[((i) + (j)*n_diff)*L + l]
+#define FZ(i, j) fz[((i) + (j)*n_diff)*L + l]
+#define GB(i, j) Gamma_bottom[((i) + (j)*n_alg)*L + l]
+    for (int l = 0; l < L; l++) {
+        const double X1 = X[1*L + l], X3 = X[3*L + l], X5 = X[5*L + l], Z1 = Z[1*L + l];
+        const double k1 = k.k1[l], k2 = k.k2[l], k3 = k.k3[l], km1 = k.km1[l], km3 = k.km3[l];
+
+        // r2 = k2*X1*Z1, r1 = k1*X1*X5 - km1*Z3, r3 = k3*X3*X5 - km3*Z2 (see lane_state_equations)
+        const double r2_X1 = k2*Z1, r2_Z1 = k2*X1;
+        const double r1_X1 = k1*X5, r1_X5 = k1*X1;
+        const double r3_X3 = k3*X5, r3_X5 = k3*X3;
+        FX(0, 1) = -r2_X1;                                   FZ(0, 1) = -r2_Z1;
+        FX(1, 1) = -r1_X1 - r2_X1; FX(1, 5) = -r1_X5;        FZ(1, 1) = -r2_Z1; FZ(1, 3) = km1;
+        FX(2, 1) = r2_X1; FX(2, 3) = r3_X3; FX(2, 5) = r3_X5; FZ(2, 1) = r2_Z1; FZ(2, 2) = -km3;
+        FX(3, 3) = -r3_X3; FX(3, 5) = -r3_X5;                FZ(3, 2) = km3;
+        FX(4, 1) = r1_X1; FX(4, 5) = r1_X5;                  FZ(4, 3) = -km1;
+        FX(5, 1) = -r1_X1; FX(5, 3) = -r3_X3; FX(5, 5) = -r1_X5 - r3_X5; FZ(5, 2) = km3; FZ(5, 3) = km1;
+    }
+    int n_singular = 0;
+    for (int l = 0; l < L; l++) {
+        const double s = std::pow(10.0, -Z[0*L + l]);
+        const double d2 = p.K2 + s, d3 = p.K3 + s, d1 = p.K1 + s;
+
+        // Non-zero entries of gx: gx(1,6) = -1, gx(2,1), gx(3,3), gx(4,5); and c1..c3 = gz(2..4,1)
+        const double gx_21 = -p.K2/d2, gx_33 = -p.K3/d3, gx_45 = -p.K1/d1;
+        const double c1 = -ln10*s*p.K2*X[0*L + l]/(d2*d2);
+        const double c2 = -ln10*s*p.K3*X[2*L + l]/(d3*d3);
+        const double c3 = -ln10*s*p.K1*X[4*L + l]/(d1*d1);
+        const double pivot = -ln10*s + c1 + c2 + c3;
+        singular[l] = (pivot == 0.0);
+        n_singular += singular[l];
+        const double inv_pivot = singular[l] ? 0.0 : 1.0/pivot;
+
+        // Gamma_bottom(1,:) = -(column sums of gx)/pivot
+        double g1[n_diff] = {-gx_21, 0.0, -gx_33, 0.0, -gx_45, 1.0};
+        for (int j = 0; j < n_diff; j++) {
+            g1[j] *= inv_pivot;
+            GB(0, j) = g1[j];
+            GB(1, j) = -c1*g1[j];
+            GB(2, j) = -c2*g1[j];
+            GB(3, j) = -c3*g1[j];
+        }
+        // -gx(i,:) - c(i)*Gamma_bottom(1,:) cancels in the diagonal terms: there it is
+        // -gx(i,j)*(pivot - c(i))/pivot, where pivot - c(i) is summed directly
+        GB(1, 0) = -gx_21*(-ln10*s + c2 + c3)*inv_pivot;
+        GB(2, 2) = -gx_33*(-ln10*s + c1 + c3)*inv_pivot;
+        GB(3, 4) = -gx_45*(-ln10*s + c1 + c2)*inv_pivot;
+    }
+#undef FX
+#undef FZ
+#undef GB
+    return n_singular;
+}
+
+} // namespace batch_reactor
+
+#endif
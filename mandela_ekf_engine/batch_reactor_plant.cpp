@@ -0,0 +1,88 @@
+// "Truth" plant of the simulation studies (see batch_reactor_plant.hpp)
+
+#include "batch_reactor_plant.hpp"
+#include "mandela_ekf.hpp"
+
+#include <cstddef>
+
+using namespace batch_reactor;
+
+batch_reactor_plant::batch_reactor_plant()
+    : initialised_(false)
+{
+}
+
+int batch_reactor_plant::init(const batch_reactor_plant_config &config, const double *X_init)
+{
+    if (initialised_) return MANDELA_EKF_INVALID_CONFIG;
+    if (!(config.Ts > 0) || config.temperature_profile.empty() ||
+        (config.process_noise != BATCH_REACTOR_PSEUDO_WHITE_NOISE && config.process_noise != BATCH_REACTOR_PIECEWISE_CONSTANT_NOISE)) {
+        return MANDELA_EKF_INVALID_CONFIG;
+    }
+
+    config_ = config;
+    ida_data_.model_params = config_.model_params;
+    ida_data_.rates.reset(config_.model_params);
+    ida_data_.temperature_profile = &config_.temperature_profile;
+    ida_data_.noise_Ts = 0.0;
+    ida_data_.process_noise = NULL;
+    if (config_.enable_process_noise && config_.process_noise == BATCH_REACTOR_PIECEWISE_CONSTANT_NOISE) {
+        const double bin_width = (config_.noise_bin_width > 0) ? config_.noise_bin_width : config_.Ts;
+        if (noise_.init(config_.noise_Q, config_.t0, bin_width, config_.noise_seed, config_.noise_stream) != 0) {
+            return MANDELA_EKF_INVALID_CONFIG;
+        }
+        ida_data_.process_noise = &noise_;
+    } else if (config_.enable_process_noise) {
+        ida_data_.noise_Ts = config_.Ts;
+    }
+
+    for (int i = 0; i < n_diff; i++) XZ_[i] = X_init[i];
+    for (int i = 0; i < n_alg; i++) XZ_[n_diff + i] = 0.0;
+    if (solve_algebraic_equations(XZ_, config_.model_params) != 0) return MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE;
+
+    // Initial derivatives from the residual at XZp = 0, with zero derivatives of the algebraic
+    // variables (as in the MATLAB scripts); IDACalcIC then makes them consistent
+    const double zeros[n_xz] = {0};
+    double res[n_xz];
+    const rate_coeffs &k = ida_data_.rates.get(config_.temperature_profile.eval(config_.t0));
+    if (ida_data_.process_noise) {
+        residual(XZ_, zeros, config_.model_params, k, noise_.eval(config_.t0), res);
+    } else if (ida_data_.noise_Ts > 0) {
+        double process_noise[n_diff];
+        pseudo_white_noise(config_.t0, ida_data_.noise_Ts, process_noise);
+        residual(XZ_, zeros, config_.model_params, k, process_noise, res);
+    } else {
+        residual(XZ_, zeros, config_.model_params, k, NULL, res);
+    }
+    for (int i = 0; i < n_xz; i++) XZp_[i] = (i < n_diff) ? -res[i] : 0.0;
+
+    double id[n_xz];
+    for (int i = 0; i < n_xz; i++) id[i] = (i < n_diff) ? 1.0 : 0.0;
+    int flag = integrator_.create(n_xz, XZ_, XZp_, id, config_.t0,
+                                  batch_reactor_ida_residual, batch_reactor_ida_jacobian, &ida_data_,
+                                  config_.rel_tol, config_.abs_tol, config_.max_num_steps);
+    if (flag == IDA_SUCCESS) flag = integrator_.calc_ic(config_.t0 + 0.1);
+    if (flag != IDA_SUCCESS) return MANDELA_EKF_INTEGRATOR_FAILURE;
+
+    initialised_ = true;
+    return MANDELA_EKF_SUCCESS;
+}
+
+int batch_reactor_plant::advance(double tout)
+{
+    if (!initialised_) return MANDELA_EKF_NOT_INITIALISED;
+    if (!(tout > integrator_.t())) return MANDELA_EKF_INVALID_CONFIG;
+    if (!ida_data_.process_noise) {
+        if (integrator_.advance(tout) != IDA_SUCCESS) return MANDELA_EKF_INTEGRATOR_FAILURE;
+        return MANDELA_EKF_SUCCESS;
+    }
+
+    for (double t = integrator_.t(); t < tout; t = integrator_.t()) {
+        double t_stop = noise_.next_edge(t);
+        if (t_stop > tout) t_stop = tout;
+        if (integrator_.set_stop_time(t_stop) != IDA_SUCCESS || integrator_.advance(t_stop) != IDA_SUCCESS) {
+            return MANDELA_EKF_INTEGRATOR_FAILURE;
+        }
+    }
+    return MANDELA_EKF_SUCCESS;
+}
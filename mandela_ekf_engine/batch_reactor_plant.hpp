@@ -0,0 +1,75 @@
+// "Truth" plant of the simulation studies: the batch reactor DAE with the pseudo white
+// process noise of batchChemReactorModel.m, or with piecewise-constant random process noise
+// (process_noise.hpp). The MATLAB scripts call IDAInit for the plant at
+// every sample (sundialsTB has a single IDA instance, which the EKF also uses); here the plant
+// owns its IDA instance, which is created once and never restarted, so that the integration
+// keeps its order and step size from one sample to the next.
+
+#ifndef BATCH_REACTOR_PLANT_HPP
+#define BATCH_REACTOR_PLANT_HPP
+
+#include "batch_reactor_model.hpp"
+#include "batch_reactor_model_ida.hpp"
+#include "dae_integrator.hpp"
+#include "input_profile.hpp"
+#include "process_noise.hpp"
+
+#include <stdint.h>
+
+// Process noise of the plant (with enable_process_noise)
+enum batch_reactor_process_noise {
+    BATCH_REACTOR_PSEUDO_WHITE_NOISE       = 0,  // the sinusoids of batchChemReactorModel.m
+    BATCH_REACTOR_PIECEWISE_CONSTANT_NOISE = 1   // counter-based random samples per time bin
+};
+
+struct batch_reactor_plant_config {
+    batch_reactor::model_params model_params;
+    double Ts;                       // sampling interval [sec] (sets the frequencies of the pseudo white noise)
+    double t0;                       // initial time [sec]
+    bool enable_process_noise;
+    int process_noise;               // batch_reactor_process_noise
+    // BATCH_REACTOR_PIECEWISE_CONSTANT_NOISE: continuous-time intensity Q (n_diff x n_diff), width of
+    // the bins [sec] (<= 0: Ts), and the stream (seed, stream) of counter_rng the samples come from
+    double noise_Q[batch_reactor::n_diff*batch_reactor::n_diff];
+    double noise_bin_width;
+    uint32_t noise_seed, noise_stream;
+    double rel_tol, abs_tol;         // IDA tolerances
+    long max_num_steps;
+    input_profile temperature_profile;  // Temperature (degC) vs time (sec)
+};
+
+class batch_reactor_plant {
+public:
+    static const int n_diff = batch_reactor::n_diff;
+    static const int n_alg  = batch_reactor::n_alg;
+    static const int n_xz   = batch_reactor::n_xz;
+
+    batch_reactor_plant();
+
+    // X_init: n_diff initial differential states. The algebraic variables are obtained from the
+    // algebraic equations. Returns a mandela_ekf_status code.
+    int init(const batch_reactor_plant_config &config, const double *X_init);
+
+    // Advances the plant to tout (> t()). With the piecewise-constant noise, IDA stops at every
+    // bin edge on the way, so that none of its steps straddles a jump of the noise. Returns a
+    // mandela_ekf_status code.
+    int advance(double tout);
+
+    const double *XZ() const { return XZ_; }
+    const double *XZp() const { return XZp_; }
+    double t() const { return integrator_.t(); }
+
+private:
+    batch_reactor_plant(const batch_reactor_plant &);
+    batch_reactor_plant &operator=(const batch_reactor_plant &);
+
+    batch_reactor_plant_config config_;
+    batch_reactor_ida_data ida_data_;
+    dae_integrator integrator_;
+    piecewise_constant_noise noise_;
+    bool initialised_;
+
+    double XZ_[n_xz], XZp_[n_xz];
+};
+
+#endif
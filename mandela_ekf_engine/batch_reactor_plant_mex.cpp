@@ -0,0 +1,93 @@
+/*
+ * MATLAB interface to the native "truth" plant of the batch reactor
+ *
+ * h = batch_reactor_plant_mex('new',plant_config)
+ * [XZ,XZp] = batch_reactor_plant_mex('advance',h,tout)
+ * [XZ,XZp,t] = batch_reactor_plant_mex('get',h)
+ * batch_reactor_plant_mex('delete',h)
+ *
+ * see batch_reactor_plant_mex.m for the fields of plant_config and
+ * make_mandela_ekf.m for the compile command
+ */
+
+#include "mex.h"
+#include "batch_reactor_plant.hpp"
+#include "mandela_ekf.hpp"
+#include "mex_config_fields.hpp"
+#include "mex_instance_table.hpp"
+
+#include <cstring>
+
+static const char *const config_err_id = "batch_reactor_plant:config";
+static mex_instance_table<batch_reactor_plant> instances;
+
+static void delete_all_instances(void)
+{
+    instances.clear();
+}
+
+static void return_state(int nlhs, mxArray *plhs[], const batch_reactor_plant *plant)
+{
+    const int n_xz = batch_reactor_plant::n_xz;
+    plhs[0] = mxCreateDoubleMatrix(n_xz, 1, mxREAL);
+    std::memcpy(mxGetPr(plhs[0]), plant->XZ(), n_xz*sizeof(double));
+    if (nlhs >= 2) {
+        plhs[1] = mxCreateDoubleMatrix(n_xz, 1, mxREAL);
+        std::memcpy(mxGetPr(plhs[1]), plant->XZp(), n_xz*sizeof(double));
+    }
+}
+
+static void new_instance(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    if (nrhs != 2 || !mxIsStruct(prhs[1])) mexErrMsgIdAndTxt("batch_reactor_plant:usage", "Usage: h = batch_reactor_plant_mex('new',plant_config)");
+    if (nlhs > 1) mexErrMsgIdAndTxt("batch_reactor_plant:usage", "Too many output arguments.");
+    const mxArray *s = prhs[1];
+
+    batch_reactor_plant_config config;
+    double X_init[batch_reactor_plant::n_diff];
+    get_plant_config(s, config, X_init, config_err_id);
+
+    batch_reactor_plant *plant = new batch_reactor_plant();
+    const int status = plant->init(config, X_init);
+    if (status != MANDELA_EKF_SUCCESS) {
+        delete plant;
+        mexErrMsgIdAndTxt("batch_reactor_plant:init", "Plant initialisation failed: %s", mandela_ekf_status_message(status));
+    }
+    plhs[0] = instances.add(plant);
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    char cmd[16];
+
+    mexAtExit(delete_all_instances);
+    if (nrhs < 1 || !mxIsChar(prhs[0]) || mxGetString(prhs[0], cmd, sizeof(cmd)) != 0) {
+        mexErrMsgIdAndTxt("batch_reactor_plant:usage", "First input must be one of 'new', 'advance', 'get' or 'delete'.");
+    }
+
+    if (std::strcmp(cmd, "new") == 0) {
+        new_instance(nlhs, plhs, nrhs, prhs);
+    }
+    else if (std::strcmp(cmd, "advance") == 0) {
+        if (nrhs != 3) mexErrMsgIdAndTxt("batch_reactor_plant:usage", "Usage: [XZ,XZp] = batch_reactor_plant_mex('advance',h,tout)");
+        batch_reactor_plant *plant = instances.get(prhs[1], "batch_reactor_plant:handle");
+        const int status = plant->advance(mxGetScalar(prhs[2]));
+        if (status != MANDELA_EKF_SUCCESS) {
+            mexErrMsgIdAndTxt("batch_reactor_plant:advance", "Plant integration failed at t = %g: %s", plant->t(), mandela_ekf_status_message(status));
+        }
+        return_state(nlhs, plhs, plant);
+    }
+    else if (std::strcmp(cmd, "get") == 0) {
+        if (nrhs != 2) mexErrMsgIdAndTxt("batch_reactor_plant:usage", "Usage: [XZ,XZp,t] = batch_reactor_plant_mex('get',h)");
+        const batch_reactor_plant *plant = instances.get(prhs[1], "batch_reactor_plant:handle");
+        return_state(nlhs, plhs, plant);
+        if (nlhs >= 3) plhs[2] = mxCreateDoubleScalar(plant->t());
+    }
+    else if (std::strcmp(cmd, "delete") == 0) {
+        if (nrhs != 2) mexErrMsgIdAndTxt("batch_reactor_plant:usage", "Usage: batch_reactor_plant_mex('delete',h)");
+        instances.remove(prhs[1], "batch_reactor_plant:handle");
+    }
+    else {
+        mexErrMsgIdAndTxt("batch_reactor_plant:usage", "Unknown command '%s'.", cmd);
+    }
+}
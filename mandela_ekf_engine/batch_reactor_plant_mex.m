@@ -0,0 +1,42 @@
+%BATCH_REACTOR_PLANT_MEX Native (compiled) "truth" plant of the batch chemical reactor.
+%   H = BATCH_REACTOR_PLANT_MEX('new',PLANT_CONFIG) creates a plant and returns
+%   its handle H. PLANT_CONFIG is a struct with the fields
+%       model_params  struct of model parameters (as in the MATLAB scripts)
+%       Ts            sampling interval [sec] (sets the frequencies of the
+%                     pseudo white process noise of batchChemReactorModel.m)
+%       t0            initial time [sec] (default 0)
+%       X_init        initial differential states (n_diff-by-1)
+%       time_profile  time [sec] of the input (temperature) profile
+%       Temp_profile  temperature [degC] at the times in time_profile
+%       profile_file  instead of time_profile and Temp_profile: a csv file
+%                     with time [hours] and temperature [degC] columns, e.g.
+%                     temperature_vs_time_profile.csv
+%       enable_process_noise  0 or 1 (default 1)
+%       ProcessNoise  'pseudo_white' (default): the sinusoids of
+%                     batchChemReactorModel.m. 'piecewise_constant': random
+%                     samples that are constant over bins of NoiseBinWidth
+%                     seconds, drawn from a counter-based generator (Philox)
+%                     indexed by the bin, so that the trajectory does not
+%                     depend on the steps of IDA
+%       Q             n_diff-by-n_diff continuous-time noise intensity of
+%                     'piecewise_constant' (positive semi-definite): the
+%                     samples have covariance Q/NoiseBinWidth
+%       NoiseBinWidth width of the bins [sec] (default Ts)
+%       noise_seed,noise_stream  key of the random numbers of
+%                     'piecewise_constant' (default 0)
+%       RelTol,AbsTol IDA tolerances (default 1e-6)
+%       MaxNumSteps   max. no. of IDA steps per call of 'advance' (default 1500)
+%   The algebraic variables are initialised from the algebraic equations and
+%   made consistent with IDACalcIC.
+%
+%   [XZ,XZp] = BATCH_REACTOR_PLANT_MEX('advance',H,TOUT) integrates the plant
+%   up to TOUT and returns the augmented state and its time derivative. The
+%   plant has its own IDA instance, which is never re-initialised, so it keeps
+%   its order and step size from one call to the next (unlike IDAInit at
+%   every sample in the MATLAB scripts).
+%
+%   [XZ,XZp,T] = BATCH_REACTOR_PLANT_MEX('get',H) returns the current state.
+%
+%   BATCH_REACTOR_PLANT_MEX('delete',H) releases the plant.
+%
+%   See also MANDELA_EKF_MEX, MAKE_MANDELA_EKF.
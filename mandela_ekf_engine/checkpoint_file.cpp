@@ -0,0 +1,132 @@
+// Checkpoint files of the Mandela EKF (see checkpoint_file.hpp)
+
+#include "checkpoint_file.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+struct checkpoint_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t payload_size;
+    uint32_t n_xz, n_diff;
+    uint32_t checksum;
+};
+
+static const char checkpoint_magic[8] = {'M', 'E', 'K', 'F', 'C', 'K', 'P', 'T'};
+
+static uint32_t fnv1a(const void *data, size_t n)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int write_checkpoint(const char *path, const mandela_ekf_snapshot &snapshot)
+{
+    checkpoint_header header;
+    std::memcpy(header.magic, checkpoint_magic, sizeof(header.magic));
+    header.version = checkpoint_format_version;
+    header.byte_order = 0x01020304u;
+    header.payload_size = sizeof(mandela_ekf_snapshot);
+    header.n_xz = batch_reactor::n_xz;
+    header.n_diff = batch_reactor::n_diff;
+    header.checksum = fnv1a(&snapshot, sizeof(snapshot));
+
+    const std::string tmp_path = std::string(path) + ".tmp";
+    std::FILE *f = std::fopen(tmp_path.c_str(), "wb");
+    if (!f) return MANDELA_EKF_CHECKPOINT_FAILURE;
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1 && std::fwrite(&snapshot, sizeof(snapshot), 1, f) == 1;
+    ok = (std::fclose(f) == 0) && ok;
+#ifdef _WIN32
+    if (ok) std::remove(path);  // rename() does not replace an existing file on Windows
+#endif
+    if (!ok || std::rename(tmp_path.c_str(), path) != 0) {
+        std::remove(tmp_path.c_str());
+        return MANDELA_EKF_CHECKPOINT_FAILURE;
+    }
+    return MANDELA_EKF_SUCCESS;
+}
+
+int read_checkpoint(const char *path, mandela_ekf_snapshot &snapshot)
+{
+    std::FILE *f = std::fopen(path, "rb");
+    if (!f) return MANDELA_EKF_CHECKPOINT_FAILURE;
+    checkpoint_header header;
+    mandela_ekf_snapshot s;
+    const bool ok = std::fread(&header, sizeof(header), 1, f) == 1 &&
+                    std::memcmp(header.magic, checkpoint_magic, sizeof(header.magic)) == 0 &&
+                    header.version == checkpoint_format_version && header.byte_order == 0x01020304u &&
+                    header.payload_size == sizeof(s) && header.n_xz == (uint32_t)batch_reactor::n_xz &&
+                    header.n_diff == (uint32_t)batch_reactor::n_diff &&
+                    std::fread(&s, sizeof(s), 1, f) == 1 && header.checksum == fnv1a(&s, sizeof(s));
+    std::fclose(f);
+    if (!ok) return MANDELA_EKF_CHECKPOINT_FAILURE;
+    snapshot = s;
+    return MANDELA_EKF_SUCCESS;
+}
+
+checkpoint_writer::checkpoint_writer(const char *path)
+    : path_(path), has_pending_(false), busy_(false), stop_(false), status_(MANDELA_EKF_SUCCESS), n_written_(0)
+{
+    worker_ = std::thread(&checkpoint_writer::worker_loop, this);
+}
+
+checkpoint_writer::~checkpoint_writer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_one();
+    worker_.join();
+}
+
+void checkpoint_writer::submit(const mandela_ekf_snapshot &snapshot)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ = snapshot;
+        has_pending_ = true;
+    }
+    work_cv_.notify_one();
+}
+
+int checkpoint_writer::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (has_pending_ || busy_) done_cv_.wait(lock);
+    return status_;
+}
+
+long checkpoint_writer::n_written() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return n_written_;
+}
+
+void checkpoint_writer::worker_loop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        while (!has_pending_ && !stop_) work_cv_.wait(lock);
+        if (!has_pending_) break;  // stopped, and nothing left to write
+        writing_ = pending_;
+        has_pending_ = false;
+        busy_ = true;
+
+        lock.unlock();
+        const int status = write_checkpoint(path_.c_str(), writing_);
+        lock.lock();
+
+        busy_ = false;
+        status_ = status;
+        if (status == MANDELA_EKF_SUCCESS) n_written_++;
+        done_cv_.notify_all();
+    }
+}
@@ -0,0 +1,64 @@
+// Checkpoint files of the Mandela EKF: a mandela_ekf_snapshot in a versioned binary format, and a
+// background writer, so that a long-running estimation loop can checkpoint without waiting for
+// the disk.
+//
+// File layout (native byte order, 32-byte header followed by the payload):
+//     char     magic[8]      "MEKFCKPT"
+//     uint32_t version       checkpoint_format_version
+//     uint32_t byte_order    0x01020304 as written (a file from a machine of the other endianness is rejected)
+//     uint32_t payload_size  sizeof(mandela_ekf_snapshot)
+//     uint32_t n_xz, n_diff  dimensions of the model
+//     uint32_t checksum      FNV-1a of the payload
+//     payload                the mandela_ekf_snapshot (fixed-width members without padding)
+// A file is written under a temporary name and renamed when complete, so that a crash while
+// writing leaves the previous checkpoint intact.
+
+#ifndef CHECKPOINT_FILE_HPP
+#define CHECKPOINT_FILE_HPP
+
+#include "mandela_ekf.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+const uint32_t checkpoint_format_version = 2;
+
+// Return a mandela_ekf_status code (MANDELA_EKF_CHECKPOINT_FAILURE if the file cannot be written
+// or read, or is not a checkpoint of this version and model)
+int write_checkpoint(const char *path, const mandela_ekf_snapshot &snapshot);
+int read_checkpoint(const char *path, mandela_ekf_snapshot &snapshot);
+
+// Writes the snapshots handed to submit() to one file, on its own thread. submit() only copies the
+// snapshot; if the previous one is still being written, the new one waits in a second buffer and
+// replaces any older snapshot that is still waiting (only the latest state is worth writing).
+class checkpoint_writer {
+public:
+    explicit checkpoint_writer(const char *path);
+    ~checkpoint_writer();  // writes the waiting snapshot, if any
+
+    void submit(const mandela_ekf_snapshot &snapshot);
+
+    // Waits until the last submitted snapshot is on disk; returns the status of the last write
+    int flush();
+
+    long n_written() const;
+
+private:
+    checkpoint_writer(const checkpoint_writer &);
+    checkpoint_writer &operator=(const checkpoint_writer &);
+
+    void worker_loop();
+
+    std::string path_;
+    mandela_ekf_snapshot pending_, writing_;
+    bool has_pending_, busy_, stop_;
+    int status_;
+    long n_written_;
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_, done_cv_;
+    std::thread worker_;
+};
+
+#endif
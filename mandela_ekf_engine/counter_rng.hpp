@@ -0,0 +1,75 @@
+// Counter-based random numbers: Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy
+// as 1, 2, 3", SC11). Every number is a pure function of (key, counter), so a simulation run that
+// owns its key draws the same numbers whatever the number of threads and the order of the runs.
+
+#ifndef COUNTER_RNG_HPP
+#define COUNTER_RNG_HPP
+
+#include <cmath>
+#include <stdint.h>
+
+namespace counter_rng {
+
+inline void philox4x32_10(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4])
+{
+    const uint32_t M0 = 0xD2511F53u, M1 = 0xCD9E8D57u;
+    const uint32_t W0 = 0x9E3779B9u, W1 = 0xBB67AE85u;
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+
+    for (int round = 0; round < 10; round++) {
+        const uint64_t p0 = (uint64_t)M0*c0;
+        const uint64_t p1 = (uint64_t)M1*c2;
+        const uint32_t hi0 = (uint32_t)(p0 >> 32), lo0 = (uint32_t)p0;
+        const uint32_t hi1 = (uint32_t)(p1 >> 32), lo1 = (uint32_t)p1;
+        c0 = hi1 ^ c1 ^ k0;
+        c1 = lo1;
+        c2 = hi0 ^ c3 ^ k1;
+        c3 = lo0;
+        k0 += W0;
+        k1 += W1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+// Standard normal numbers of one stream (e.g. one Monte Carlo run), addressed by a purpose
+// (what the numbers are used for) and a sample index. Each block of four 32-bit outputs gives two
+// uniform numbers with 53-bit resolution in (0,1), and two normal numbers (Box-Muller).
+class normal_stream {
+public:
+    normal_stream(uint32_t seed, uint32_t stream)
+    {
+        key_[0] = seed;
+        key_[1] = stream;
+    }
+
+    // n normal numbers for (purpose, sample); the same arguments always give the same numbers
+    void draw(uint32_t purpose, uint32_t sample, int n, double *z) const
+    {
+        const double two_pi = 6.283185307179586;
+        uint32_t counter[4] = {0u, sample, purpose, 0u};
+        uint32_t bits[4];
+        for (int i = 0; i < n; i += 2) {
+            counter[0] = (uint32_t)(i/2);
+            philox4x32_10(counter, key_, bits);
+            const double u1 = uniform(bits[0], bits[1]);
+            const double u2 = uniform(bits[2], bits[3]);
+            const double r = std::sqrt(-2.0*std::log(u1));
+            z[i] = r*std::cos(two_pi*u2);
+            if (i + 1 < n) z[i+1] = r*std::sin(two_pi*u2);
+        }
+    }
+
+private:
+    static double uniform(uint32_t hi, uint32_t lo)
+    {
+        const uint64_t bits53 = (((uint64_t)hi << 32) | lo) >> 11;
+        return (bits53 + 0.5)*(1.0/9007199254740992.0);  // (0,1): log() stays finite
+    }
+
+    uint32_t key_[2];
+};
+
+} // namespace counter_rng
+
+#endif
@@ -0,0 +1,116 @@
+// Thin wrapper around one SUNDIALS IDA solver instance (see dae_integrator.hpp)
+
+#include "dae_integrator.hpp"
+
+#include <cstddef>
+
+dae_integrator::dae_integrator()
+    : ida_mem(NULL), yy(NULL), yp_(NULL), id_(NULL), n_s_(0), yS_(NULL), ypS_(NULL), J(NULL), LS(NULL), t_(0.0)
+{
+}
+
+dae_integrator::~dae_integrator()
+{
+    if (ida_mem) IDAFree(&ida_mem);
+    if (LS) SUNLinSolFree(LS);
+    if (J) SUNMatDestroy(J);
+    for (int j = 0; j < n_s_; j++) {
+        if (yS_[j]) N_VDestroy(yS_[j]);
+        if (ypS_[j]) N_VDestroy(ypS_[j]);
+    }
+    delete[] yS_;
+    delete[] ypS_;
+    if (id_) N_VDestroy(id_);
+    if (yp_) N_VDestroy(yp_);
+    if (yy) N_VDestroy(yy);
+}
+
+int dae_integrator::create(int n, double *y, double *yp, const double *id, double t0,
+                           IDAResFn res, IDALsJacFn jac, void *user_data,
+                           double rel_tol, double abs_tol, long max_num_steps)
+{
+    if (ida_mem) return IDA_ILL_INPUT;
+
+    yy  = N_VMake_Serial(n, y);
+    yp_ = N_VMake_Serial(n, yp);
+    id_ = N_VNew_Serial(n);
+    if (!yy || !yp_ || !id_) return IDA_MEM_FAIL;
+    for (int i = 0; i < n; i++) NV_Ith_S(id_, i) = id[i];
+
+    ida_mem = IDACreate();
+    if (!ida_mem) return IDA_MEM_FAIL;
+
+    int flag = IDAInit(ida_mem, res, t0, yy, yp_);
+    if (flag == IDA_SUCCESS) flag = IDASStolerances(ida_mem, rel_tol, abs_tol);
+    if (flag == IDA_SUCCESS) flag = IDASetUserData(ida_mem, user_data);
+    if (flag == IDA_SUCCESS) flag = IDASetId(ida_mem, id_);
+    if (flag == IDA_SUCCESS) flag = IDASetMaxNumSteps(ida_mem, max_num_steps);
+    if (flag != IDA_SUCCESS) return flag;
+
+    J  = SUNDenseMatrix(n, n);
+    LS = SUNLinSol_Dense(yy, J);
+    if (!J || !LS) return IDA_MEM_FAIL;
+    flag = IDASetLinearSolver(ida_mem, LS, J);
+    if (flag == IDA_SUCCESS && jac) flag = IDASetJacFn(ida_mem, jac);
+
+    t_ = t0;
+    return flag;
+}
+
+int dae_integrator::init_sensitivities(int n_s, double *yS, double *ypS, IDASensResFn res_s)
+{
+    if (!ida_mem || n_s_ > 0 || n_s < 1) return IDA_ILL_INPUT;
+
+    yS_  = new N_Vector[n_s];
+    ypS_ = new N_Vector[n_s];
+    n_s_ = n_s;
+    const int n = (int)NV_LENGTH_S(yy);
+    for (int j = 0; j < n_s; j++) {
+        yS_[j]  = N_VMake_Serial(n, yS + j*n);
+        ypS_[j] = N_VMake_Serial(n, ypS + j*n);
+        if (!yS_[j] || !ypS_[j]) return IDA_MEM_FAIL;
+    }
+
+    int flag = IDASensInit(ida_mem, n_s, IDA_STAGGERED, res_s, yS_, ypS_);
+    if (flag == IDA_SUCCESS) flag = IDASensEEtolerances(ida_mem);
+    if (flag == IDA_SUCCESS) flag = IDASetSensErrCon(ida_mem, SUNTRUE);
+    return flag;
+}
+
+int dae_integrator::reinit(double t0, double h_init)
+{
+    t_ = t0;
+    int flag = IDAReInit(ida_mem, t0, yy, yp_);
+    if (flag == IDA_SUCCESS && n_s_ > 0) flag = IDASensReInit(ida_mem, IDA_STAGGERED, yS_, ypS_);
+    if (flag == IDA_SUCCESS) flag = IDASetInitStep(ida_mem, h_init);  // 0 restores IDA's own estimate
+    return flag;
+}
+
+int dae_integrator::calc_ic(double tout1)
+{
+    int flag = IDACalcIC(ida_mem, IDA_YA_YDP_INIT, tout1);
+    if (flag == IDA_SUCCESS) flag = IDAGetConsistentIC(ida_mem, yy, yp_);
+    return flag;
+}
+
+int dae_integrator::advance(double tout)
+{
+    realtype tret;
+    const int flag = IDASolve(ida_mem, tout, &tret, yy, yp_, IDA_NORMAL);
+    if (flag < 0) return flag;
+    if (n_s_ > 0 && IDAGetSens(ida_mem, &tret, yS_) < 0) return IDA_ILL_INPUT;
+    t_ = tret;
+    return IDA_SUCCESS;
+}
+
+int dae_integrator::set_stop_time(double t_stop)
+{
+    return IDASetStopTime(ida_mem, t_stop);
+}
+
+double dae_integrator::last_step() const
+{
+    realtype h = 0.0;
+    if (ida_mem) IDAGetLastStep(ida_mem, &h);
+    return h;
+}
@@ -0,0 +1,63 @@
+// Thin wrapper around one SUNDIALS IDA solver instance (dense direct linear solver).
+// The state vectors wrap caller-owned storage (N_VMake_Serial), so advancing the
+// solution does not allocate. It is built on IDAS, the variant of IDA with forward
+// sensitivities; without init_sensitivities() it behaves as IDA.
+
+#ifndef DAE_INTEGRATOR_HPP
+#define DAE_INTEGRATOR_HPP
+
+#include <idas/idas.h>
+#include <nvector/nvector_serial.h>
+#include <sunlinsol/sunlinsol_dense.h>
+#include <sunmatrix/sunmatrix_dense.h>
+
+class dae_integrator {
+public:
+    dae_integrator();
+    ~dae_integrator();
+
+    // y and yp (length n) hold the initial values and receive the solution afterwards.
+    // id(i) = 1 for differential and 0 for algebraic components. Returns an IDA flag.
+    int create(int n, double *y, double *yp, const double *id, double t0,
+               IDAResFn res, IDALsJacFn jac, void *user_data,
+               double rel_tol, double abs_tol, long max_num_steps);
+
+    // Forward sensitivities of the solution: the n_s columns of yS (n x n_s, column-major,
+    // caller-owned like y) with their derivatives in ypS, whose residuals are given by res_s.
+    // They are integrated with the solution (staggered corrector, on IDA's Newton matrix and its
+    // factorisation), take part in the error control, restart from the values currently stored
+    // in yS and ypS with every reinit(), and yS receives them after every advance().
+    int init_sensitivities(int n_s, double *yS, double *ypS, IDASensResFn res_s);
+
+    // Restarts the integration from the values currently stored in y and yp. If h_init > 0,
+    // the first step of the new integration is h_init, instead of IDA's (very small) estimate.
+    int reinit(double t0, double h_init = 0.0);
+
+    // Corrects the algebraic components (and the derivatives of the differential ones)
+    int calc_ic(double tout1);
+
+    // Advances the solution to tout (IDA_NORMAL mode)
+    int advance(double tout);
+
+    // The next advance() does not step past t_stop (IDA's internal steps otherwise overshoot tout)
+    int set_stop_time(double t_stop);
+
+    double t() const { return t_; }
+
+    // Step size of the last successful internal step (0 before the first step)
+    double last_step() const;
+
+private:
+    dae_integrator(const dae_integrator &);
+    dae_integrator &operator=(const dae_integrator &);
+
+    void *ida_mem;
+    N_Vector yy, yp_, id_;
+    int n_s_;
+    N_Vector *yS_, *ypS_;
+    SUNMatrix J;
+    SUNLinearSolver LS;
+    double t_;
+};
+
+#endif
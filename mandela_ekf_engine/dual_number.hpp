@@ -0,0 +1,119 @@
+// Forward-mode automatic differentiation with dual numbers: a dual<N> carries a value and its
+// gradient with respect to N independent variables, and every arithmetic operation propagates
+// both (chain rule). Evaluating the model equations once on dual<N> arguments seeded with the
+// unit vectors therefore yields the exact (to rounding) dense Jacobian, without finite
+// differences and without a hand-coded derivative for every term.
+
+#ifndef DUAL_NUMBER_HPP
+#define DUAL_NUMBER_HPP
+
+#include <cmath>
+
+template <int N>
+struct dual {
+    double v;     // value
+    double d[N];  // gradient
+
+    dual() : v(0.0) { for (int i = 0; i < N; i++) d[i] = 0.0; }
+    dual(double value) : v(value) { for (int i = 0; i < N; i++) d[i] = 0.0; }
+
+    // independent variable number i (0-based)
+    static dual variable(double value, int i)
+    {
+        dual x(value);
+        x.d[i] = 1.0;
+        return x;
+    }
+};
+
+template <int N>
+inline dual<N> operator-(const dual<N> &a)
+{
+    dual<N> r;
+    r.v = -a.v;
+    for (int i = 0; i < N; i++) r.d[i] = -a.d[i];
+    return r;
+}
+
+template <int N>
+inline dual<N> operator+(const dual<N> &a, const dual<N> &b)
+{
+    dual<N> r;
+    r.v = a.v + b.v;
+    for (int i = 0; i < N; i++) r.d[i] = a.d[i] + b.d[i];
+    return r;
+}
+
+template <int N>
+inline dual<N> operator-(const dual<N> &a, const dual<N> &b)
+{
+    dual<N> r;
+    r.v = a.v - b.v;
+    for (int i = 0; i < N; i++) r.d[i] = a.d[i] - b.d[i];
+    return r;
+}
+
+template <int N>
+inline dual<N> operator*(const dual<N> &a, const dual<N> &b)
+{
+    dual<N> r;
+    r.v = a.v*b.v;
+    for (int i = 0; i < N; i++) r.d[i] = a.d[i]*b.v + a.v*b.d[i];
+    return r;
+}
+
+template <int N>
+inline dual<N> operator/(const dual<N> &a, const dual<N> &b)
+{
+    dual<N> r;
+    const double inv_b = 1.0/b.v;
+    r.v = a.v*inv_b;
+    for (int i = 0; i < N; i++) r.d[i] = (a.d[i] - r.v*b.d[i])*inv_b;
+    return r;
+}
+
+// mixed operations with constants (no gradient)
+template <int N> inline dual<N> operator+(const dual<N> &a, double b) { dual<N> r(a); r.v += b; return r; }
+template <int N> inline dual<N> operator+(double a, const dual<N> &b) { return b + a; }
+template <int N> inline dual<N> operator-(const dual<N> &a, double b) { dual<N> r(a); r.v -= b; return r; }
+template <int N> inline dual<N> operator-(double a, const dual<N> &b) { return -b + a; }
+
+template <int N>
+inline dual<N> operator*(double a, const dual<N> &b)
+{
+    dual<N> r;
+    r.v = a*b.v;
+    for (int i = 0; i < N; i++) r.d[i] = a*b.d[i];
+    return r;
+}
+
+template <int N> inline dual<N> operator*(const dual<N> &a, double b) { return b*a; }
+template <int N> inline dual<N> operator/(const dual<N> &a, double b) { return (1.0/b)*a; }
+
+template <int N>
+inline dual<N> operator/(double a, const dual<N> &b)
+{
+    dual<N> r;
+    r.v = a/b.v;
+    const double f = -r.v/b.v;
+    for (int i = 0; i < N; i++) r.d[i] = f*b.d[i];
+    return r;
+}
+
+// 10^(-x), i.e. the hydrogen ion concentration from the pH in the algebraic equations
+inline double pow10_neg(double x)
+{
+    return std::pow(10.0, -x);
+}
+
+template <int N>
+inline dual<N> pow10_neg(const dual<N> &x)
+{
+    dual<N> r;
+    r.v = std::pow(10.0, -x.v);
+    const double f = -2.302585092994045684*r.v;  // d(10^(-x))/dx = -ln(10)*10^(-x)
+    for (int i = 0; i < N; i++) r.d[i] = f*x.d[i];
+    return r;
+}
+
+#endif
@@ -0,0 +1,91 @@
+// Piecewise-linear input profile, i.e. interp1(time_profile,Temp_profile,t,'linear','extrap').
+// The slopes are precomputed and the segment of the last evaluation is kept: IDA evaluates the
+// profile at (nearly) monotone times, so a lookup is O(1) and the binary search is only needed
+// after a jump, e.g. a re-initialisation at an earlier time.
+
+#ifndef INPUT_PROFILE_HPP
+#define INPUT_PROFILE_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+class input_profile {
+public:
+    input_profile() : segment_(0) {}
+
+    // time must be strictly increasing; returns false otherwise
+    bool assign(const double *time, const double *value, int n_points)
+    {
+        if (n_points < 2) return false;
+        for (int i = 1; i < n_points; i++) {
+            if (!(time[i] > time[i-1])) return false;
+        }
+        time_.assign(time, time + n_points);
+        value_.assign(value, value + n_points);
+        slope_.resize(n_points - 1);
+        for (int i = 0; i < n_points - 1; i++) {
+            slope_[i] = (value_[i+1] - value_[i])/(time_[i+1] - time_[i]);
+        }
+        segment_ = 0;
+        return true;
+    }
+
+    // Two comma-separated columns (time, value) per line, e.g.
+    // input_temperature_profile_vs_time/temperature_vs_time_profile.csv (time in hours, hence
+    // time_scale = 3600). Lines that do not start with two numbers (headers) are skipped.
+    bool load_csv(const char *file_name, double time_scale)
+    {
+        std::FILE *fp = std::fopen(file_name, "r");
+        if (!fp) return false;
+
+        std::vector<double> time, value;
+        char line[256];
+        while (std::fgets(line, sizeof(line), fp)) {
+            char *end_t, *end_v;
+            const double t = std::strtod(line, &end_t);
+            if (end_t == line || *end_t != ',') continue;
+            const double v = std::strtod(end_t + 1, &end_v);
+            if (end_v == end_t + 1) continue;
+            time.push_back(t*time_scale);
+            value.push_back(v);
+        }
+        std::fclose(fp);
+
+        if (time.empty()) return false;
+        return assign(&time[0], &value[0], static_cast<int>(time.size()));
+    }
+
+    bool empty() const { return time_.empty(); }
+    int n_points() const { return static_cast<int>(time_.size()); }
+
+    double eval(double t) const
+    {
+        // Segment i covers [time_[i], time_[i+1]); the first and the last segment are extended
+        // for the extrapolation
+        const int last = static_cast<int>(slope_.size()) - 1;
+        int i = segment_;
+        if (i > 0 && t < time_[i]) {
+            i = (i == 1 || t >= time_[i-1]) ? i - 1 : find_segment(t);
+        } else if (i < last && t >= time_[i+1]) {
+            i = (i + 1 == last || t < time_[i+2]) ? i + 1 : find_segment(t);
+        }
+        segment_ = i;
+        return value_[i] + slope_[i]*(t - time_[i]);
+    }
+
+private:
+    int find_segment(double t) const
+    {
+        // first breakpoint after t among time_[1..n-2], i.e. the end of the segment
+        return static_cast<int>(std::upper_bound(time_.begin() + 1, time_.end() - 1, t) - time_.begin()) - 1;
+    }
+
+    std::vector<double> time_;
+    std::vector<double> value_;
+    std::vector<double> slope_;
+    mutable int segment_;  // segment of the last evaluation
+};
+
+#endif
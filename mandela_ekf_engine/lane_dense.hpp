@@ -0,0 +1,199 @@
+// Dense linear algebra kernels for L independent small matrices at once ("lanes"), in
+// structure-of-arrays layout: element (i,j) of the matrix of lane l is A[(i + j*rows)*L + l].
+// Every kernel is the loop nest of its small_dense counterpart with an innermost loop over the
+// lanes, which has a compile-time trip count and unit stride, so that the compiler maps it onto
+// vector registers (4 lanes per AVX2 register, 8 per AVX-512 register). Row exchanges of the
+// LU factorisation are done per lane with selects, so that no lane branches.
+
+#ifndef LANE_DENSE_HPP
+#define LANE_DENSE_HPP
+
+#include <cmath>
+
+namespace lane_dense {
+
+template <int M, int N, int L>
+inline void copy(const double *A, double *B)
+{
+    for (int i = 0; i < M*N*L; i++) B[i] = A[i];
+}
+
+template <int N, int L>
+inline void identity(double *A)
+{
+    for (int i = 0; i < N*N*L; i++) A[i] = 0.0;
+    for (int i = 0; i < N; i++) {
+        for (int l = 0; l < L; l++) A[(i + i*N)*L + l] = 1.0;
+    }
+}
+
+// Matrix of lane l from/to a column-major M x N matrix
+template <int M, int N, int L>
+inline void set_lane(double *A, int l, const double *a)
+{
+    for (int i = 0; i < M*N; i++) A[i*L + l] = a[i];
+}
+
+template <int M, int N, int L>
+inline void get_lane(const double *A, int l, double *a)
+{
+    for (int i = 0; i < M*N; i++) a[i] = A[i*L + l];
+}
+
+// Block C(i:i+R-1, j:j+CB-1) of every lane, accumulated over k in registers: each step loads
+// R vectors of A and CB vectors of B for R*CB multiply-adds
+template <int M, int K, int N, int L, bool TRANS_B, int R, int CB>
+inline void mat_mul_block(const double *A, const double *B, double *C, int i, int j)
+{
+    double c[R][CB][L];
+    for (int r = 0; r < R; r++) {
+        for (int q = 0; q < CB; q++) {
+            for (int l = 0; l < L; l++) c[r][q][l] = 0.0;
+        }
+    }
+    for (int k = 0; k < K; k++) {
+        for (int q = 0; q < CB; q++) {
+            const double *b = B + (TRANS_B ? (j + q + k*N) : (k + (j + q)*K))*L;
+            for (int r = 0; r < R; r++) {
+                const double *a = A + (i + r + k*M)*L;
+                for (int l = 0; l < L; l++) c[r][q][l] += a[l]*b[l];
+            }
+        }
+    }
+    for (int r = 0; r < R; r++) {
+        for (int q = 0; q < CB; q++) {
+            for (int l = 0; l < L; l++) C[(i + r + (j + q)*M)*L + l] = c[r][q][l];
+        }
+    }
+}
+
+template <int M, int K, int N, int L, bool TRANS_B>
+inline void mat_mul_lanes(const double *A, const double *B, double *C)
+{
+    int j = 0;
+    for (; j + 1 < N; j += 2) {
+        int i = 0;
+        for (; i + 1 < M; i += 2) mat_mul_block<M, K, N, L, TRANS_B, 2, 2>(A, B, C, i, j);
+        if (i < M) mat_mul_block<M, K, N, L, TRANS_B, 1, 2>(A, B, C, i, j);
+    }
+    if (j < N) {
+        int i = 0;
+        for (; i + 1 < M; i += 2) mat_mul_block<M, K, N, L, TRANS_B, 2, 1>(A, B, C, i, j);
+        if (i < M) mat_mul_block<M, K, N, L, TRANS_B, 1, 1>(A, B, C, i, j);
+    }
+}
+
+// C = A*B, with A (M x K) and B (K x N)
+template <int M, int K, int N, int L>
+inline void mat_mul(const double *A, const double *B, double *C)
+{
+    mat_mul_lanes<M, K, N, L, false>(A, B, C);
+}
+
+// C = A*B', with A (M x K) and B (N x K)
+template <int M, int K, int N, int L>
+inline void mat_mul_nt(const double *A, const double *B, double *C)
+{
+    mat_mul_lanes<M, K, N, L, true>(A, B, C);
+}
+
+// In-place LU factorisation with partial pivoting of every lane (pivots piv[k*L + l], 0-based).
+// info[l] is 0 on success and k+1 if U(k,k) of lane l is exactly zero; a singular lane is
+// carried on with a zero multiplier, so that it does not produce infinities in the others.
+// Returns the no. of singular lanes.
+template <int N, int L>
+inline int lu_factor(double *A, int *piv, int *info)
+{
+    for (int l = 0; l < L; l++) info[l] = 0;
+    for (int k = 0; k < N; k++) {
+        int *p = piv + k*L;
+        double amax[L];
+        for (int l = 0; l < L; l++) {
+            p[l] = k;
+            amax[l] = std::fabs(A[(k + k*N)*L + l]);
+        }
+        for (int i = k + 1; i < N; i++) {
+            for (int l = 0; l < L; l++) {
+                const double a = std::fabs(A[(i + k*N)*L + l]);
+                const bool larger = a > amax[l];
+                amax[l] = larger ? a : amax[l];
+                p[l] = larger ? i : p[l];
+            }
+        }
+        for (int l = 0; l < L; l++) {
+            if (amax[l] == 0.0 && info[l] == 0) info[l] = k + 1;
+        }
+
+        // Row exchange k <-> p[l] of every column, by selects over the rows below k
+        for (int j = 0; j < N; j++) {
+            double *col = A + j*N*L;
+            for (int i = k + 1; i < N; i++) {
+                for (int l = 0; l < L; l++) {
+                    const bool swap = (p[l] == i);
+                    const double a_k = col[k*L + l], a_i = col[i*L + l];
+                    col[k*L + l] = swap ? a_i : a_k;
+                    col[i*L + l] = swap ? a_k : a_i;
+                }
+            }
+        }
+
+        double inv_pivot[L];
+        for (int l = 0; l < L; l++) {
+            const double d = A[(k + k*N)*L + l];
+            inv_pivot[l] = (d != 0.0) ? 1.0/d : 0.0;
+        }
+        for (int i = k + 1; i < N; i++) {
+            for (int l = 0; l < L; l++) A[(i + k*N)*L + l] *= inv_pivot[l];
+        }
+        for (int j = k + 1; j < N; j++) {
+            const double *a_kj = A + (k + j*N)*L;
+            for (int i = k + 1; i < N; i++) {
+                const double *a_ik = A + (i + k*N)*L;
+                double *a_ij = A + (i + j*N)*L;
+                for (int l = 0; l < L; l++) a_ij[l] -= a_ik[l]*a_kj[l];
+            }
+        }
+    }
+    int n_singular = 0;
+    for (int l = 0; l < L; l++) n_singular += (info[l] != 0);
+    return n_singular;
+}
+
+// Solves A*X = B in place for every lane (B is N x NRHS), given the output of lu_factor.
+// The diagonal of a singular lane is treated as one.
+template <int N, int NRHS, int L>
+inline void lu_solve(const double *LU, const int *piv, double *B)
+{
+    for (int r = 0; r < NRHS; r++) {
+        double *b = B + r*N*L;
+        for (int k = 0; k < N; k++) {
+            const int *p = piv + k*L;
+            for (int i = k + 1; i < N; i++) {
+                for (int l = 0; l < L; l++) {
+                    const bool swap = (p[l] == i);
+                    const double b_k = b[k*L + l], b_i = b[i*L + l];
+                    b[k*L + l] = swap ? b_i : b_k;
+                    b[i*L + l] = swap ? b_k : b_i;
+                }
+            }
+        }
+        for (int j = 0; j < N; j++) {
+            for (int i = j + 1; i < N; i++) {
+                const double *lu = LU + (i + j*N)*L;
+                for (int l = 0; l < L; l++) b[i*L + l] -= lu[l]*b[j*L + l];
+            }
+        }
+        for (int j = N - 1; j >= 0; j--) {
+            const double *d = LU + (j + j*N)*L;
+            for (int l = 0; l < L; l++) b[j*L + l] /= (d[l] != 0.0) ? d[l] : 1.0;
+            for (int i = 0; i < j; i++) {
+                const double *lu = LU + (i + j*N)*L;
+                for (int l = 0; l < L; l++) b[i*L + l] -= lu[l]*b[j*L + l];
+            }
+        }
+    }
+}
+
+} // namespace lane_dense
+
+#endif
@@ -0,0 +1,113 @@
+// Line-by-line reading of a pipe or file descriptor into a fixed buffer, with the arrival time
+// of every line and an optional idle timeout (POSIX), and parsing of the sample lines, for the
+// streaming modes of the engine
+
+#ifndef LINE_READER_HPP
+#define LINE_READER_HPP
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <poll.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock stream_clock;
+
+inline double microseconds(stream_clock::time_point from, stream_clock::time_point to)
+{
+    return std::chrono::duration<double, std::micro>(to - from).count();
+}
+
+class line_reader {
+public:
+    explicit line_reader(int fd) : fd_(fd), begin_(0), end_(0) {}
+
+    // 1: the next line is in *line (NUL-terminated) and arrived at *arrival, 0: end of the input,
+    // -1: read error or line too long, -2: no data for timeout_ms (if > 0)
+    int next(char **line, stream_clock::time_point *arrival, int timeout_ms)
+    {
+        for (;;) {
+            char *nl = static_cast<char *>(std::memchr(buf_ + begin_, '\n', end_ - begin_));
+            if (nl) {
+                *nl = '\0';
+                *line = buf_ + begin_;
+                *arrival = last_read_;
+                begin_ = nl + 1 - buf_;
+                return 1;
+            }
+            if (begin_ > 0) {
+                std::memmove(buf_, buf_ + begin_, end_ - begin_);
+                end_ -= begin_;
+                begin_ = 0;
+            }
+            if (end_ == sizeof(buf_) - 1) return -1;
+
+            if (timeout_ms > 0) {
+                struct pollfd pfd;
+                pfd.fd = fd_;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                const int ready = poll(&pfd, 1, timeout_ms);
+                if (ready == 0) return -2;
+                if (ready < 0 && errno != EINTR) return -1;
+                if (ready < 0) continue;
+            }
+            const ssize_t n = read(fd_, buf_ + end_, sizeof(buf_) - 1 - end_);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return -1;
+            last_read_ = stream_clock::now();
+            if (n == 0) {
+                if (end_ == 0) return 0;
+                buf_[end_] = '\0';  // last line without a newline
+                *line = buf_;
+                *arrival = last_read_;
+                begin_ = end_ = 0;
+                return 1;
+            }
+            end_ += n;
+        }
+    }
+
+private:
+    int fd_;
+    char buf_[4096];
+    size_t begin_, end_;
+    stream_clock::time_point last_read_;
+};
+
+// Writes all n bytes (a pipe may accept fewer at a time); false if the reader has gone
+inline bool write_all(int fd, const char *s, size_t n)
+{
+    while (n > 0) {
+        const ssize_t w = write(fd, s, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        s += w;
+        n -= w;
+    }
+    return true;
+}
+
+// "t T_degC y_1 ... y_n_out" (y = nan: not measured); returns false for a malformed line
+inline bool parse_sample(const char *line, int n_out, double *t, double *T_degC, double *y, bool *measured)
+{
+    char *end;
+    *t = std::strtod(line, &end);
+    if (end == line) return false;
+    line = end;
+    *T_degC = std::strtod(line, &end);
+    if (end == line) return false;
+    *measured = true;
+    for (int i = 0; i < n_out; i++) {
+        line = end;
+        y[i] = std::strtod(line, &end);
+        if (end == line) return false;
+        if (!std::isfinite(y[i])) *measured = false;
+    }
+    return std::isfinite(*t) && std::isfinite(*T_degC);
+}
+
+#endif
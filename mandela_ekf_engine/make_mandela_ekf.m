@@ -0,0 +1,57 @@
+%MAKE_MANDELA_EKF Compilation of the native Mandela EKF, plant, Monte Carlo, tuning, service and algebraic solver mex-files
+% The engine links against the C libraries of SUNDIALS (IDAS, i.e. IDA with
+% forward sensitivities, version 5.x). Set the environment variable SUNDIALS_DIR
+% to the installation prefix of SUNDIALS if it is not installed under /usr/local.
+SUNDIALS_DIR = getenv('SUNDIALS_DIR');
+if isempty(SUNDIALS_DIR)
+    SUNDIALS_DIR = '/usr/local';
+end
+SUNDIALS_LIB_DIR = fullfile(SUNDIALS_DIR, 'lib');
+if ~exist(SUNDIALS_LIB_DIR, 'dir')
+    SUNDIALS_LIB_DIR = fullfile(SUNDIALS_DIR, 'lib64');
+end
+
+SOURCES = {'mandela_ekf.cpp', 'batch_reactor_model.cpp', 'batch_reactor_model_ida.cpp', ...
+    'dae_integrator.cpp', 'process_noise.cpp'};
+LIBS = {'-lsundials_idas', '-lsundials_nvecserial', '-lsundials_sunmatrixdense', '-lsundials_sunlinsoldense'};
+
+COMPILE_OPTIONS = {'-O', '-largeArrayDims', ['-I' fullfile(SUNDIALS_DIR, 'include')], ['-L' SUNDIALS_LIB_DIR]};
+if ~ispc
+    COMPILE_OPTIONS = [COMPILE_OPTIONS, {'CXXFLAGS=$CXXFLAGS -std=c++11'}];
+end
+
+% The UKF, the Monte Carlo campaigns, the tuning sweeps and the service run on several threads
+THREAD_OPTIONS = {};
+if ~ispc
+    THREAD_OPTIONS = {'CXXFLAGS=$CXXFLAGS -std=c++11 -pthread', 'LDFLAGS=$LDFLAGS -pthread'};
+end
+
+disp('Compiling mandela_ekf_mex...')
+mex(COMPILE_OPTIONS{:}, THREAD_OPTIONS{:}, 'mandela_ekf_mex.cpp', 'mandela_ukf.cpp', 'mandela_mhe.cpp', 'thread_pool.cpp', ...
+    'measurement_stream.cpp', 'checkpoint_file.cpp', SOURCES{:}, LIBS{:});
+
+disp('Compiling batch_reactor_plant_mex...')
+mex(COMPILE_OPTIONS{:}, 'batch_reactor_plant_mex.cpp', 'batch_reactor_plant.cpp', SOURCES{:}, LIBS{:});
+
+% The batched EKF of the Monte Carlo campaigns relies on the compiler vectorising its loops over
+% the filters: -march=native selects AVX2/AVX-512 where available (the mex-file then only runs on
+% CPUs with the instruction set of the build machine)
+SIMD_OPTIONS = {};
+if ~ispc
+    SIMD_OPTIONS = {'CXXOPTIMFLAGS=-O3 -march=native -DNDEBUG'};
+end
+
+disp('Compiling mandela_ekf_monte_carlo_mex...')
+mex(COMPILE_OPTIONS{:}, THREAD_OPTIONS{:}, SIMD_OPTIONS{:}, 'mandela_ekf_monte_carlo_mex.cpp', 'monte_carlo_campaign.cpp', ...
+    'mandela_ekf_batch.cpp', 'batch_reactor_plant.cpp', SOURCES{:}, LIBS{:});
+
+disp('Compiling mandela_ekf_tuning_mex...')
+mex(COMPILE_OPTIONS{:}, THREAD_OPTIONS{:}, 'mandela_ekf_tuning_mex.cpp', 'tuning_sweep.cpp', 'thread_pool.cpp', ...
+    'batch_reactor_plant.cpp', SOURCES{:}, LIBS{:});
+
+disp('Compiling mandela_ekf_service_mex...')
+mex(COMPILE_OPTIONS{:}, THREAD_OPTIONS{:}, 'mandela_ekf_service_mex.cpp', 'reactor_service.cpp', 'thread_pool.cpp', ...
+    SOURCES{:}, LIBS{:});
+
+disp('Compiling algebraic_equations_mex...')
+mex(COMPILE_OPTIONS{:}, 'algebraic_equations_mex.cpp', 'batch_reactor_model.cpp');
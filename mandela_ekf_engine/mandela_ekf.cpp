@@ -0,0 +1,651 @@
+// Native Mandela EKF for the batch chemical reactor DAE (see mandela_ekf.hpp)
+
+#include "mandela_ekf.hpp"
+
+#include <cmath>
+
+using namespace batch_reactor;
+using namespace small_dense;
+
+const char *mandela_ekf_status_message(int status)
+{
+    switch (status) {
+        case MANDELA_EKF_SUCCESS:                 return "Success.";
+        case MANDELA_EKF_INVALID_CONFIG:          return "Invalid EKF configuration.";
+        case MANDELA_EKF_NOT_INITIALISED:         return "The EKF has not been initialised.";
+        case MANDELA_EKF_INTEGRATOR_FAILURE:      return "The DAE integrator (IDA) failed.";
+        case MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE: return "The algebraic equations could not be solved.";
+        case MANDELA_EKF_SINGULAR_MATRIX:         return "Singular matrix encountered.";
+        case MANDELA_EKF_CHECKPOINT_FAILURE:      return "The checkpoint could not be written or read, or does not match the filter.";
+        case MANDELA_EKF_OUT_OF_SEQUENCE:         return "The measurement is older than the estimate.";
+        default:                                  return "Unknown error.";
+    }
+}
+
+// K = P*H'/(H*P*H' + R) for P (N x N, packed) and H (n_y x N), computed as K' = (H*P*H' + R)\(H*P)
+// since the innovation covariance is symmetric. K has the leading dimension n_xz; H*P and
+// S = H*P*H' + R are returned for the covariance update.
+template <int N>
+static int kalman_gain(const double *P_packed, const double *H, const double *R, double *HP, double *S, double *K)
+{
+    const int n_y = mandela_ekf::n_y, n_xz = mandela_ekf::n_xz;
+    double LU[n_y*n_y], Kt[n_y*N];
+    int piv[n_y];
+
+    sym_mul<n_y, N>(H, P_packed, HP);
+    mat_mul_nt<n_y, N, n_y>(HP, H, S);
+    for (int i = 0; i < n_y*n_y; i++) S[i] += R[i];
+    copy<n_y, n_y>(S, LU);
+    if (lu_factor<n_y>(LU, piv) != 0) return MANDELA_EKF_SINGULAR_MATRIX;
+    copy<n_y, N>(HP, Kt);
+    lu_solve<n_y, N>(LU, piv, Kt);
+    for (int j = 0; j < n_y; j++) {
+        for (int i = 0; i < N; i++) K[i + j*n_xz] = Kt[j + i*n_y];
+    }
+    return MANDELA_EKF_SUCCESS;
+}
+
+// Joseph form P = (I - K*H)*P*(I - K*H)' + K*R*K' = P - K*(H*P) - (H*P)'*K' + K*S*K', which keeps
+// P symmetric positive semi-definite. It is applied as the symmetric rank-2*n_y update
+// P += M*K' + K*M' with M = K*S/2 - (H*P)', i.e. O(N^2*n_y) instead of two N x N products.
+template <int N>
+static void joseph_update(const double *K, const double *HP, const double *S, double *P_packed)
+{
+    const int n_y = mandela_ekf::n_y, n_xz = mandela_ekf::n_xz;
+    double M[N*n_y], K_N[N*n_y];
+    for (int j = 0; j < n_y; j++) {
+        for (int i = 0; i < N; i++) {
+            K_N[i + j*N] = K[i + j*n_xz];
+            double m = -HP[j + i*n_y];
+            for (int k = 0; k < n_y; k++) m += 0.5*K[i + k*n_xz]*S[k + j*n_y];
+            M[i + j*N] = m;
+        }
+    }
+    sym_rank_2k_update<N, n_y>(M, K_N, P_packed);
+}
+
+// Sequential processing of the measurements, one scalar channel at a time, for P (N x N, packed)
+// and H (n_y x N). The channels are first whitened with R = L*L' (L = chol_R, lower triangular):
+// L\H and L\innovation have uncorrelated unit-variance noise. For a diagonal R this is a scaling
+// and the cost is linear in the no. of channels. Channel k then needs u = h_k*P, s = u*h_k' + 1,
+// K = u'/s and the rank-2 Joseph update of joseph_update with n_y = 1: O(N^2) and no inversion.
+// Since the outputs are linear in XZ, the result is that of the simultaneous update; dXZ (N) is
+// the total correction of the state.
+template <int N>
+static int sequential_update(int n_out, const double *chol_R, const double *H, const double *innovation,
+                             double *P_packed, double *dXZ)
+{
+    const int n_y = mandela_ekf::n_y;
+    double H_w[n_y*N], e_w[n_y];
+    for (int k = 0; k < n_out; k++) {
+        e_w[k] = innovation[k];
+        for (int j = 0; j < N; j++) H_w[k + j*n_y] = H[k + j*n_y];
+        for (int l = 0; l < k; l++) {
+            const double L_kl = chol_R[k + l*n_y];
+            if (L_kl == 0.0) continue;
+            e_w[k] -= L_kl*e_w[l];
+            for (int j = 0; j < N; j++) H_w[k + j*n_y] -= L_kl*H_w[l + j*n_y];
+        }
+        const double L_kk = chol_R[k + k*n_y];
+        e_w[k] /= L_kk;
+        for (int j = 0; j < N; j++) H_w[k + j*n_y] /= L_kk;
+    }
+
+    for (int i = 0; i < N; i++) dXZ[i] = 0.0;
+    for (int k = 0; k < n_out; k++) {
+        double h[N], u[N], K[N], M[N];
+        for (int j = 0; j < N; j++) h[j] = H_w[k + j*n_y];
+        sym_mul<1, N>(h, P_packed, u);
+        double s = 1.0, e = e_w[k];
+        for (int j = 0; j < N; j++) {
+            s += u[j]*h[j];
+            e -= h[j]*dXZ[j];  // innovation after the channels before k
+        }
+        if (!(s > 0.0)) return MANDELA_EKF_SINGULAR_MATRIX;
+        for (int j = 0; j < N; j++) {
+            K[j] = u[j]/s;
+            dXZ[j] += K[j]*e;
+            M[j] = 0.5*K[j]*s - u[j];
+        }
+        sym_rank_2k_update<N, 1>(M, K, P_packed);
+    }
+    return MANDELA_EKF_SUCCESS;
+}
+
+mandela_ekf::mandela_ekf()
+    : initialised_(false), restart_integrator_(false), t_(0.0), t_restart_(0.0), P_stale_(false),
+      T_degC_lin_(0.0), n_relinearisations_(0), n_reused_linearisations_(0), dt_discretised_(0.0)
+{
+}
+
+int mandela_ekf::init(const mandela_ekf_config &config, const double *X_init, const double *P_init)
+{
+    if (initialised_) return MANDELA_EKF_INVALID_CONFIG;
+    if (!(config.Ts > 0) || config.n_outputs < 1 || config.n_outputs > n_y ||
+        config.temperature_profile.empty() ||
+        (config.process_noise_model != MANDELA_EKF_CONTINUOUS_Q && config.process_noise_model != MANDELA_EKF_DISCRETE_Q) ||
+        (config.covariance_model != MANDELA_EKF_FULL_COVARIANCE && config.covariance_model != MANDELA_EKF_REDUCED_COVARIANCE) ||
+        (config.measurement_update != MANDELA_EKF_SIMULTANEOUS_UPDATE && config.measurement_update != MANDELA_EKF_SEQUENTIAL_UPDATE) ||
+        (config.transition_model != MANDELA_EKF_EXPM_TRANSITION && config.transition_model != MANDELA_EKF_SENSITIVITY_TRANSITION) ||
+        !(config.relinearisation_rel_tol >= 0) || !(config.relinearisation_abs_tol >= 0) ||
+        !(config.relinearisation_input_tol >= 0)) {
+        return MANDELA_EKF_INVALID_CONFIG;
+    }
+    for (int i = 0; i < config.n_outputs; i++) {
+        if (config.output_index[i] < 0 || config.output_index[i] >= n_xz) return MANDELA_EKF_INVALID_CONFIG;
+    }
+
+    config_ = config;
+    ida_data_.model_params = config_.model_params;
+    ida_data_.rates.reset(config_.model_params);
+    ida_data_.temperature_profile = &config_.temperature_profile;
+    ida_data_.noise_Ts = 0.0;  // the EKF model is noise-free
+    ida_data_.process_noise = NULL;
+    t_ = config_.t0;
+
+    // H_aug is constant, since the outputs are a subset of XZ (outputFunction_only_algebraic_vars)
+    const int n_out = config_.n_outputs;
+    for (int i = 0; i < n_y*n_xz; i++) H_[i] = 0.0;
+    identity<n_y>(R_);
+    for (int i = 0; i < n_out; i++) {
+        H_[i + config_.output_index[i]*n_y] = 1.0;
+        for (int j = 0; j < n_out; j++) R_[i + j*n_y] = config_.R[i + j*n_out];
+    }
+    copy<n_y, n_y>(R_, chol_R_);
+    if (config_.measurement_update == MANDELA_EKF_SEQUENTIAL_UPDATE && cholesky<n_y>(chol_R_) != 0) {
+        return MANDELA_EKF_INVALID_CONFIG;  // R must be positive definite to be whitened
+    }
+
+    sym_pack<n_xz>(P_init, P_packed_);
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i <= j; i++) P_xx_packed_[i + j*(j + 1)/2] = P_init[i + j*n_xz];
+    }
+    P_stale_ = true;
+
+    // Algebraic variables consistent with the initial differential states (Z_init_guess = 0)
+    for (int i = 0; i < n_diff; i++) XZ_[i] = X_init[i];
+    for (int i = 0; i < n_alg; i++) XZ_[n_diff + i] = 0.0;
+    if (solve_algebraic_equations(XZ_, config_.model_params) != 0) return MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE;
+
+    const double T_degC_init = config_.temperature_profile.eval(t_);
+    int status = consistent_derivatives(T_degC_init);
+    if (status != MANDELA_EKF_SUCCESS) return status;
+
+    double id[n_xz];
+    for (int i = 0; i < n_xz; i++) id[i] = (i < n_diff) ? 1.0 : 0.0;
+    copy<n_xz, 1>(XZ_, XZ_nom_);
+    copy<n_xz, 1>(XZp_, XZp_nom_);
+    int flag = integrator_.create(n_xz, XZ_nom_, XZp_nom_, id, t_,
+                                  batch_reactor_ida_residual, batch_reactor_ida_jacobian, &ida_data_,
+                                  config_.rel_tol, config_.abs_tol, config_.max_num_steps);
+    if (flag == IDA_SUCCESS) flag = integrator_.calc_ic(t_ + 0.1);
+    if (flag != IDA_SUCCESS) return MANDELA_EKF_INTEGRATOR_FAILURE;
+    copy<n_xz, 1>(XZ_nom_, XZ_);
+    copy<n_xz, 1>(XZp_nom_, XZp_);
+    t_restart_ = t_;
+    if (config_.transition_model == MANDELA_EKF_SENSITIVITY_TRANSITION) {
+        status = init_sensitivities(XZ_nom_, T_degC_init);
+        if (status != MANDELA_EKF_SUCCESS) return status;
+        if (integrator_.init_sensitivities(n_diff, sens_, sens_p_, batch_reactor_ida_sens_residual) != IDA_SUCCESS) {
+            return MANDELA_EKF_INTEGRATOR_FAILURE;
+        }
+    }
+
+    status = relinearise(T_degC_init);
+    if (status != MANDELA_EKF_SUCCESS) return status;
+
+    restart_integrator_ = false;  // IDACalcIC has left IDA consistent with the estimate
+    initialised_ = true;
+    return MANDELA_EKF_SUCCESS;
+}
+
+// dX/dt from the state equations and dZ/dt = Gamma_bottom*dX/dt
+int mandela_ekf::consistent_derivatives(double T_degC)
+{
+    double fx[n_diff*n_diff], fz[n_diff*n_alg], gx[n_alg*n_diff], gz[n_alg*n_alg];
+    int piv[n_alg];
+
+    const rate_coeffs &k = ida_data_.rates.get(T_degC);
+    rhs_state_eqn(XZ_, k, NULL, XZp_);
+
+    linearisation(XZ_, config_.model_params, k, fx, fz, gx, gz);
+    if (lu_factor<n_alg>(gz, piv) != 0) return MANDELA_EKF_SINGULAR_MATRIX;
+    for (int i = 0; i < n_alg*n_diff; i++) Gamma_bottom_[i] = -gx[i];
+    lu_solve<n_alg, n_diff>(gz, piv, Gamma_bottom_);
+
+    mat_mul<n_alg, n_diff, 1>(Gamma_bottom_, XZp_, XZp_ + n_diff);
+    return MANDELA_EKF_SUCCESS;
+}
+
+// Initial values of the sensitivities at a (re)start of IDA from XZ: S = dXZ/dX = [I; Gamma_bottom]
+// and dS/dt = [A_x; Gamma_bottom*A_x] with A_x = fx + fz*Gamma_bottom
+int mandela_ekf::init_sensitivities(const double *XZ, double T_degC)
+{
+    double fx[n_diff*n_diff], fz[n_diff*n_alg], gx[n_alg*n_diff], gz[n_alg*n_alg];
+    double Gb[n_alg*n_diff], A_x[n_diff*n_diff], Gb_A_x[n_alg*n_diff];
+    int piv[n_alg];
+
+    linearisation(XZ, config_.model_params, ida_data_.rates.get(T_degC), fx, fz, gx, gz);
+    if (lu_factor<n_alg>(gz, piv) != 0) return MANDELA_EKF_SINGULAR_MATRIX;
+    for (int i = 0; i < n_alg*n_diff; i++) Gb[i] = -gx[i];
+    lu_solve<n_alg, n_diff>(gz, piv, Gb);
+    mat_mul<n_diff, n_alg, n_diff>(fz, Gb, A_x);
+    for (int i = 0; i < n_diff*n_diff; i++) A_x[i] += fx[i];
+    mat_mul<n_alg, n_diff, n_diff>(Gb, A_x, Gb_A_x);
+
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_diff; i++) {
+            sens_[i + j*n_xz] = (i == j) ? 1.0 : 0.0;
+            sens_p_[i + j*n_xz] = A_x[i + j*n_diff];
+        }
+        for (int i = 0; i < n_alg; i++) {
+            sens_[n_diff + i + j*n_xz] = Gb[i + j*n_alg];
+            sens_p_[n_diff + i + j*n_xz] = Gb_A_x[i + j*n_alg];
+        }
+    }
+    return MANDELA_EKF_SUCCESS;
+}
+
+// A_aug_EKF = [fx fz; -inv(gz)*gx*fx -inv(gz)*gx*fz] and Gamma_EKF = [I; -inv(gz)*gx]. The
+// transition matrix and Qd of the next prediction interval are computed from them by discretise().
+int mandela_ekf::relinearise(double T_degC)
+{
+    double fx[n_diff*n_diff], fz[n_diff*n_alg], gx[n_alg*n_diff], gz[n_alg*n_alg];
+    double Gb_fx[n_alg*n_diff], Gb_fz[n_alg*n_alg];
+    int piv[n_alg];
+
+    // Lazy relinearisation: keep phi, Qd and Gamma while the operating point stays in the trust
+    // region around the last linearisation (n_relinearisations_ is 0 before the first one)
+    if ((config_.relinearisation_rel_tol > 0 || config_.relinearisation_abs_tol > 0) && n_relinearisations_ > 0 &&
+        std::fabs(T_degC - T_degC_lin_) <= config_.relinearisation_input_tol) {
+        bool inside = true;
+        for (int i = 0; i < n_xz && inside; i++) {
+            inside = std::fabs(XZ_[i] - XZ_lin_[i]) <= config_.relinearisation_rel_tol*std::fabs(XZ_lin_[i]) + config_.relinearisation_abs_tol;
+        }
+        if (inside) {
+            n_reused_linearisations_++;
+            return MANDELA_EKF_SUCCESS;
+        }
+    }
+    copy<n_xz, 1>(XZ_, XZ_lin_);
+    T_degC_lin_ = T_degC;
+    n_relinearisations_++;
+
+    const rate_coeffs &k = ida_data_.rates.get(T_degC);
+    linearisation(XZ_, config_.model_params, k, fx, fz, gx, gz);
+    if (lu_factor<n_alg>(gz, piv) != 0) return MANDELA_EKF_SINGULAR_MATRIX;
+    for (int i = 0; i < n_alg*n_diff; i++) Gamma_bottom_[i] = -gx[i];
+    lu_solve<n_alg, n_diff>(gz, piv, Gamma_bottom_);
+
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_diff; i++) Gamma_[i + j*n_xz] = (i == j) ? 1.0 : 0.0;
+        for (int i = 0; i < n_alg; i++) Gamma_[n_diff + i + j*n_xz] = Gamma_bottom_[i + j*n_alg];
+    }
+
+    dt_discretised_ = 0.0;
+    if (config_.covariance_model == MANDELA_EKF_REDUCED_COVARIANCE) {
+        // A_x = fx + fz*Gamma_bottom; P() is rebuilt with the new Gamma
+        mat_mul<n_diff, n_alg, n_diff>(fz, Gamma_bottom_, A_x_);
+        for (int i = 0; i < n_diff*n_diff; i++) A_x_[i] += fx[i];
+        P_stale_ = true;
+        return MANDELA_EKF_SUCCESS;
+    }
+
+    mat_mul<n_alg, n_diff, n_diff>(Gamma_bottom_, fx, Gb_fx);
+    mat_mul<n_alg, n_diff, n_alg>(Gamma_bottom_, fz, Gb_fz);
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_diff; i++) A_aug_[i + j*n_xz] = fx[i + j*n_diff];
+        for (int i = 0; i < n_alg; i++) A_aug_[n_diff + i + j*n_xz] = Gb_fx[i + j*n_alg];
+    }
+    for (int j = 0; j < n_alg; j++) {
+        for (int i = 0; i < n_diff; i++) A_aug_[i + (n_diff + j)*n_xz] = fz[i + j*n_diff];
+        for (int i = 0; i < n_alg; i++) A_aug_[n_diff + i + (n_diff + j)*n_xz] = Gb_fz[i + j*n_alg];
+    }
+
+    mat_mul<n_xz, n_diff, n_diff>(Gamma_, config_.Q, GammaQ_);
+    mat_mul_nt<n_xz, n_diff, n_xz>(GammaQ_, Gamma_, Qc_);
+    return MANDELA_EKF_SUCCESS;
+}
+
+// phi_EKF = expm(A_aug_EKF*dt) and Qd over an interval of length dt, from the last linearisation:
+// Van Loan for a continuous-time Q, Gamma_EKF*Q*Gamma_EKF'*dt/Ts otherwise (Q per sampling interval)
+int mandela_ekf::discretise(double dt)
+{
+    const bool continuous = (config_.process_noise_model == MANDELA_EKF_CONTINUOUS_Q);
+    const double scale = dt/config_.Ts;
+    if (config_.covariance_model == MANDELA_EKF_REDUCED_COVARIANCE) {
+        if (continuous) {
+            if (van_loan_x_.discretise(A_x_, config_.Q, dt, phi_x_, Qd_x_) != 0) return MANDELA_EKF_SINGULAR_MATRIX;
+        } else {
+            if (expm_x_.compute(A_x_, dt, phi_x_) != 0) return MANDELA_EKF_SINGULAR_MATRIX;
+            for (int i = 0; i < n_diff*n_diff; i++) Qd_x_[i] = scale*config_.Q[i];
+        }
+    } else {
+        if (continuous) {
+            if (van_loan_.discretise(A_aug_, Qc_, dt, phi_, Qd_) != 0) return MANDELA_EKF_SINGULAR_MATRIX;
+        } else {
+            if (expm_.compute(A_aug_, dt, phi_) != 0) return MANDELA_EKF_SINGULAR_MATRIX;
+            for (int i = 0; i < n_xz*n_xz; i++) Qd_[i] = scale*Qc_[i];
+        }
+    }
+    dt_discretised_ = dt;
+    return MANDELA_EKF_SUCCESS;
+}
+
+// C = A/B_x for A and C (n_xz x n_diff), where B_x are the first n_diff rows of B (n_xz x n_diff),
+// solved as B_x'*C' = A'
+static int divide_by_x_rows(const double *A, const double *B, double *C)
+{
+    const int n_diff = mandela_ekf::n_diff, n_xz = mandela_ekf::n_xz;
+    double LU[n_diff*n_diff], Ct[n_diff*n_xz];
+    int piv[n_diff];
+
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_diff; i++) LU[i + j*n_diff] = B[j + i*n_xz];
+    }
+    for (int j = 0; j < n_xz; j++) {
+        for (int i = 0; i < n_diff; i++) Ct[i + j*n_diff] = A[j + i*n_xz];
+    }
+    if (lu_factor<n_diff>(LU, piv) != 0) return MANDELA_EKF_SINGULAR_MATRIX;
+    lu_solve<n_diff, n_xz>(LU, piv, Ct);
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_xz; i++) C[i + j*n_xz] = Ct[j + i*n_diff];
+    }
+    return MANDELA_EKF_SUCCESS;
+}
+
+// phi_EKF and Qd over [t, t + dt] from the sensitivities, with sens_prev_ = S(t) and sens_ = S(t + dt):
+// phi_EKF = [Phi 0] with Phi = S(t + dt)/S_x(t). With a continuous Q, Qd is the integral of
+// Phi(s)*Q*Phi(s)' over the interval, where Phi(s) = dXZ(t + dt)/dX(s), by the trapezoidal rule:
+// Phi(t) = Phi and Phi(t + dt) = Gamma_EKF(t + dt) = S(t + dt)/S_x(t + dt). With a discrete Q it is
+// Gamma_EKF*Q*Gamma_EKF'*dt/Ts as in discretise().
+int mandela_ekf::sensitivity_transition(double dt)
+{
+    const bool continuous = (config_.process_noise_model == MANDELA_EKF_CONTINUOUS_Q);
+    const double scale = dt/config_.Ts;
+    double Phi[n_xz*n_diff];
+    if (divide_by_x_rows(sens_, sens_prev_, Phi) != MANDELA_EKF_SUCCESS) return MANDELA_EKF_SINGULAR_MATRIX;
+
+    if (config_.covariance_model == MANDELA_EKF_REDUCED_COVARIANCE) {
+        for (int j = 0; j < n_diff; j++) {
+            for (int i = 0; i < n_diff; i++) phi_x_[i + j*n_diff] = Phi[i + j*n_xz];
+        }
+        if (continuous) {
+            double phiQ[n_diff*n_diff];
+            mat_mul<n_diff, n_diff, n_diff>(phi_x_, config_.Q, phiQ);
+            mat_mul_nt<n_diff, n_diff, n_diff>(phiQ, phi_x_, Qd_x_);
+            for (int i = 0; i < n_diff*n_diff; i++) Qd_x_[i] = 0.5*dt*(Qd_x_[i] + config_.Q[i]);
+        } else {
+            for (int i = 0; i < n_diff*n_diff; i++) Qd_x_[i] = scale*config_.Q[i];
+        }
+        return MANDELA_EKF_SUCCESS;
+    }
+
+    for (int j = 0; j < n_xz; j++) {
+        for (int i = 0; i < n_xz; i++) phi_[i + j*n_xz] = (j < n_diff) ? Phi[i + j*n_xz] : 0.0;
+    }
+    if (continuous) {
+        double Gamma_end[n_xz*n_diff], Qd_end[n_xz*n_xz];
+        if (divide_by_x_rows(Phi, Phi, Gamma_end) != MANDELA_EKF_SUCCESS) return MANDELA_EKF_SINGULAR_MATRIX;
+        mat_mul<n_xz, n_diff, n_diff>(Phi, config_.Q, GammaQ_);
+        mat_mul_nt<n_xz, n_diff, n_xz>(GammaQ_, Phi, Qd_);
+        mat_mul<n_xz, n_diff, n_diff>(Gamma_end, config_.Q, GammaQ_);
+        mat_mul_nt<n_xz, n_diff, n_xz>(GammaQ_, Gamma_end, Qd_end);
+        for (int i = 0; i < n_xz*n_xz; i++) Qd_[i] = 0.5*dt*(Qd_[i] + Qd_end[i]);
+    } else {
+        for (int i = 0; i < n_xz*n_xz; i++) Qd_[i] = scale*Qc_[i];
+    }
+    return MANDELA_EKF_SUCCESS;
+}
+
+int mandela_ekf::step(const double *measured_outputs, double T_degC)
+{
+    return step_to(t_ + config_.Ts, measured_outputs, T_degC);
+}
+
+// Prediction of the state over [t_, t_new]. The integrator follows the (noise-free) model from its
+// last restart, in XZ_nom_; the estimate differs from that trajectory by the measurement updates
+// since the restart. The difference dXZ is carried along with phi_EKF while the restart is less
+// than Ts ago, so that measurements in quick succession are predicted from the dense output of IDA
+// alone. After that, IDA is restarted from the estimate, with the step size of the previous
+// integration as first step (IDA's own estimate is far too small). With one measurement per Ts,
+// this restarts IDA after every update. With MANDELA_EKF_SENSITIVITY_TRANSITION, IDA is also
+// restarted on its own trajectory once Ts has passed, so that the sensitivities, which phi_EKF
+// divides by S_x(t_), span at most Ts and stay well-conditioned for the fast modes.
+int mandela_ekf::predict_state(double t_new, double T_degC)
+{
+    const double Ts = config_.Ts;
+    const bool sensitivities = (config_.transition_model == MANDELA_EKF_SENSITIVITY_TRANSITION);
+    double dXZ[n_xz];
+    bool carry = false;
+    if (restart_integrator_ || sensitivities) {
+        if (t_ - t_restart_ >= (1 - 1e-9)*Ts) {
+            double h_init = integrator_.last_step();
+            if (h_init > Ts) h_init = Ts;
+            copy<n_xz, 1>(XZ_, XZ_nom_);
+            copy<n_xz, 1>(XZp_, XZp_nom_);
+            if (sensitivities) {
+                const int status = init_sensitivities(XZ_nom_, config_.temperature_profile.eval(t_));
+                if (status != MANDELA_EKF_SUCCESS) return status;
+            }
+            if (integrator_.reinit(t_, h_init) != IDA_SUCCESS) return MANDELA_EKF_INTEGRATOR_FAILURE;
+            restart_integrator_ = false;
+            t_restart_ = t_;
+        } else if (restart_integrator_) {
+            for (int i = 0; i < n_xz; i++) dXZ[i] = XZ_[i] - XZ_nom_[i];
+            carry = true;
+        }
+    }
+    if (sensitivities) copy<n_xz, n_diff>(sens_, sens_prev_);
+    if (integrator_.advance(t_new) != IDA_SUCCESS) return MANDELA_EKF_INTEGRATOR_FAILURE;
+    copy<n_xz, 1>(XZ_nom_, XZ_);
+    copy<n_xz, 1>(XZp_nom_, XZp_);
+    if (sensitivities) {
+        const int status = sensitivity_transition(t_new - t_);
+        if (status != MANDELA_EKF_SUCCESS) return status;
+    }
+    if (!carry) return MANDELA_EKF_SUCCESS;
+
+    // dX(t_new) = phi*dX(t_), then Z back onto g(X,Z) = 0 from Z_nom + Gamma_bottom*dX
+    double dX[n_diff], dZ[n_alg];
+    if (config_.covariance_model == MANDELA_EKF_REDUCED_COVARIANCE) {
+        mat_mul<n_diff, n_diff, 1>(phi_x_, dXZ, dX);
+    } else {
+        double phi_dXZ[n_xz];
+        mat_mul<n_xz, n_xz, 1>(phi_, dXZ, phi_dXZ);
+        copy<n_diff, 1>(phi_dXZ, dX);
+    }
+    mat_mul<n_alg, n_diff, 1>(Gamma_bottom_, dX, dZ);
+    for (int i = 0; i < n_diff; i++) XZ_[i] += dX[i];
+    for (int i = 0; i < n_alg; i++) XZ_[n_diff + i] += dZ[i];
+    if (solve_algebraic_equations(XZ_, config_.model_params) != 0) return MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE;
+    return consistent_derivatives(T_degC);
+}
+
+int mandela_ekf::step_to(double t_meas, const double *measured_outputs, double T_degC)
+{
+    if (!initialised_) return MANDELA_EKF_NOT_INITIALISED;
+    const int n_out = config_.n_outputs;
+
+    double dt = t_meas - t_;
+    if (std::fabs(dt - config_.Ts) <= 1e-9*config_.Ts) {
+        dt = config_.Ts;
+        t_meas = t_ + config_.Ts;
+    }
+    if (!(dt >= 0)) return MANDELA_EKF_OUT_OF_SEQUENCE;
+
+    const bool reduced = (config_.covariance_model == MANDELA_EKF_REDUCED_COVARIANCE);
+    if (dt > 0) {
+        // phi_EKF and Qd of this interval (those of the last one, if it had the same length and
+        // the model has not been relinearised since), or from the sensitivities of the prediction
+        const bool expm = (config_.transition_model == MANDELA_EKF_EXPM_TRANSITION);
+        int status = (expm && dt != dt_discretised_) ? discretise(dt) : MANDELA_EKF_SUCCESS;
+        if (status == MANDELA_EKF_SUCCESS) status = predict_state(t_meas, T_degC);
+        if (status != MANDELA_EKF_SUCCESS) return status;
+        t_ = t_meas;
+
+        // P_EKF = phi_EKF*P_EKF*phi_EKF' + Qd
+        if (reduced) {
+            sym_congruence<n_diff, n_diff>(phi_x_, P_xx_packed_, tmp_packed_);
+            copy<n_diff*(n_diff + 1)/2, 1>(tmp_packed_, P_xx_packed_);
+            sym_add<n_diff>(Qd_x_, P_xx_packed_);
+        } else {
+            sym_congruence<n_xz, n_xz>(phi_, P_packed_, tmp_packed_);
+            copy<n_xz*(n_xz + 1)/2, 1>(tmp_packed_, P_packed_);
+            sym_add<n_xz>(Qd_, P_packed_);
+        }
+        P_stale_ = true;
+    }
+
+    if (!measured_outputs) return relinearise(T_degC);
+
+    // With the reduced covariance, H*P_EKF*H' = H_x*P_xx*H_x' and K_aug_EKF = Gamma*K_x, where
+    // H_x = H_aug_EKF*Gamma are the rows of Gamma of the measured variables. Only the first
+    // n_diff rows of the gain are then formed: the update of Z goes through Gamma_bottom anyway.
+    double innovation[n_y], dXZ[n_xz], dX[n_diff], dZ[n_alg];
+    for (int i = 0; i < n_y; i++) innovation[i] = 0.0;
+    for (int i = 0; i < n_out; i++) innovation[i] = measured_outputs[i] - XZ_[config_.output_index[i]];
+    if (reduced) mat_mul<n_y, n_xz, n_diff>(H_, Gamma_, H_x_);
+
+    int status;
+    const bool sequential = (config_.measurement_update == MANDELA_EKF_SEQUENTIAL_UPDATE);
+    if (sequential) {
+        status = reduced ? sequential_update<n_diff>(n_out, chol_R_, H_x_, innovation, P_xx_packed_, dXZ)
+                         : sequential_update<n_xz>(n_out, chol_R_, H_, innovation, P_packed_, dXZ);
+    } else {
+        status = reduced ? kalman_gain<n_diff>(P_xx_packed_, H_x_, R_, HP_, S_, K_)
+                         : kalman_gain<n_xz>(P_packed_, H_, R_, HP_, S_, K_);
+    }
+    if (status != MANDELA_EKF_SUCCESS) return status;
+
+    // Update of the differential states with the innovation. The algebraic variables are re-projected
+    // onto g(X,Z) = 0 below, starting from the predicted Z plus Gamma_bottom*dX
+    for (int i = 0; i < n_diff; i++) dX[i] = sequential ? dXZ[i] : 0.0;
+    if (!sequential) {
+        for (int j = 0; j < n_out; j++) {
+            for (int i = 0; i < n_diff; i++) dX[i] += K_[i + j*n_xz]*innovation[j];
+        }
+    }
+    mat_mul<n_alg, n_diff, 1>(Gamma_bottom_, dX, dZ);
+    for (int i = 0; i < n_diff; i++) XZ_[i] += dX[i];
+    for (int i = 0; i < n_alg; i++) XZ_[n_diff + i] += dZ[i];
+
+    // Re-project the algebraic variables onto g(X,Z) = 0 and recompute consistent derivatives
+    restart_integrator_ = true;
+    if (solve_algebraic_equations(XZ_, config_.model_params) != 0) return MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE;
+    status = consistent_derivatives(T_degC);
+    if (status != MANDELA_EKF_SUCCESS) return status;
+
+    // P_EKF = (I - K_aug_EKF*H_aug_EKF)*P_EKF*(I - K_aug_EKF*H_aug_EKF)' + K_aug_EKF*R*K_aug_EKF'
+    // (the sequential update has already done this channel by channel)
+    if (!sequential) {
+        if (reduced) {
+            joseph_update<n_diff>(K_, HP_, S_, P_xx_packed_);
+        } else {
+            joseph_update<n_xz>(K_, HP_, S_, P_packed_);
+        }
+    }
+    return relinearise(T_degC);
+}
+
+const double *mandela_ekf::P() const
+{
+    if (P_stale_) {
+        if (config_.covariance_model == MANDELA_EKF_REDUCED_COVARIANCE) {
+            // P_EKF = Gamma*P_xx*Gamma'
+            double P_packed[n_xz*(n_xz + 1)/2];
+            sym_congruence<n_xz, n_diff>(Gamma_, P_xx_packed_, P_packed);
+            sym_unpack<n_xz>(P_packed, P_);
+        } else {
+            sym_unpack<n_xz>(P_packed_, P_);
+        }
+        P_stale_ = false;
+    }
+    return P_;
+}
+
+int mandela_ekf::save(mandela_ekf_snapshot &snapshot) const
+{
+    if (!initialised_) return MANDELA_EKF_NOT_INITIALISED;
+    snapshot.covariance_model = config_.covariance_model;
+    snapshot.n_outputs = config_.n_outputs;
+    snapshot.Ts = config_.Ts;
+
+    snapshot.t = t_;
+    copy<n_xz, 1>(XZ_, snapshot.XZ);
+    copy<n_xz, 1>(XZp_, snapshot.XZp);
+    copy<n_xz, 1>(XZ_nom_, snapshot.XZ_nom);
+    copy<n_xz, 1>(XZp_nom_, snapshot.XZp_nom);
+    copy<n_xz*(n_xz + 1)/2, 1>(P_packed_, snapshot.P_packed);
+    copy<n_diff*(n_diff + 1)/2, 1>(P_xx_packed_, snapshot.P_xx_packed);
+
+    copy<n_xz, 1>(XZ_lin_, snapshot.XZ_lin);
+    snapshot.T_degC_lin = T_degC_lin_;
+    copy<n_xz, n_xz>(A_aug_, snapshot.A_aug);
+    copy<n_xz, n_xz>(Qc_, snapshot.Qc);
+    copy<n_diff, n_diff>(A_x_, snapshot.A_x);
+    copy<n_xz, n_xz>(phi_, snapshot.phi);
+    copy<n_xz, n_xz>(Qd_, snapshot.Qd);
+    copy<n_diff, n_diff>(phi_x_, snapshot.phi_x);
+    copy<n_diff, n_diff>(Qd_x_, snapshot.Qd_x);
+    snapshot.dt_discretised = dt_discretised_;
+    copy<n_xz, n_diff>(Gamma_, snapshot.Gamma);
+    copy<n_alg, n_diff>(Gamma_bottom_, snapshot.Gamma_bottom);
+    snapshot.n_relinearisations = n_relinearisations_;
+    snapshot.n_reused_linearisations = n_reused_linearisations_;
+    snapshot.rates_anchor_T_degC = ida_data_.rates.anchor_T_degC();
+
+    // the first step of the next restart (see step())
+    double h = integrator_.last_step();
+    if (h > config_.Ts) h = config_.Ts;
+    snapshot.t_restart = t_restart_;
+    snapshot.h_last = h;
+    snapshot.off_trajectory = restart_integrator_ ? 1 : 0;
+    snapshot.transition_model = config_.transition_model;
+    return MANDELA_EKF_SUCCESS;
+}
+
+int mandela_ekf::restore(const mandela_ekf_snapshot &snapshot)
+{
+    if (!initialised_) return MANDELA_EKF_NOT_INITIALISED;
+    if (snapshot.covariance_model != config_.covariance_model || snapshot.n_outputs != config_.n_outputs ||
+        snapshot.Ts != config_.Ts || snapshot.transition_model != config_.transition_model) {
+        return MANDELA_EKF_CHECKPOINT_FAILURE;
+    }
+
+    t_ = snapshot.t;
+    copy<n_xz, 1>(snapshot.XZ, XZ_);
+    copy<n_xz, 1>(snapshot.XZp, XZp_);
+    copy<n_xz, 1>(snapshot.XZ_nom, XZ_nom_);
+    copy<n_xz, 1>(snapshot.XZp_nom, XZp_nom_);
+    copy<n_xz*(n_xz + 1)/2, 1>(snapshot.P_packed, P_packed_);
+    copy<n_diff*(n_diff + 1)/2, 1>(snapshot.P_xx_packed, P_xx_packed_);
+    P_stale_ = true;
+
+    copy<n_xz, 1>(snapshot.XZ_lin, XZ_lin_);
+    T_degC_lin_ = snapshot.T_degC_lin;
+    copy<n_xz, n_xz>(snapshot.A_aug, A_aug_);
+    copy<n_xz, n_xz>(snapshot.Qc, Qc_);
+    copy<n_diff, n_diff>(snapshot.A_x, A_x_);
+    copy<n_xz, n_xz>(snapshot.phi, phi_);
+    copy<n_xz, n_xz>(snapshot.Qd, Qd_);
+    copy<n_diff, n_diff>(snapshot.phi_x, phi_x_);
+    copy<n_diff, n_diff>(snapshot.Qd_x, Qd_x_);
+    dt_discretised_ = snapshot.dt_discretised;
+    copy<n_xz, n_diff>(snapshot.Gamma, Gamma_);
+    copy<n_alg, n_diff>(snapshot.Gamma_bottom, Gamma_bottom_);
+    n_relinearisations_ = snapshot.n_relinearisations;
+    n_reused_linearisations_ = snapshot.n_reused_linearisations;
+    ida_data_.rates.set_anchor(snapshot.rates_anchor_T_degC);
+
+    // IDA wraps XZ_nom_ and XZp_nom_: restart it from the restored trajectory (the sensitivities
+    // then start at t, which gives phi_EKF to the IDA tolerances)
+    if (config_.transition_model == MANDELA_EKF_SENSITIVITY_TRANSITION) {
+        const int status = init_sensitivities(XZ_nom_, config_.temperature_profile.eval(t_));
+        if (status != MANDELA_EKF_SUCCESS) return status;
+    }
+    if (integrator_.reinit(t_, snapshot.h_last) != IDA_SUCCESS) return MANDELA_EKF_INTEGRATOR_FAILURE;
+    t_restart_ = snapshot.t_restart;
+    restart_integrator_ = (snapshot.off_trajectory != 0);
+    return MANDELA_EKF_SUCCESS;
+}
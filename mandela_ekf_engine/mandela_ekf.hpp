@@ -0,0 +1,223 @@
+// Native Mandela EKF for the batch chemical reactor DAE.
+// This is the compiled counterpart of the time-stepping loop in
+// Mandela_EKF_using_alg_measurement.m ("Recursive state estimation techniques for
+// nonlinear differential algebraic systems", Mandela et al., Chem. Eng. Science, 2010).
+// All storage is fixed-size and owned by the object: once init() has returned,
+// step() does not allocate. The covariance is kept in packed symmetric storage (small_dense.hpp)
+// and only its upper triangle is computed.
+
+#ifndef MANDELA_EKF_HPP
+#define MANDELA_EKF_HPP
+
+#include "batch_reactor_model.hpp"
+#include "batch_reactor_model_ida.hpp"
+#include "dae_integrator.hpp"
+#include "input_profile.hpp"
+#include "mandela_estimator.hpp"
+#include "small_dense.hpp"
+#include "van_loan_discretisation.hpp"
+
+#include <stdint.h>
+
+const int mandela_ekf_max_outputs = batch_reactor::n_alg;
+
+enum mandela_ekf_status {
+    MANDELA_EKF_SUCCESS                 =  0,
+    MANDELA_EKF_INVALID_CONFIG          = -1,
+    MANDELA_EKF_NOT_INITIALISED         = -2,
+    MANDELA_EKF_INTEGRATOR_FAILURE      = -3,
+    MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE = -4,
+    MANDELA_EKF_SINGULAR_MATRIX         = -5,
+    MANDELA_EKF_CHECKPOINT_FAILURE      = -6,
+    MANDELA_EKF_OUT_OF_SEQUENCE         = -7
+};
+
+const char *mandela_ekf_status_message(int status);
+
+// How Q enters the covariance prediction
+enum mandela_ekf_process_noise_model {
+    MANDELA_EKF_CONTINUOUS_Q = 0,  // Q is a continuous-time intensity: [phi, Qd] from one Van Loan exponential
+    MANDELA_EKF_DISCRETE_Q   = 1   // Qd = Gamma*Q*Gamma' per sample, as in Mandela_EKF_using_alg_measurement.m
+};
+
+// Which covariance is propagated
+enum mandela_ekf_covariance_model {
+    MANDELA_EKF_FULL_COVARIANCE    = 0,  // the n_xz x n_xz P_EKF of the augmented state, as in the script
+    MANDELA_EKF_REDUCED_COVARIANCE = 1   // the n_diff x n_diff covariance of X; P = Gamma*P_xx*Gamma'
+};
+
+// How the measurements of one sample are processed
+enum mandela_ekf_measurement_update {
+    MANDELA_EKF_SIMULTANEOUS_UPDATE = 0,  // K = P*H'/(H*P*H' + R), all outputs at once
+    MANDELA_EKF_SEQUENTIAL_UPDATE   = 1   // one scalar update per output after whitening with chol(R)
+};
+
+// How the transition matrix phi_EKF of a prediction interval is obtained
+enum mandela_ekf_transition_model {
+    MANDELA_EKF_EXPM_TRANSITION        = 0,  // expm(A_aug_EKF*dt), linearised at the start of the interval, as in the script
+    MANDELA_EKF_SENSITIVITY_TRANSITION = 1   // dXZ(t + dt)/dX(t) from forward sensitivities integrated by IDAS with the prediction
+};
+
+struct mandela_ekf_config {
+    batch_reactor::model_params model_params;
+    double Ts;                       // sampling interval [sec]
+    double t0;                       // initial time [sec]
+    double Q[batch_reactor::n_diff*batch_reactor::n_diff];  // process noise covariance (see process_noise_model)
+    int process_noise_model;         // mandela_ekf_process_noise_model
+    int covariance_model;            // mandela_ekf_covariance_model
+    int measurement_update;          // mandela_ekf_measurement_update
+    int transition_model;            // mandela_ekf_transition_model
+    // Lazy relinearisation: phi, Qd and Gamma are re-used while every component of XZ stays within
+    // relinearisation_rel_tol*|XZ_lin| + relinearisation_abs_tol of the point XZ_lin of the last
+    // linearisation, and T within relinearisation_input_tol [degC] of its input. With both state
+    // tolerances 0 the model is relinearised at every sample.
+    double relinearisation_rel_tol, relinearisation_abs_tol;
+    double relinearisation_input_tol;
+    int n_outputs;                   // no. of measured variables
+    int output_index[mandela_ekf_max_outputs];  // 0-based positions of the measured variables in XZ
+    double R[mandela_ekf_max_outputs*mandela_ekf_max_outputs];  // n_outputs x n_outputs, leading dimension n_outputs
+    double rel_tol, abs_tol;         // IDA tolerances
+    long max_num_steps;
+    input_profile temperature_profile;  // Temperature (degC) vs time (sec)
+};
+
+// Complete state of a running filter, for checkpoint/restore (see checkpoint_file.hpp for the file
+// format). Fixed-size, so that a snapshot is a copy without allocation. The filter has no random
+// numbers of its own; those of the simulation drivers are counter-based (counter_rng.hpp), i.e. a
+// function of the seed, the run and the sample index, which follows from t.
+struct mandela_ekf_snapshot {
+    // options that fix the meaning of the state (must match the filter it is restored into)
+    int32_t covariance_model;
+    int32_t n_outputs;
+    double Ts;
+
+    double t;
+    double XZ[batch_reactor::n_xz], XZp[batch_reactor::n_xz];
+    double XZ_nom[batch_reactor::n_xz], XZp_nom[batch_reactor::n_xz];  // trajectory of the integrator
+    double P_packed[batch_reactor::n_xz*(batch_reactor::n_xz + 1)/2];
+    double P_xx_packed[batch_reactor::n_diff*(batch_reactor::n_diff + 1)/2];
+
+    // cached linearisation
+    double XZ_lin[batch_reactor::n_xz], T_degC_lin;
+    double A_aug[batch_reactor::n_xz*batch_reactor::n_xz], Qc[batch_reactor::n_xz*batch_reactor::n_xz];
+    double A_x[batch_reactor::n_diff*batch_reactor::n_diff];
+    double phi[batch_reactor::n_xz*batch_reactor::n_xz], Qd[batch_reactor::n_xz*batch_reactor::n_xz];
+    double phi_x[batch_reactor::n_diff*batch_reactor::n_diff], Qd_x[batch_reactor::n_diff*batch_reactor::n_diff];
+    double dt_discretised;
+    double Gamma[batch_reactor::n_xz*batch_reactor::n_diff];
+    double Gamma_bottom[batch_reactor::n_alg*batch_reactor::n_diff];  // at XZ (Gamma is at XZ_lin)
+    int64_t n_relinearisations, n_reused_linearisations;
+    double rates_anchor_T_degC;  // see batch_reactor::rate_coeff_cache
+
+    // integrator: last restart, step size of the last internal step, and whether the estimate has
+    // left its trajectory
+    double t_restart;
+    double h_last;
+    int32_t off_trajectory;
+    int32_t transition_model;  // an option as those above (here it keeps the size a multiple of 8 bytes)
+};
+
+class mandela_ekf : public mandela_estimator {
+public:
+    static const int n_diff = batch_reactor::n_diff;
+    static const int n_alg  = batch_reactor::n_alg;
+    static const int n_xz   = batch_reactor::n_xz;
+    static const int n_y    = mandela_ekf_max_outputs;
+
+    mandela_ekf();
+
+    // X_init: n_diff initial differential states, P_init: n_xz x n_xz initial covariance (only its
+    // upper triangle is read, and only its differential block with MANDELA_EKF_REDUCED_COVARIANCE).
+    // The algebraic variables are obtained from the algebraic equations.
+    int init(const mandela_ekf_config &config, const double *X_init, const double *P_init);
+
+    // One predict/update cycle: integrates the model over [t, t + Ts], then processes the
+    // measurements taken at t + Ts. T_degC is the input at t + Ts (used for relinearisation).
+    // measured_outputs may be null (no measurement at t + Ts), in which case only the
+    // prediction is done.
+    // The IDA instance is created once by init(). It is only re-initialised when a measurement
+    // update has moved the state, and then restarts with the last step size it used.
+    int step(const double *measured_outputs, double T_degC);
+
+    // Predict/update cycle for a measurement taken at an arbitrary time t_meas >= t() (irregular,
+    // late or bursty analyser outputs), with T_degC the input at t_meas. phi and Qd are computed
+    // for the actual interval. The updates of the measurements that follow a restart of IDA within
+    // Ts are carried along the trajectory that IDA is integrating, so that a burst is predicted
+    // from IDA's dense output without restarting or re-integrating. A t_meas within 1e-9*Ts of
+    // t() + Ts is taken as t() + Ts (step() is step_to(t() + Ts)). Returns
+    // MANDELA_EKF_OUT_OF_SEQUENCE if t_meas < t().
+    int step_to(double t_meas, const double *measured_outputs, double T_degC);
+
+    const double *XZ() const { return XZ_; }
+    const double *XZp() const { return XZp_; }
+    const double *P() const;
+    double t() const { return t_; }
+    double Ts() const { return config_.Ts; }
+    long n_relinearisations() const { return n_relinearisations_; }  // since init(), including the first
+    long n_reused_linearisations() const { return n_reused_linearisations_; }  // skipped by the lazy policy
+    int n_outputs() const { return config_.n_outputs; }
+
+    // Checkpoint/restore. restore() needs a filter initialised with the configuration of the one that
+    // was saved, and fails with MANDELA_EKF_CHECKPOINT_FAILURE if the options of the snapshot differ.
+    // IDA's history (the divided differences of its BDF steps) is not accessible through its
+    // interface, so the restored filter restarts IDA from its saved solution at t with the saved
+    // step size. Where the saved filter restarts IDA at its next step anyway (after a measurement
+    // update, with one measurement per Ts), the restored filter continues exactly as the saved one
+    // would have; otherwise to the IDA tolerances.
+    int save(mandela_ekf_snapshot &snapshot) const;
+    int restore(const mandela_ekf_snapshot &snapshot);
+
+private:
+    mandela_ekf(const mandela_ekf &);
+    mandela_ekf &operator=(const mandela_ekf &);
+
+    int relinearise(double T_degC);
+    int discretise(double dt);
+    int predict_state(double t_new, double T_degC);
+    int init_sensitivities(const double *XZ, double T_degC);
+    int sensitivity_transition(double dt);
+    int consistent_derivatives(double T_degC);
+
+    mandela_ekf_config config_;
+    batch_reactor_ida_data ida_data_;
+    dae_integrator integrator_;
+    bool initialised_;
+    bool restart_integrator_;  // the estimate has left the trajectory of IDA (by measurement updates)
+    double t_;
+    double t_restart_;         // last (re)start of IDA
+
+    double XZ_[n_xz], XZp_[n_xz];
+    double XZ_nom_[n_xz], XZp_nom_[n_xz];  // IDA's solution at t_ (the state vectors of the integrator)
+    double P_packed_[n_xz*(n_xz + 1)/2];
+    mutable double P_[n_xz*n_xz];  // P_packed_ (or Gamma*P_xx*Gamma') unpacked, rebuilt by P()
+    mutable bool P_stale_;
+    double XZ_lin_[n_xz], T_degC_lin_;  // operating point of phi_, Qd_ and Gamma_
+    long n_relinearisations_, n_reused_linearisations_;
+    double H_[n_y*n_xz], R_[n_y*n_y];   // padded to n_y outputs (unused rows of H are zero)
+    double chol_R_[n_y*n_y];            // R = chol_R_*chol_R_' (sequential update)
+    double A_aug_[n_xz*n_xz], Qc_[n_xz*n_xz];  // continuous-time model of the last linearisation
+    double phi_[n_xz*n_xz], Qd_[n_xz*n_xz], Gamma_[n_xz*n_diff], Gamma_bottom_[n_alg*n_diff];
+    double dt_discretised_;  // interval of phi and Qd (0: not discretised since the last linearisation)
+
+    // MANDELA_EKF_SENSITIVITY_TRANSITION: the sensitivities S = dXZ_nom/dX_nom(t_restart_)
+    // (n_xz x n_diff) and their time derivatives, integrated by IDAS with XZ_nom_. Since Z follows X, XZ(t + dt) depends on
+    // X(t) only: phi_EKF = [S(t + dt)/S_x(t) 0] over [t, t + dt], with S_x the rows of X in S.
+    double sens_[n_xz*n_diff], sens_p_[n_xz*n_diff], sens_prev_[n_xz*n_diff];
+
+    // MANDELA_EKF_REDUCED_COVARIANCE: the algebraic part of the augmented state follows from X
+    // through Gamma = [I; Gamma_bottom], and A_aug = Gamma*[fx fz]. Since expm(Gamma*F)*Gamma =
+    // Gamma*expm(F*Gamma), propagating P = Gamma*P_xx*Gamma' with A_aug is the same as propagating
+    // P_xx with A_x = [fx fz]*Gamma = fx + fz*Gamma_bottom (6 x 6 instead of 10 x 10)
+    double P_xx_packed_[n_diff*(n_diff + 1)/2], A_x_[n_diff*n_diff], phi_x_[n_diff*n_diff], Qd_x_[n_diff*n_diff];
+    double H_x_[n_y*n_diff];
+
+    // workspace
+    double K_[n_xz*n_y], HP_[n_y*n_xz], S_[n_y*n_y];
+    double tmp_packed_[n_xz*(n_xz + 1)/2], GammaQ_[n_xz*n_diff];
+    van_loan::discretiser<n_xz> van_loan_;
+    van_loan::dense_expm<n_xz> expm_;
+    van_loan::discretiser<n_diff> van_loan_x_;
+    van_loan::dense_expm<n_diff> expm_x_;
+};
+
+#endif
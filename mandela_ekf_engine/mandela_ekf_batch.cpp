@@ -0,0 +1,354 @@
+// Block of Mandela EKFs stepped together in lane layout (see mandela_ekf_batch.hpp)
+
+#include "mandela_ekf_batch.hpp"
+
+#include <cmath>
+
+using namespace batch_reactor;
+
+static const int L = mandela_ekf_lanes;
+
+mandela_ekf_batch::mandela_ekf_batch()
+    : n_filters_(0), initialised_(false), t_(0.0), ref_lane_(0)
+{
+    for (int l = 0; l < L; l++) {
+        status_[l] = MANDELA_EKF_NOT_INITIALISED;
+        restart_integrator_[l] = false;
+    }
+}
+
+bool mandela_ekf_batch::supports(const mandela_ekf_config &config)
+{
+    return config.covariance_model == MANDELA_EKF_FULL_COVARIANCE &&
+           config.measurement_update == MANDELA_EKF_SIMULTANEOUS_UPDATE &&
+           config.transition_model == MANDELA_EKF_EXPM_TRANSITION &&
+           config.relinearisation_rel_tol == 0 && config.relinearisation_abs_tol == 0;
+}
+
+int mandela_ekf_batch::init(const mandela_ekf_config &config, int n_filters, const double *X_init, const double *P_init)
+{
+    if (initialised_) return MANDELA_EKF_INVALID_CONFIG;
+    if (n_filters < 1 || n_filters > L) return MANDELA_EKF_INVALID_CONFIG;
+    if (!(config.Ts > 0) || config.n_outputs < 1 || config.n_outputs > n_y ||
+        config.temperature_profile.empty() ||
+        (config.process_noise_model != MANDELA_EKF_CONTINUOUS_Q && config.process_noise_model != MANDELA_EKF_DISCRETE_Q) ||
+        !supports(config)) {
+        return MANDELA_EKF_INVALID_CONFIG;
+    }
+    for (int i = 0; i < config.n_outputs; i++) {
+        if (config.output_index[i] < 0 || config.output_index[i] >= n_xz) return MANDELA_EKF_INVALID_CONFIG;
+    }
+
+    config_ = config;
+    n_filters_ = n_filters;
+    t_ = config_.t0;
+    ref_lane_ = 0;
+
+    // R padded with the identity to n_y outputs, as in mandela_ekf
+    const int n_out = config_.n_outputs;
+    small_dense::identity<n_y>(R_);
+    for (int j = 0; j < n_out; j++) {
+        for (int i = 0; i < n_out; i++) R_[i + j*n_y] = config_.R[i + j*n_out];
+    }
+
+    // Initial states; the unused lanes are copies of the first filter
+    for (int l = 0; l < L; l++) {
+        const double *X = X_init + ((l < n_filters) ? l : 0)*n_diff;
+        for (int i = 0; i < n_diff; i++) XZ_[l][i] = X[i];
+        for (int i = 0; i < n_alg; i++) XZ_[l][n_diff + i] = 0.0;
+        if (solve_algebraic_equations(XZ_[l], config_.model_params) != 0) return MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE;
+        lane_dense::set_lane<n_xz, n_xz, L>(P_, l, P_init);
+        status_[l] = (l < n_filters) ? MANDELA_EKF_SUCCESS : MANDELA_EKF_NOT_INITIALISED;
+
+        ida_data_[l].model_params = config_.model_params;
+        ida_data_[l].rates.reset(config_.model_params);
+        ida_data_[l].temperature_profile = &config_.temperature_profile;
+        ida_data_[l].noise_Ts = 0.0;
+        ida_data_[l].process_noise = NULL;
+    }
+
+    const double T_degC_init = config_.temperature_profile.eval(t_);
+    double T_degC[L];
+    for (int l = 0; l < L; l++) T_degC[l] = T_degC_init;
+    gather_state();
+    linearise(T_degC, true);
+    for (int l = 0; l < n_filters_; l++) {
+        if (status_[l] != MANDELA_EKF_SUCCESS) return status_[l];
+    }
+
+    double id[n_xz];
+    for (int i = 0; i < n_xz; i++) id[i] = (i < n_diff) ? 1.0 : 0.0;
+    for (int l = 0; l < n_filters_; l++) {
+        int flag = integrator_[l].create(n_xz, XZ_[l], XZp_[l], id, t_,
+                                         batch_reactor_ida_residual, batch_reactor_ida_jacobian, &ida_data_[l],
+                                         config_.rel_tol, config_.abs_tol, config_.max_num_steps);
+        if (flag == IDA_SUCCESS) flag = integrator_[l].calc_ic(t_ + 0.1);
+        if (flag != IDA_SUCCESS) return MANDELA_EKF_INTEGRATOR_FAILURE;
+    }
+
+    // IDACalcIC has corrected the algebraic variables
+    gather_state();
+    linearise(T_degC, false);
+    relinearise();
+    for (int l = 0; l < n_filters_; l++) {
+        if (status_[l] != MANDELA_EKF_SUCCESS) return status_[l];
+    }
+    initialised_ = true;
+    return MANDELA_EKF_SUCCESS;
+}
+
+void mandela_ekf_batch::P(int i, double *P) const
+{
+    if (i < n_filters_ && status_[i] != MANDELA_EKF_SUCCESS) {
+        small_dense::copy<n_xz, n_xz>(P_failed_[i], P);
+    } else {
+        lane_dense::get_lane<n_xz, n_xz, L>(P_, i, P);
+    }
+}
+
+void mandela_ekf_batch::fail(int l, int status)
+{
+    if (status_[l] != MANDELA_EKF_SUCCESS) return;
+    status_[l] = status;
+    lane_dense::get_lane<n_xz, n_xz, L>(P_, l, P_failed_[l]);
+}
+
+// The lanes of the failed (and unused) filters become copies of a running one
+void mandela_ekf_batch::park_failed_lanes()
+{
+    if (!running(ref_lane_)) {
+        for (ref_lane_ = 0; ref_lane_ < n_filters_ && !running(ref_lane_); ref_lane_++) {}
+        if (ref_lane_ == n_filters_) {
+            ref_lane_ = 0;
+            return;
+        }
+    }
+    const int r = ref_lane_;
+    for (int l = 0; l < L; l++) {
+        if (running(l)) continue;
+        for (int i = 0; i < n_xz*n_xz; i++) {
+            P_[i*L + l] = P_[i*L + r];
+            phi_[i*L + l] = phi_[i*L + r];
+            Qd_[i*L + l] = Qd_[i*L + r];
+        }
+        for (int i = 0; i < n_alg*n_diff; i++) Gamma_bottom_[i*L + l] = Gamma_bottom_[i*L + r];
+    }
+}
+
+// XZ_ of the running filters (and of the reference filter in the other lanes) into lane layout
+void mandela_ekf_batch::gather_state()
+{
+    for (int l = 0; l < L; l++) {
+        const double *XZ = XZ_[running(l) ? l : ref_lane_];
+        for (int i = 0; i < n_xz; i++) XZ_l_[i*L + l] = XZ[i];
+    }
+}
+
+// fx, fz and Gamma_bottom at XZ_l_, and (if consistent_derivatives) XZp_ of the running filters
+// from dX/dt = f and dZ/dt = Gamma_bottom*dX/dt
+void mandela_ekf_batch::linearise(const double *T_degC, bool consistent_derivatives)
+{
+    for (int l = 0; l < L; l++) {
+        const int m = running(l) ? l : ref_lane_;
+        rates_.set(l, ida_data_[m].rates.get(T_degC[m]));
+    }
+    int singular[L];
+    if (lane_linearisation<L>(XZ_l_, config_.model_params, rates_, fx_, fz_, Gamma_bottom_, singular) != 0) {
+        for (int l = 0; l < L; l++) {
+            if (singular[l] && running(l)) fail(l, MANDELA_EKF_SINGULAR_MATRIX);
+        }
+    }
+
+    if (!consistent_derivatives) return;
+    double f[n_diff*L], Gb_f[n_alg*L];
+    lane_state_equations<L>(XZ_l_, rates_, f);
+    lane_dense::mat_mul<n_alg, n_diff, 1, L>(Gamma_bottom_, f, Gb_f);
+    for (int l = 0; l < L; l++) {
+        if (!running(l)) continue;
+        for (int i = 0; i < n_diff; i++) XZp_[l][i] = f[i*L + l];
+        for (int i = 0; i < n_alg; i++) XZp_[l][n_diff + i] = Gb_f[i*L + l];
+    }
+}
+
+// A_aug_EKF, Gamma_EKF, phi_EKF and Qd from fx_, fz_ and Gamma_bottom_ (see mandela_ekf::relinearise)
+void mandela_ekf_batch::relinearise()
+{
+    double Gb_fx[n_alg*n_diff*L], Gb_fz[n_alg*n_alg*L];
+    lane_dense::mat_mul<n_alg, n_diff, n_diff, L>(Gamma_bottom_, fx_, Gb_fx);
+    lane_dense::mat_mul<n_alg, n_diff, n_alg, L>(Gamma_bottom_, fz_, Gb_fz);
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_diff*L; i++) A_aug_[j*n_xz*L + i] = fx_[j*n_diff*L + i];
+        for (int i = 0; i < n_alg*L; i++) A_aug_[(n_diff + j*n_xz)*L + i] = Gb_fx[j*n_alg*L + i];
+    }
+    for (int j = 0; j < n_alg; j++) {
+        for (int i = 0; i < n_diff*L; i++) A_aug_[(n_diff + j)*n_xz*L + i] = fz_[j*n_diff*L + i];
+        for (int i = 0; i < n_alg*L; i++) A_aug_[(n_diff + (n_diff + j)*n_xz)*L + i] = Gb_fz[j*n_alg*L + i];
+    }
+
+    // Qc = Gamma_EKF*Q*Gamma_EKF' with Gamma_EKF = [I; Gamma_bottom]: the blocks are Q, Q*Gb' and Gb*Q*Gb'
+    double GbQ[n_alg*n_diff*L], GbQGb[n_alg*n_alg*L];
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_alg*L; i++) GbQ[j*n_alg*L + i] = 0.0;
+        for (int k = 0; k < n_diff; k++) {
+            const double q = config_.Q[k + j*n_diff];
+            for (int i = 0; i < n_alg*L; i++) GbQ[j*n_alg*L + i] += Gamma_bottom_[k*n_alg*L + i]*q;
+        }
+    }
+    lane_dense::mat_mul_nt<n_alg, n_diff, n_alg, L>(GbQ, Gamma_bottom_, GbQGb);
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_diff; i++) {
+            for (int l = 0; l < L; l++) Qc_[(i + j*n_xz)*L + l] = config_.Q[i + j*n_diff];
+        }
+        for (int i = 0; i < n_alg*L; i++) {
+            Qc_[(n_diff + j*n_xz)*L + i] = GbQ[j*n_alg*L + i];
+        }
+    }
+    for (int j = 0; j < n_alg; j++) {
+        for (int i = 0; i < n_diff; i++) {
+            for (int l = 0; l < L; l++) Qc_[(i + (n_diff + j)*n_xz)*L + l] = GbQ[(j + i*n_alg)*L + l];
+        }
+        for (int i = 0; i < n_alg*L; i++) Qc_[(n_diff + (n_diff + j)*n_xz)*L + i] = GbQGb[j*n_alg*L + i];
+    }
+
+    int flag;
+    if (config_.process_noise_model == MANDELA_EKF_CONTINUOUS_Q) {
+        flag = van_loan_.discretise(A_aug_, Qc_, config_.Ts, phi_, Qd_);
+    } else {
+        flag = expm_.compute(A_aug_, config_.Ts, phi_);
+        lane_dense::copy<n_xz, n_xz, L>(Qc_, Qd_);
+    }
+    if (flag == 0) return;
+
+    // A singular Pade denominator in some lane: discretise the running filters one by one
+    double A[n_xz*n_xz], Qc[n_xz*n_xz], phi[n_xz*n_xz], Qd[n_xz*n_xz];
+    for (int l = 0; l < L; l++) {
+        if (!running(l)) continue;
+        lane_dense::get_lane<n_xz, n_xz, L>(A_aug_, l, A);
+        lane_dense::get_lane<n_xz, n_xz, L>(Qc_, l, Qc);
+        if (config_.process_noise_model == MANDELA_EKF_CONTINUOUS_Q) {
+            flag = van_loan_one_.discretise(A, Qc, config_.Ts, phi, Qd);
+        } else {
+            flag = expm_one_.compute(A, config_.Ts, phi);
+            small_dense::copy<n_xz, n_xz>(Qc, Qd);
+        }
+        if (flag != 0) {
+            fail(l, MANDELA_EKF_SINGULAR_MATRIX);
+            continue;
+        }
+        lane_dense::set_lane<n_xz, n_xz, L>(phi_, l, phi);
+        lane_dense::set_lane<n_xz, n_xz, L>(Qd_, l, Qd);
+    }
+}
+
+int mandela_ekf_batch::step(const double *measured_outputs, const double *T_degC)
+{
+    if (!initialised_) return MANDELA_EKF_NOT_INITIALISED;
+    int n_running = 0;
+    for (int l = 0; l < n_filters_; l++) n_running += running(l);
+    const double t_local_finish = t_ + config_.Ts;
+    const int n_out = config_.n_outputs;
+
+    // Prediction of the states, one filter at a time (see mandela_ekf::step)
+    for (int l = 0; l < n_filters_; l++) {
+        if (!running(l)) continue;
+        if (restart_integrator_[l]) {
+            double h_init = integrator_[l].last_step();
+            if (h_init > config_.Ts) h_init = config_.Ts;
+            restart_integrator_[l] = false;
+            if (integrator_[l].reinit(t_, h_init) != IDA_SUCCESS) {
+                fail(l, MANDELA_EKF_INTEGRATOR_FAILURE);
+                continue;
+            }
+        }
+        if (integrator_[l].advance(t_local_finish) != IDA_SUCCESS) fail(l, MANDELA_EKF_INTEGRATOR_FAILURE);
+    }
+    t_ = t_local_finish;
+    park_failed_lanes();
+    gather_state();
+
+    // P_EKF = phi_EKF*P_EKF*phi_EKF' + Qd
+    lane_dense::mat_mul<n_xz, n_xz, n_xz, L>(phi_, P_, tmp_a_);
+    lane_dense::mat_mul_nt<n_xz, n_xz, n_xz, L>(tmp_a_, phi_, P_);
+    for (int i = 0; i < n_xz*n_xz*L; i++) P_[i] += Qd_[i];
+
+    if (measured_outputs) {
+        // The outputs are a subset of XZ, so P*H' is a selection of columns of P and
+        // S = H*P*H' + R (padded with the identity); K' = S\(H*P)
+        double PHt[n_xz*n_y*L];
+        for (int i = 0; i < n_xz*n_y*L; i++) PHt[i] = 0.0;
+        for (int j = 0; j < n_out; j++) {
+            const double *P_col = P_ + config_.output_index[j]*n_xz*L;
+            for (int i = 0; i < n_xz*L; i++) PHt[j*n_xz*L + i] = P_col[i];
+        }
+        for (int j = 0; j < n_y; j++) {
+            for (int i = 0; i < n_y; i++) {
+                const double *p = (i < n_out) ? PHt + (config_.output_index[i] + j*n_xz)*L : NULL;
+                for (int l = 0; l < L; l++) S_[(i + j*n_y)*L + l] = (p ? p[l] : 0.0) + R_[i + j*n_y];
+            }
+        }
+        int piv[n_y*L], info[L];
+        if (lane_dense::lu_factor<n_y, L>(S_, piv, info) != 0) {
+            for (int l = 0; l < L; l++) {
+                if (info[l] && running(l)) fail(l, MANDELA_EKF_SINGULAR_MATRIX);
+            }
+        }
+        for (int j = 0; j < n_xz; j++) {
+            for (int i = 0; i < n_y; i++) {
+                for (int l = 0; l < L; l++) tmp_b_[(i + j*n_y)*L + l] = PHt[(j + i*n_xz)*L + l];
+            }
+        }
+        lane_dense::lu_solve<n_y, n_xz, L>(S_, piv, tmp_b_);
+        for (int j = 0; j < n_y; j++) {
+            for (int i = 0; i < n_xz; i++) {
+                for (int l = 0; l < L; l++) K_[(i + j*n_xz)*L + l] = tmp_b_[(j + i*n_y)*L + l];
+            }
+        }
+
+        // dX = K*innovation, dZ = Gamma_bottom*dX, then the projection onto g(X,Z) = 0 per filter
+        double innovation[n_y*L], dX[n_diff*L], dZ[n_alg*L];
+        for (int i = 0; i < n_y*L; i++) innovation[i] = 0.0;
+        for (int i = 0; i < n_out; i++) {
+            for (int l = 0; l < L; l++) {
+                const double y = running(l) ? measured_outputs[i + l*n_out] : XZ_l_[config_.output_index[i]*L + l];
+                innovation[i*L + l] = y - XZ_l_[config_.output_index[i]*L + l];
+            }
+        }
+        for (int i = 0; i < n_diff*L; i++) dX[i] = 0.0;
+        for (int j = 0; j < n_out; j++) {
+            for (int i = 0; i < n_diff; i++) {
+                for (int l = 0; l < L; l++) dX[i*L + l] += K_[(i + j*n_xz)*L + l]*innovation[j*L + l];
+            }
+        }
+        lane_dense::mat_mul<n_alg, n_diff, 1, L>(Gamma_bottom_, dX, dZ);
+        for (int l = 0; l < L; l++) {
+            if (!running(l)) continue;
+            for (int i = 0; i < n_diff; i++) XZ_[l][i] += dX[i*L + l];
+            for (int i = 0; i < n_alg; i++) XZ_[l][n_diff + i] += dZ[i*L + l];
+            restart_integrator_[l] = true;
+            if (solve_algebraic_equations(XZ_[l], config_.model_params) != 0) fail(l, MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE);
+        }
+        gather_state();
+        linearise(T_degC, true);
+
+        // P_EKF = (I - K_aug_EKF*H_aug_EKF)*P_EKF = P - K*(H*P), with H*P the rows output_index of P
+        for (int j = 0; j < n_xz; j++) {
+            for (int i = 0; i < n_xz*L; i++) tmp_a_[j*n_xz*L + i] = P_[j*n_xz*L + i];
+            for (int k = 0; k < n_out; k++) {
+                const double *HP = P_ + (config_.output_index[k] + j*n_xz)*L;
+                for (int i = 0; i < n_xz; i++) {
+                    for (int l = 0; l < L; l++) tmp_a_[(i + j*n_xz)*L + l] -= K_[(i + k*n_xz)*L + l]*HP[l];
+                }
+            }
+        }
+        lane_dense::copy<n_xz, n_xz, L>(tmp_a_, P_);
+    } else {
+        linearise(T_degC, false);
+    }
+
+    relinearise();
+    park_failed_lanes();
+
+    int n_failed = n_running;
+    for (int l = 0; l < n_filters_; l++) n_failed -= running(l);
+    return n_failed;
+}
@@ -0,0 +1,96 @@
+// A block of mandela_ekf_lanes Mandela EKFs with the same configuration, stepped together.
+// The covariances, transition matrices and gains of the filters are stored in the lane layout of
+// lane_dense.hpp (structure of arrays, the filter index innermost), so that the linearisation,
+// the Van Loan discretisation, phi*P*phi' + Qd and the gain computation run across the filters
+// as vector operations: with AVX-512 (or two AVX2 registers) one pass does all eight filters.
+// The prediction of the states stays with one IDA instance per filter, since the adaptive steps
+// of different filters cannot be taken in lock-step; so are the algebraic projections, whose
+// iteration counts differ.
+//
+// The filters are independent and give the results of mandela_ekf to rounding. A filter that
+// fails is frozen: it is no longer integrated, its lanes keep a copy of a running filter (so that
+// they cannot disturb the others), and XZ(i) and P(i) return its last estimate.
+
+#ifndef MANDELA_EKF_BATCH_HPP
+#define MANDELA_EKF_BATCH_HPP
+
+#include "batch_reactor_model_lanes.hpp"
+#include "mandela_ekf.hpp"
+#include "van_loan_lanes.hpp"
+
+const int mandela_ekf_lanes = 8;
+
+class mandela_ekf_batch {
+public:
+    static const int lanes  = mandela_ekf_lanes;
+    static const int n_diff = batch_reactor::n_diff;
+    static const int n_alg  = batch_reactor::n_alg;
+    static const int n_xz   = batch_reactor::n_xz;
+    static const int n_y    = mandela_ekf_max_outputs;
+
+    mandela_ekf_batch();
+
+    // Whether the options of config are implemented by the batch (the full covariance with the
+    // simultaneous measurement update and the expm transition, relinearised at every sample)
+    static bool supports(const mandela_ekf_config &config);
+
+    // n_filters (1..lanes) filters; config must be supported. X_init: n_diff x n_filters initial differential states (one
+    // column per filter), P_init: n_xz x n_xz initial covariance of all the filters.
+    int init(const mandela_ekf_config &config, int n_filters, const double *X_init, const double *P_init);
+
+    // One predict/update cycle of every running filter (see mandela_ekf::step).
+    // measured_outputs: n_outputs x n_filters (one column per filter), or null for a prediction
+    // only; T_degC: the input at t + Ts of every filter. Returns the no. of filters that have
+    // failed in this step (see status()), or MANDELA_EKF_NOT_INITIALISED.
+    int step(const double *measured_outputs, const double *T_degC);
+
+    int n_filters() const { return n_filters_; }
+    int status(int i) const { return status_[i]; }  // mandela_ekf_status of the last step of filter i
+    const double *XZ(int i) const { return XZ_[i]; }
+    void P(int i, double *P) const;  // n_xz x n_xz, column-major
+    double t() const { return t_; }
+
+private:
+    mandela_ekf_batch(const mandela_ekf_batch &);
+    mandela_ekf_batch &operator=(const mandela_ekf_batch &);
+
+    bool running(int l) const { return l < n_filters_ && status_[l] == MANDELA_EKF_SUCCESS; }
+    void fail(int l, int status);
+    void park_failed_lanes();
+    void gather_state();
+    void linearise(const double *T_degC, bool consistent_derivatives);
+    void relinearise();
+
+    mandela_ekf_config config_;
+    int n_filters_;
+    bool initialised_;
+    double t_;
+    int status_[lanes];
+    int ref_lane_;  // a running filter, copied into the lanes of the failed ones
+
+    // per filter: the IDA instance and the state it integrates
+    batch_reactor_ida_data ida_data_[lanes];
+    dae_integrator integrator_[lanes];
+    bool restart_integrator_[lanes];
+    double XZ_[lanes][n_xz], XZp_[lanes][n_xz];
+    double P_failed_[lanes][n_xz*n_xz];  // covariance of a failed filter at its failure
+
+    // lane layout (see lane_dense.hpp)
+    double XZ_l_[n_xz*lanes];
+    double P_[n_xz*n_xz*lanes];
+    double phi_[n_xz*n_xz*lanes], Qd_[n_xz*n_xz*lanes];
+    double fx_[n_diff*n_diff*lanes], fz_[n_diff*n_alg*lanes], Gamma_bottom_[n_alg*n_diff*lanes];
+    batch_reactor::lane_rate_coeffs<lanes> rates_;
+    double R_[n_y*n_y];
+
+    // workspace
+    double A_aug_[n_xz*n_xz*lanes], Qc_[n_xz*n_xz*lanes];
+    double K_[n_xz*n_y*lanes], S_[n_y*n_y*lanes];
+    double tmp_a_[n_xz*n_xz*lanes], tmp_b_[n_xz*n_xz*lanes];
+    van_loan::lane_discretiser<n_xz, lanes> van_loan_;
+    van_loan::lane_dense_expm<n_xz, lanes> expm_;
+    van_loan::discretiser<n_xz> van_loan_one_;  // per-filter fallback when a lane is singular
+    van_loan::dense_expm<n_xz> expm_one_;
+};
+
+#endif
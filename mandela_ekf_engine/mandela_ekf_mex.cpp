@@ -0,0 +1,254 @@
+/*
+ * MATLAB interface to the native Mandela EKF (or, with ekf_config.Filter = 'ukf' or 'mhe', the UKF
+ * or the moving-horizon estimator)
+ *
+ * h = mandela_ekf_mex('new',ekf_config)
+ * [XZ,P] = mandela_ekf_mex('step',h,measured_outputs,T_degC)
+ * [XZ,P] = mandela_ekf_mex('step_to',h,t_meas,measured_outputs,T_degC)
+ * [XZ,P,t] = mandela_ekf_mex('get',h)
+ * stats = mandela_ekf_mex('stats',h)
+ * mandela_ekf_mex('save',h,file)
+ * mandela_ekf_mex('load',h,file)
+ * [timing,summary] = mandela_ekf_mex('stream',h,stream_config)
+ * mandela_ekf_mex('delete',h)
+ *
+ * see mandela_ekf_mex.m for the fields of ekf_config and make_mandela_ekf.m
+ * for the compile command
+ */
+
+#include "mex.h"
+#include "checkpoint_file.hpp"
+#include "mandela_ekf.hpp"
+#include "mandela_mhe.hpp"
+#include "mandela_ukf.hpp"
+#include "measurement_stream.hpp"
+#include "mex_config_fields.hpp"
+#include "mex_instance_table.hpp"
+
+#include <cstring>
+#include <vector>
+
+static const char *const config_err_id = "mandela_ekf:config";
+static mex_instance_table<mandela_estimator> instances;
+
+static void delete_all_instances(void)
+{
+    instances.clear();
+}
+
+static void return_state(int nlhs, mxArray *plhs[], const mandela_estimator *ekf)
+{
+    const int n_xz = mandela_ekf::n_xz;
+    plhs[0] = mxCreateDoubleMatrix(n_xz, 1, mxREAL);
+    std::memcpy(mxGetPr(plhs[0]), ekf->XZ(), n_xz*sizeof(double));
+    if (nlhs >= 2) {
+        plhs[1] = mxCreateDoubleMatrix(n_xz, n_xz, mxREAL);
+        std::memcpy(mxGetPr(plhs[1]), ekf->P(), n_xz*n_xz*sizeof(double));
+    }
+    if (nlhs >= 3) plhs[2] = mxCreateDoubleScalar(ekf->t());
+}
+
+static void new_instance(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    if (nrhs != 2 || !mxIsStruct(prhs[1])) mexErrMsgIdAndTxt("mandela_ekf:usage", "Usage: h = mandela_ekf_mex('new',ekf_config)");
+    if (nlhs > 1) mexErrMsgIdAndTxt("mandela_ekf:usage", "Too many output arguments.");
+    const mxArray *s = prhs[1];
+
+    mandela_ekf_config config;
+    mandela_ukf_options ukf_options;
+    mandela_mhe_options mhe_options;
+    double X_init[mandela_ekf::n_diff], P_init[mandela_ekf::n_xz*mandela_ekf::n_xz];
+    get_ekf_config(s, config, X_init, P_init, config_err_id);
+    const int filter = get_filter_options(s, ukf_options, mhe_options, config_err_id);
+
+    mandela_estimator *estimator;
+    int status;
+    if (filter == MEX_FILTER_UKF) {
+        mandela_ukf *f = new mandela_ukf();
+        estimator = f;
+        status = f->init(config, ukf_options, X_init, P_init);
+    } else if (filter == MEX_FILTER_MHE) {
+        mandela_mhe *f = new mandela_mhe();
+        estimator = f;
+        status = f->init(config, mhe_options, X_init, P_init);
+    } else {
+        mandela_ekf *f = new mandela_ekf();
+        estimator = f;
+        status = f->init(config, X_init, P_init);
+    }
+    if (status != MANDELA_EKF_SUCCESS) {
+        delete estimator;
+        const char *const names[] = {"EKF", "UKF", "MHE"};
+        mexErrMsgIdAndTxt("mandela_ekf:init", "%s initialisation failed: %s", names[filter], mandela_ekf_status_message(status));
+    }
+
+    plhs[0] = instances.add(estimator);
+}
+
+// Checkpoint of the filter state to a file ('save') or restore from one ('load')
+static void checkpoint(int nrhs, const mxArray *prhs[], bool save)
+{
+    if (nrhs != 3 || !mxIsChar(prhs[2])) {
+        mexErrMsgIdAndTxt("mandela_ekf:usage", save ? "Usage: mandela_ekf_mex('save',h,file)" : "Usage: mandela_ekf_mex('load',h,file)");
+    }
+    mandela_ekf *ekf = dynamic_cast<mandela_ekf *>(instances.get(prhs[1], "mandela_ekf:handle"));
+    if (!ekf) mexErrMsgIdAndTxt("mandela_ekf:usage", "Checkpoints are only available for the EKF.");
+    char *path = mxArrayToString(prhs[2]);
+
+    mandela_ekf_snapshot snapshot;
+    int status;
+    if (save) {
+        status = ekf->save(snapshot);
+        if (status == MANDELA_EKF_SUCCESS) status = write_checkpoint(path, snapshot);
+    } else {
+        status = read_checkpoint(path, snapshot);
+        if (status == MANDELA_EKF_SUCCESS) status = ekf->restore(snapshot);
+    }
+    if (status != MANDELA_EKF_SUCCESS) {
+        mexErrMsgIdAndTxt("mandela_ekf:checkpoint", "%s '%s' failed: %s", save ? "Saving" : "Loading", path, mandela_ekf_status_message(status));
+    }
+    mxFree(path);
+}
+
+// Estimation from a named pipe until the end of the stream (see measurement_stream.hpp)
+static void stream(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    if (nrhs != 3 || !mxIsStruct(prhs[2])) mexErrMsgIdAndTxt("mandela_ekf:usage", "Usage: [timing,summary] = mandela_ekf_mex('stream',h,stream_config)");
+    mandela_estimator *ekf = instances.get(prhs[1], "mandela_ekf:handle");
+    const mxArray *s = prhs[2];
+    const char *const err_id = "mandela_ekf:stream";
+
+    const mxArray *in = mxGetField(s, 0, "input");
+    const mxArray *out = mxGetField(s, 0, "output");
+    const mxArray *ckpt = mxGetField(s, 0, "checkpoint");
+    char *input_path = (in && mxIsChar(in)) ? mxArrayToString(in) : NULL;
+    char *output_path = (out && mxIsChar(out)) ? mxArrayToString(out) : NULL;
+    char *checkpoint_path = (ckpt && mxIsChar(ckpt)) ? mxArrayToString(ckpt) : NULL;
+    if (!input_path || (out && !output_path)) mexErrMsgIdAndTxt(err_id, "Fields 'input' and 'output' must be file names.");
+    if (ckpt && !checkpoint_path) mexErrMsgIdAndTxt(err_id, "Field 'checkpoint' must be a file name.");
+    if (checkpoint_path && !dynamic_cast<mandela_ekf *>(ekf)) mexErrMsgIdAndTxt(err_id, "Checkpoints are only available for the EKF.");
+
+    stream_config config;
+    config.input_path = input_path;
+    config.output_path = output_path;
+    config.deadline_s = get_field_scalar(s, "deadline", ekf->Ts(), false, err_id);
+    config.idle_timeout_s = get_field_scalar(s, "idle_timeout", 0, false, err_id);
+    config.checkpoint_path = checkpoint_path;
+    config.checkpoint_interval = (int)get_field_scalar(s, "checkpoint_interval", 1, false, err_id);
+    if (config.checkpoint_interval < 1) mexErrMsgIdAndTxt(err_id, "checkpoint_interval must be a positive integer.");
+
+    std::vector<stream_step_timing> timing;
+    timing.reserve(4096);
+    stream_summary summary;
+    const int status = run_estimation_stream(*ekf, config, timing, summary);
+    mxFree(input_path);
+    if (output_path) mxFree(output_path);
+    if (checkpoint_path) mxFree(checkpoint_path);
+    if (status == MANDELA_EKF_INVALID_CONFIG && timing.empty()) mexErrMsgIdAndTxt(err_id, "Could not open the input or the output stream.");
+    if (status == MANDELA_EKF_CHECKPOINT_FAILURE) {
+        mexWarnMsgIdAndTxt(err_id, "The last checkpoint could not be written: %s", mandela_ekf_status_message(status));
+    } else if (status != MANDELA_EKF_SUCCESS) {
+        mexWarnMsgIdAndTxt(err_id, "Estimator step failed at t = %g: %s", ekf->t(), mandela_ekf_status_message(status));
+    }
+
+    // [t status latency_us step_us], one row per processed sample
+    const size_t n = timing.size();
+    plhs[0] = mxCreateDoubleMatrix(n, 4, mxREAL);
+    double *T = mxGetPr(plhs[0]);
+    for (size_t i = 0; i < n; i++) {
+        T[i] = timing[i].t;
+        T[i + n] = timing[i].status;
+        T[i + 2*n] = timing[i].latency_us;
+        T[i + 3*n] = timing[i].step_us;
+    }
+    if (nlhs >= 2) {
+        const char *fields[] = {"status", "n_samples", "n_dropped", "n_deadline_misses", "max_latency_us", "timed_out", "n_checkpoints"};
+        plhs[1] = mxCreateStructMatrix(1, 1, 7, fields);
+        mxSetField(plhs[1], 0, "status", mxCreateDoubleScalar(status));
+        mxSetField(plhs[1], 0, "n_samples", mxCreateDoubleScalar(summary.n_samples));
+        mxSetField(plhs[1], 0, "n_dropped", mxCreateDoubleScalar(summary.n_dropped));
+        mxSetField(plhs[1], 0, "n_deadline_misses", mxCreateDoubleScalar(summary.n_deadline_misses));
+        mxSetField(plhs[1], 0, "max_latency_us", mxCreateDoubleScalar(summary.max_latency_us));
+        mxSetField(plhs[1], 0, "timed_out", mxCreateDoubleScalar(summary.timed_out ? 1 : 0));
+        mxSetField(plhs[1], 0, "n_checkpoints", mxCreateDoubleScalar((double)summary.n_checkpoints));
+    }
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    char cmd[16];
+
+    mexAtExit(delete_all_instances);
+    if (nrhs < 1 || !mxIsChar(prhs[0]) || mxGetString(prhs[0], cmd, sizeof(cmd)) != 0) {
+        mexErrMsgIdAndTxt("mandela_ekf:usage", "First input must be one of 'new', 'step', 'step_to', 'get', 'stats', 'save', 'load', 'stream' or 'delete'.");
+    }
+
+    if (std::strcmp(cmd, "new") == 0) {
+        new_instance(nlhs, plhs, nrhs, prhs);
+    }
+    else if (std::strcmp(cmd, "step") == 0) {
+        if (nrhs != 4) mexErrMsgIdAndTxt("mandela_ekf:usage", "Usage: [XZ,P] = mandela_ekf_mex('step',h,measured_outputs,T_degC)");
+        mandela_estimator *ekf = instances.get(prhs[1], "mandela_ekf:handle");
+        const bool has_measurement = !mxIsEmpty(prhs[2]);  // [] if there is no measurement at this sample
+        if (has_measurement && (!mxIsDouble(prhs[2]) || mxGetNumberOfElements(prhs[2]) != (size_t)ekf->n_outputs())) {
+            mexErrMsgIdAndTxt("mandela_ekf:usage", "measured_outputs must be [] or a double vector with %d elements.", ekf->n_outputs());
+        }
+        const int status = ekf->step(has_measurement ? mxGetPr(prhs[2]) : NULL, mxGetScalar(prhs[3]));
+        if (status != MANDELA_EKF_SUCCESS) {
+            mexErrMsgIdAndTxt("mandela_ekf:step", "EKF step failed at t = %g: %s", ekf->t(), mandela_ekf_status_message(status));
+        }
+        return_state(nlhs, plhs, ekf);
+    }
+    else if (std::strcmp(cmd, "step_to") == 0) {
+        if (nrhs != 5) mexErrMsgIdAndTxt("mandela_ekf:usage", "Usage: [XZ,P] = mandela_ekf_mex('step_to',h,t_meas,measured_outputs,T_degC)");
+        mandela_ekf *ekf = dynamic_cast<mandela_ekf *>(instances.get(prhs[1], "mandela_ekf:handle"));
+        if (!ekf) mexErrMsgIdAndTxt("mandela_ekf:usage", "'step_to' is only available for the EKF.");
+        const bool has_measurement = !mxIsEmpty(prhs[3]);
+        if (has_measurement && (!mxIsDouble(prhs[3]) || mxGetNumberOfElements(prhs[3]) != (size_t)ekf->n_outputs())) {
+            mexErrMsgIdAndTxt("mandela_ekf:usage", "measured_outputs must be [] or a double vector with %d elements.", ekf->n_outputs());
+        }
+        const double t_meas = mxGetScalar(prhs[2]);
+        const int status = ekf->step_to(t_meas, has_measurement ? mxGetPr(prhs[3]) : NULL, mxGetScalar(prhs[4]));
+        if (status != MANDELA_EKF_SUCCESS) {
+            mexErrMsgIdAndTxt("mandela_ekf:step", "EKF step to t = %g failed: %s", t_meas, mandela_ekf_status_message(status));
+        }
+        return_state(nlhs, plhs, ekf);
+    }
+    else if (std::strcmp(cmd, "get") == 0) {
+        if (nrhs != 2) mexErrMsgIdAndTxt("mandela_ekf:usage", "Usage: [XZ,P,t] = mandela_ekf_mex('get',h)");
+        return_state(nlhs, plhs, instances.get(prhs[1], "mandela_ekf:handle"));
+    }
+    else if (std::strcmp(cmd, "stats") == 0) {
+        if (nrhs != 2) mexErrMsgIdAndTxt("mandela_ekf:usage", "Usage: stats = mandela_ekf_mex('stats',h)");
+        const mandela_estimator *estimator = instances.get(prhs[1], "mandela_ekf:handle");
+        const mandela_ekf *ekf = dynamic_cast<const mandela_ekf *>(estimator);
+        const mandela_mhe *mhe = dynamic_cast<const mandela_mhe *>(estimator);
+        if (ekf) {
+            const char *fields[] = {"n_relinearisations", "n_reused_linearisations"};
+            plhs[0] = mxCreateStructMatrix(1, 1, 2, fields);
+            mxSetField(plhs[0], 0, "n_relinearisations", mxCreateDoubleScalar((double)ekf->n_relinearisations()));
+            mxSetField(plhs[0], 0, "n_reused_linearisations", mxCreateDoubleScalar((double)ekf->n_reused_linearisations()));
+        } else if (mhe) {
+            const char *fields[] = {"n_iterations", "n_integrations", "n_reused_integrations"};
+            plhs[0] = mxCreateStructMatrix(1, 1, 3, fields);
+            mxSetField(plhs[0], 0, "n_iterations", mxCreateDoubleScalar((double)mhe->n_iterations()));
+            mxSetField(plhs[0], 0, "n_integrations", mxCreateDoubleScalar((double)mhe->n_integrations()));
+            mxSetField(plhs[0], 0, "n_reused_integrations", mxCreateDoubleScalar((double)mhe->n_reused_integrations()));
+        } else {
+            mexErrMsgIdAndTxt("mandela_ekf:usage", "'stats' is only available for the EKF and the MHE.");
+        }
+    }
+    else if (std::strcmp(cmd, "save") == 0 || std::strcmp(cmd, "load") == 0) {
+        checkpoint(nrhs, prhs, std::strcmp(cmd, "save") == 0);
+    }
+    else if (std::strcmp(cmd, "stream") == 0) {
+        stream(nlhs, plhs, nrhs, prhs);
+    }
+    else if (std::strcmp(cmd, "delete") == 0) {
+        if (nrhs != 2) mexErrMsgIdAndTxt("mandela_ekf:usage", "Usage: mandela_ekf_mex('delete',h)");
+        instances.remove(prhs[1], "mandela_ekf:handle");
+    }
+    else {
+        mexErrMsgIdAndTxt("mandela_ekf:usage", "Unknown command '%s'.", cmd);
+    }
+}
@@ -0,0 +1,132 @@
+%MANDELA_EKF_MEX Native (compiled) Mandela EKF or UKF for the batch chemical reactor.
+%   H = MANDELA_EKF_MEX('new',EKF_CONFIG) creates a filter and returns its
+%   handle H. EKF_CONFIG is a struct with the fields
+%       model_params  struct of model parameters (as in the MATLAB scripts)
+%       Ts            sampling interval [sec]
+%       t0            initial time [sec] (default 0)
+%       Q             n_diff-by-n_diff process noise covariance
+%       ProcessNoise  'continuous' (default): Q is a continuous-time noise
+%                     intensity, and the transition matrix and the discrete
+%                     process noise covariance are computed together with one
+%                     (Van Loan) matrix exponential.
+%                     'discrete': Gamma*Q*Gamma' is added to the covariance
+%                     at every sample, as in Mandela_EKF_using_alg_measurement.m
+%       Covariance    'full' (default): the (n_diff+n_alg)-by-(n_diff+n_alg)
+%                     covariance of [X; Z] is propagated, as in the script.
+%                     'reduced': only the n_diff-by-n_diff covariance of X is
+%                     propagated (with A = fx + fz*Gamma_bottom), and P is
+%                     Gamma*P_xx*Gamma' with Gamma = [I; -inv(gz)*gx] (EKF only)
+%       R             n_outputs-by-n_outputs measurement noise covariance
+%       MeasurementUpdate  'simultaneous' (default): K = P*H'/(H*P*H' + R).
+%                     'sequential': the outputs are whitened with chol(R) and
+%                     processed one at a time as scalar updates (no matrix
+%                     inversion; for a diagonal R the cost grows linearly
+%                     with the no. of outputs). R must be positive definite.
+%       Transition    'expm' (default): the transition matrix is expm(A*Ts)
+%                     of the linearisation at the start of the interval, as in
+%                     the script. 'sensitivity': it is dXZ(t+Ts)/dX(t) from
+%                     forward sensitivities integrated by IDAS with the
+%                     prediction (EKF only)
+%       output_index  indices (1-based) of the measured variables in XZ
+%       P_EKF         initial (n_diff+n_alg)-by-(n_diff+n_alg) covariance
+%       X_init_ekf    initial differential states (n_diff-by-1)
+%       time_profile  time [sec] of the input (temperature) profile
+%       Temp_profile  temperature [degC] at the times in time_profile
+%       profile_file  instead of time_profile and Temp_profile: a csv file
+%                     with time [hours] and temperature [degC] columns, e.g.
+%                     temperature_vs_time_profile.csv
+%       RelTol,AbsTol IDA tolerances (default 1e-6)
+%       RelinRelTol,RelinAbsTol,RelinInputTol  lazy relinearisation (EKF
+%                     only): the transition matrix, Qd and Gamma are re-used
+%                     while abs(XZ - XZ_lin) <= RelinRelTol*abs(XZ_lin) +
+%                     RelinAbsTol for every component, where XZ_lin is the
+%                     point of the last linearisation, and T is within
+%                     RelinInputTol [degC] of its input (default 0:
+%                     relinearise at every sample)
+%       MaxNumSteps   max. no. of IDA steps per sample (default 1500)
+%       Filter        'ekf' (default), 'ukf' or 'mhe'. 'ukf': unscented
+%                     Kalman filter with 2*n_diff+1 sigma points of the
+%                     differential states, whose algebraic variables are
+%                     solved from the algebraic equations. The sigma points
+%                     are integrated in parallel, each with its own IDA
+%                     instance. With ProcessNoise 'continuous', Q*Ts is
+%                     added per sample. 'mhe': moving-horizon estimator,
+%                     i.e. Gauss-Newton on the differential states of the
+%                     last MHEHorizon+1 samples (multiple shooting with IDAS
+%                     sensitivities, structured QR of the block-banded
+%                     problem), with the arrival cost carried over from the
+%                     previous window. Q*Ts ('continuous') or Q ('discrete')
+%                     weights the process noise of every interval and must
+%                     be positive definite.
+%       UKFAlpha,UKFBeta,UKFKappa  parameters of the scaled unscented
+%                     transform (default 1e-3, 2 and 0)
+%       NumThreads    threads of the UKF (default 0: one per core)
+%       MHEHorizon    no. of sampling intervals of the MHE window (default 10)
+%       MHEIterations max. Gauss-Newton iterations of the MHE per sample
+%                     (default 2; fewer once the step is within RelTol/AbsTol)
+%   The algebraic variables are initialised from the algebraic equations.
+%   The UKF, the MHE (as its initial arrival cost) and the reduced covariance
+%   only use the differential-state block of P_EKF.
+%
+%   [XZ,P] = MANDELA_EKF_MEX('step',H,MEASURED_OUTPUTS,T_DEGC) predicts the
+%   state over one sampling interval, updates it with the measurements taken
+%   at the end of the interval and relinearises the model with the input
+%   T_DEGC at that time (the UKF and the MHE do not use T_DEGC). XZ is the updated augmented state and P its
+%   covariance. MEASURED_OUTPUTS may be [] (no measurement at this sample),
+%   in which case only the prediction is done. The EKF keeps its IDA
+%   instance between samples and only re-initialises it after a measurement
+%   update.
+%
+%   [XZ,P] = MANDELA_EKF_MEX('step_to',H,T_MEAS,MEASURED_OUTPUTS,T_DEGC) is
+%   the same for a measurement taken at an arbitrary time T_MEAS (not earlier
+%   than the current estimate) with the input T_DEGC at T_MEAS (EKF only), for
+%   analysers that report late, irregularly or in bursts. The transition
+%   matrix is computed for the actual interval. Measurements that follow each
+%   other within Ts are predicted from the dense output of the running IDA
+%   integration, with the earlier updates carried along linearly, instead of
+%   restarting IDA at each one.
+%
+%   [XZ,P,T] = MANDELA_EKF_MEX('get',H) returns the current estimate and
+%   its time without stepping the filter.
+%
+%   STATS = MANDELA_EKF_MEX('stats',H) returns the struct with the fields
+%   n_relinearisations (including the one of 'new') and
+%   n_reused_linearisations (samples that re-used the last linearisation) of
+%   an EKF, or n_iterations (Gauss-Newton iterations), n_integrations and
+%   n_reused_integrations (intervals that were not re-integrated) of an MHE.
+%
+%   MANDELA_EKF_MEX('save',H,FILE) writes the complete state of an EKF
+%   (estimate, derivatives, covariance, cached linearisation, IDA step size)
+%   to the binary checkpoint FILE (see checkpoint_file.hpp), and
+%   MANDELA_EKF_MEX('load',H,FILE) restores it into the EKF H, which must
+%   have been created with the configuration of the saved one. A campaign
+%   that has been interrupted continues from the checkpoint instead of
+%   re-converging from X_init_ekf.
+%
+%   [TIMING,SUMMARY] = MANDELA_EKF_MEX('stream',H,STREAM_CONFIG) runs the
+%   filter in real time on samples read from a named pipe (POSIX only), until
+%   the line 'end' or the end of the input. STREAM_CONFIG has the fields
+%       input         named pipe (mkfifo) with one line per sample:
+%                     t T_degC y_1 ... y_n_outputs  (y = nan: no measurement)
+%       output        (optional) named pipe or file that receives one line per
+%                     sample as soon as it has been processed:
+%                     t status XZ' sqrt(diag(P))' latency_us
+%       deadline      latency budget per sample [sec] (default Ts)
+%       idle_timeout  stop when no data arrives for this long [sec]
+%                     (default 0: wait for the end of the input)
+%       checkpoint    (optional, EKF only) checkpoint file, written by a
+%                     background thread after every checkpoint_interval
+%                     samples (default 1), so that the step loop does not wait
+%                     for the disk; restore it with 'load'
+%   Each sample is processed on arrival. The samples of the EKF may have any
+%   time stamps ('step_to'); those of the UKF and the MHE must be at t0 + k*Ts. Gaps are
+%   bridged by prediction-only steps, and samples that are not later than the
+%   estimate are dropped. TIMING has one row per sample, [t status latency_us step_us],
+%   where latency_us runs from the arrival of the sample to the output of its
+%   estimate and step_us covers the filter step alone. SUMMARY has the fields
+%   status, n_samples, n_dropped, n_deadline_misses, max_latency_us,
+%   timed_out and n_checkpoints. See Mandela_EKF_streaming.m and Mandela_EKF_stream_replay.m.
+%
+%   MANDELA_EKF_MEX('delete',H) releases the filter.
+%
+%   See also BATCH_REACTOR_PLANT_MEX, MAKE_MANDELA_EKF.
@@ -0,0 +1,77 @@
+/*
+ * MATLAB interface to the Monte Carlo campaign of the native Mandela EKF
+ *
+ * summary = mandela_ekf_monte_carlo_mex(campaign)
+ *
+ * see mandela_ekf_monte_carlo_mex.m for the fields of campaign and the columns of summary,
+ * and make_mandela_ekf.m for the compile command
+ */
+
+#include "mex.h"
+#include "monte_carlo_campaign.hpp"
+#include "mex_config_fields.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char *const config_err_id = "mandela_ekf_monte_carlo:config";
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    const int n_diff = batch_reactor::n_diff;
+    if (nrhs != 1 || !mxIsStruct(prhs[0]) || nlhs > 1) {
+        mexErrMsgIdAndTxt("mandela_ekf_monte_carlo:usage", "Usage: summary = mandela_ekf_monte_carlo_mex(campaign)");
+    }
+    const mxArray *s = prhs[0];
+
+    const mxArray *ekf_s = mxGetField(s, 0, "ekf_config");
+    const mxArray *plant_s = mxGetField(s, 0, "plant_config");
+    if (!ekf_s || !mxIsStruct(ekf_s) || !plant_s || !mxIsStruct(plant_s)) {
+        mexErrMsgIdAndTxt(config_err_id, "Fields 'ekf_config' and 'plant_config' must be structs.");
+    }
+
+    monte_carlo_config config;
+    get_ekf_config(ekf_s, config.ekf, config.X_init_ekf, config.P_init, config_err_id);
+    get_plant_config(plant_s, config.plant, config.X_init_truth, config_err_id);
+    config.tf = get_field_scalar(s, "tf", 0, true, config_err_id);
+    config.n_runs = (int)get_field_scalar(s, "n_runs", 0, true, config_err_id);
+    config.seed = (uint32_t)get_field_scalar(s, "seed", 0, false, config_err_id);
+    config.n_threads = (int)get_field_scalar(s, "n_threads", 0, false, config_err_id);
+    config.batched = get_field_scalar(s, "batched", 0, false, config_err_id) != 0;
+    config.enable_sensor_noise = get_field_scalar(s, "enable_sensor_noise", 1, false, config_err_id) != 0;
+    for (int i = 0; i < n_diff; i++) config.X_init_ekf_std[i] = 0.0;
+    if (mxGetField(s, 0, "X_init_ekf_std")) get_field_array(s, "X_init_ekf_std", n_diff, config.X_init_ekf_std, config_err_id);
+    if (config.n_runs < 1) mexErrMsgIdAndTxt(config_err_id, "Field 'n_runs' must be positive.");
+
+    std::FILE *out = NULL;
+    const mxArray *of = mxGetField(s, 0, "output_file");
+    if (of) {
+        char *file_name = mxIsChar(of) ? mxArrayToString(of) : NULL;
+        if (!file_name) mexErrMsgIdAndTxt(config_err_id, "Field 'output_file' must be a file name.");
+        out = std::fopen(file_name, "w");
+        mxFree(file_name);
+        if (!out) mexErrMsgIdAndTxt("mandela_ekf_monte_carlo:output", "Could not open 'output_file' for writing.");
+        monte_carlo_write_header(out);
+    }
+
+    std::vector<monte_carlo_run_summary> summaries(config.n_runs);
+    const int n_failed = run_monte_carlo_campaign(config, out, &summaries[0]);
+    if (out) std::fclose(out);
+    if (n_failed < 0) mexErrMsgIdAndTxt(config_err_id, "Invalid campaign: %s", mandela_ekf_status_message(n_failed));
+    if (n_failed > 0) mexWarnMsgIdAndTxt("mandela_ekf_monte_carlo:failed", "%d of %d runs failed (see the status column).", n_failed, config.n_runs);
+
+    // [run status n_samples rmse(1:n_diff) mean_nees max_nees], one row per run
+    const int n_cols = 5 + n_diff;
+    plhs[0] = mxCreateDoubleMatrix(config.n_runs, n_cols, mxREAL);
+    double *S = mxGetPr(plhs[0]);
+    for (int r = 0; r < config.n_runs; r++) {
+        const monte_carlo_run_summary &sr = summaries[r];
+        S[r] = sr.run + 1;
+        S[r + config.n_runs] = sr.status;
+        S[r + 2*config.n_runs] = sr.n_samples;
+        for (int i = 0; i < n_diff; i++) S[r + (3 + i)*config.n_runs] = sr.rmse[i];
+        S[r + (3 + n_diff)*config.n_runs] = sr.mean_nees;
+        S[r + (4 + n_diff)*config.n_runs] = sr.max_nees;
+    }
+}
@@ -0,0 +1,40 @@
+%MANDELA_EKF_MONTE_CARLO_MEX Parallel Monte Carlo campaign of the native Mandela EKF.
+%   SUMMARY = MANDELA_EKF_MONTE_CARLO_MEX(CAMPAIGN) runs CAMPAIGN.n_runs
+%   independent simulations of the truth plant (BATCH_REACTOR_PLANT_MEX) and
+%   the EKF (MANDELA_EKF_MEX), as in Mandela_EKF_native_engine.m, on a pool
+%   of threads. CAMPAIGN is a struct with the fields
+%       ekf_config      as for MANDELA_EKF_MEX('new',...); X_init_ekf is the
+%                       nominal initial estimate
+%       plant_config    as for BATCH_REACTOR_PLANT_MEX('new',...) (same Ts and t0)
+%       tf              simulation end time [sec]
+%       n_runs          no. of runs
+%       seed            seed of the random numbers (default 0)
+%       n_threads       no. of threads (default 0: one per hardware thread)
+%       batched         0 or 1 (default 0): the EKFs of 8 consecutive runs are
+%                       stepped together, with their covariance computations
+%                       vectorised across the runs (same results to rounding;
+%                       ignored with ekf_config.Covariance 'reduced',
+%                       MeasurementUpdate 'sequential' or Transition
+%                       'sensitivity')
+%       X_init_ekf_std  std. dev. of the random initial mismatch added to
+%                       ekf_config.X_init_ekf (n_diff-by-1, default zeros)
+%       enable_sensor_noise  0 or 1 (default 1): measurements are corrupted
+%                       by zero mean gaussian noise of covariance ekf_config.R
+%       output_file     (optional) csv file to which one line per run is
+%                       written as soon as the run has finished
+%   Every run draws its random numbers from its own counter-based stream
+%   (Philox4x32-10, keyed by seed and run no.), so the results of a run do
+%   not depend on the number of threads. This includes the process noise of
+%   its plant with plant_config.ProcessNoise 'piecewise_constant' (the
+%   noise_seed and noise_stream of plant_config are not used).
+%
+%   SUMMARY has one row per run and the columns
+%       [run status n_samples rmse(1:n_diff) mean_nees max_nees]
+%   where status is 0 for a successful run (negative: see mandela_ekf.hpp),
+%   rmse is the RMS error of each differential state after the measurement
+%   updates, and nees the normalised estimation error squared of the
+%   differential states, e'*inv(P(1:n_diff,1:n_diff))*e (mean n_diff for a
+%   consistent filter). The csv file has the same columns, in order of
+%   completion.
+%
+%   See also MANDELA_EKF_MEX, BATCH_REACTOR_PLANT_MEX, MAKE_MANDELA_EKF.
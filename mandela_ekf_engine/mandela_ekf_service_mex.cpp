@@ -0,0 +1,80 @@
+/*
+ * MATLAB interface to the multi-reactor estimator service of the native Mandela EKF
+ *
+ * [timing,summary] = mandela_ekf_service_mex(service_config)
+ *
+ * see mandela_ekf_service_mex.m for the fields of service_config and the columns of timing,
+ * and make_mandela_ekf.m for the compile command
+ */
+
+#include "mex.h"
+#include "reactor_service.hpp"
+#include "mex_config_fields.hpp"
+
+#include <vector>
+
+static const char *const config_err_id = "mandela_ekf_service:config";
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    if (nrhs != 1 || !mxIsStruct(prhs[0]) || nlhs > 2) {
+        mexErrMsgIdAndTxt("mandela_ekf_service:usage", "Usage: [timing,summary] = mandela_ekf_service_mex(service_config)");
+    }
+    const mxArray *s = prhs[0];
+
+    const mxArray *ekf_s = mxGetField(s, 0, "ekf_config");
+    if (!ekf_s || !mxIsStruct(ekf_s)) mexErrMsgIdAndTxt(config_err_id, "Field 'ekf_config' must be a struct.");
+
+    reactor_service_config config;
+    get_ekf_config(ekf_s, config.ekf, config.X_init, config.P_init, config_err_id);
+    config.max_reactors = (int)get_field_scalar(s, "max_reactors", 0, true, config_err_id);
+    config.n_threads = (int)get_field_scalar(s, "n_threads", 0, false, config_err_id);
+    config.idle_timeout_s = get_field_scalar(s, "idle_timeout", 0, false, config_err_id);
+    if (config.max_reactors < 1) mexErrMsgIdAndTxt(config_err_id, "Field 'max_reactors' must be positive.");
+
+    const mxArray *in = mxGetField(s, 0, "input");
+    const mxArray *out = mxGetField(s, 0, "output");
+    char *input_path = (in && mxIsChar(in)) ? mxArrayToString(in) : NULL;
+    char *output_path = (out && mxIsChar(out)) ? mxArrayToString(out) : NULL;
+    if (!input_path || (out && !output_path)) mexErrMsgIdAndTxt(config_err_id, "Fields 'input' and 'output' must be file names.");
+    config.input_path = input_path;
+    config.output_path = output_path;
+
+    std::vector<reactor_batch_timing> timing;
+    timing.reserve(4096);
+    reactor_service_summary summary;
+    int status;
+    int n_active;
+    {
+        reactor_service service(config);
+        status = service.run(timing, summary);
+        n_active = service.n_active();
+    }
+    mxFree(input_path);
+    if (output_path) mxFree(output_path);
+    if (status != MANDELA_EKF_SUCCESS) mexErrMsgIdAndTxt("mandela_ekf_service:stream", "Could not open the input or the output stream.");
+    if (summary.n_failed > 0) {
+        mexWarnMsgIdAndTxt("mandela_ekf_service:failed", "%d filter steps failed (see the status column of the replies).", summary.n_failed);
+    }
+
+    // [n_samples n_reactors process_us max_latency_us], one row per batch
+    const size_t n = timing.size();
+    plhs[0] = mxCreateDoubleMatrix(n, 4, mxREAL);
+    double *T = mxGetPr(plhs[0]);
+    for (size_t i = 0; i < n; i++) {
+        T[i] = timing[i].n_samples;
+        T[i + n] = timing[i].n_reactors;
+        T[i + 2*n] = timing[i].process_us;
+        T[i + 3*n] = timing[i].max_latency_us;
+    }
+    if (nlhs >= 2) {
+        const char *fields[] = {"n_samples", "n_dropped", "n_failed", "n_reactors", "max_latency_us", "timed_out"};
+        plhs[1] = mxCreateStructMatrix(1, 1, 6, fields);
+        mxSetField(plhs[1], 0, "n_samples", mxCreateDoubleScalar(summary.n_samples));
+        mxSetField(plhs[1], 0, "n_dropped", mxCreateDoubleScalar(summary.n_dropped));
+        mxSetField(plhs[1], 0, "n_failed", mxCreateDoubleScalar(summary.n_failed));
+        mxSetField(plhs[1], 0, "n_reactors", mxCreateDoubleScalar(n_active));
+        mxSetField(plhs[1], 0, "max_latency_us", mxCreateDoubleScalar(summary.max_latency_us));
+        mxSetField(plhs[1], 0, "timed_out", mxCreateDoubleScalar(summary.timed_out ? 1 : 0));
+    }
+}
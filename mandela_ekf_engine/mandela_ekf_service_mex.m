@@ -0,0 +1,31 @@
+%MANDELA_EKF_SERVICE_MEX Native estimator service for many reactors (POSIX only).
+%   [TIMING,SUMMARY] = MANDELA_EKF_SERVICE_MEX(SERVICE_CONFIG) keeps one
+%   Mandela EKF per reactor vessel and serves the samples of all the reactors
+%   from one named pipe until the line 'end'. SERVICE_CONFIG is a struct
+%   with the fields
+%       ekf_config    as for MANDELA_EKF_MEX('new',...): model, tuning and
+%                     initial estimate of every filter
+%       max_reactors  reactor ids are 0..max_reactors-1
+%       input         named pipe (mkfifo) with one line per sample or command:
+%                         id t T_degC y_1 ... y_n_outputs  (y = nan: no measurement)
+%                         reset id   (drops the filter of reactor id)
+%                         end
+%       output        (optional) named pipe or file for the replies, one line
+%                     per processed sample:
+%                         id t status XZ' sqrt(diag(P))' latency_us
+%       n_threads     no. of threads (default 0: one per hardware thread)
+%       idle_timeout  stop when no data arrives for this long [sec]
+%                     (default 0: wait for 'end')
+%   A filter is created from ekf_config.X_init_ekf and P_EKF at the first
+%   sample of its reactor, and again after a reset or a failed step. Samples
+%   are queued as they arrive. All queued samples are processed as one batch,
+%   with the reactors of the batch in parallel (the samples of one reactor in
+%   order), and the replies are written as soon as the batch is done.
+%   Missing samples of a reactor are bridged by prediction-only steps, and
+%   samples that are not later than the estimate are dropped.
+%
+%   TIMING has one row per batch: [n_samples n_reactors process_us
+%   max_latency_us]. SUMMARY has the fields n_samples, n_dropped, n_failed,
+%   n_reactors (filters at the end), max_latency_us and timed_out.
+%
+%   See also MANDELA_EKF_MEX, MAKE_MANDELA_EKF.
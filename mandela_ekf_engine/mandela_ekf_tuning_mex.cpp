@@ -0,0 +1,110 @@
+/*
+ * MATLAB interface to the parallel Q/R/P0 tuning sweep of the native Mandela EKF
+ *
+ * [results,best] = mandela_ekf_tuning_mex(sweep)
+ *
+ * see mandela_ekf_tuning_mex.m for the fields of sweep and the columns of results,
+ * and make_mandela_ekf.m for the compile command
+ */
+
+#include "mex.h"
+#include "tuning_sweep.hpp"
+#include "mex_config_fields.hpp"
+
+#include <cstring>
+#include <vector>
+
+static const char *const config_err_id = "mandela_ekf_tuning:config";
+
+// Number of candidates of an n x n x N field (N = 1: the same matrix for all candidates)
+static size_t n_field_candidates(const mxArray *s, const char *name, size_t n)
+{
+    const mxArray *f = get_field(s, name, false, config_err_id);
+    if (!f) return 1;
+    const size_t n_el = mxGetNumberOfElements(f);
+    if (n_el == 0 || n_el % (n*n) != 0) {
+        mexErrMsgIdAndTxt(config_err_id, "Field '%s' must be a %d-by-%d-by-N array.", name, (int)n, (int)n);
+    }
+    return n_el/(n*n);
+}
+
+// Matrix of candidate c from the n x n x N field, or default_value if the field is missing
+static void get_candidate_matrix(const mxArray *s, const char *name, size_t n, size_t c,
+                                 const double *default_value, double *dest)
+{
+    const mxArray *f = mxGetField(s, 0, name);
+    const double *src = default_value;
+    if (f) src = mxGetPr(f) + ((mxGetNumberOfElements(f) == n*n) ? 0 : c*n*n);
+    std::memcpy(dest, src, n*n*sizeof(double));
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    const int n_diff = batch_reactor::n_diff, n_xz = batch_reactor::n_xz;
+    if (nrhs != 1 || !mxIsStruct(prhs[0]) || nlhs > 2) {
+        mexErrMsgIdAndTxt("mandela_ekf_tuning:usage", "Usage: [results,best] = mandela_ekf_tuning_mex(sweep)");
+    }
+    const mxArray *s = prhs[0];
+
+    const mxArray *ekf_s = mxGetField(s, 0, "ekf_config");
+    const mxArray *plant_s = mxGetField(s, 0, "plant_config");
+    if (!ekf_s || !mxIsStruct(ekf_s) || !plant_s || !mxIsStruct(plant_s)) {
+        mexErrMsgIdAndTxt(config_err_id, "Fields 'ekf_config' and 'plant_config' must be structs.");
+    }
+
+    tuning_sweep_config config;
+    batch_reactor_plant_config plant_config;
+    double X_init_truth[n_diff], P_init[n_xz*n_xz];
+    get_ekf_config(ekf_s, config.ekf, config.X_init_ekf, P_init, config_err_id);
+    get_plant_config(plant_s, plant_config, X_init_truth, config_err_id);
+    const int n_out = config.ekf.n_outputs;
+    const double tf = get_field_scalar(s, "tf", 0, true, config_err_id);
+    const uint32_t seed = (uint32_t)get_field_scalar(s, "seed", 0, false, config_err_id);
+    const bool enable_sensor_noise = get_field_scalar(s, "enable_sensor_noise", 1, false, config_err_id) != 0;
+    config.n_threads = (int)get_field_scalar(s, "n_threads", 0, false, config_err_id);
+    for (int i = 0; i < n_diff; i++) config.cost_weights[i] = 1.0;
+    if (mxGetField(s, 0, "cost_weights")) get_field_array(s, "cost_weights", n_diff, config.cost_weights, config_err_id);
+    double sensor_R[mandela_ekf_max_outputs*mandela_ekf_max_outputs];
+    std::memcpy(sensor_R, config.ekf.R, n_out*n_out*sizeof(double));
+    if (mxGetField(s, 0, "sensor_R")) get_field_array(s, "sensor_R", n_out*n_out, sensor_R, config_err_id);
+
+    // Candidates: every field is n x n x N or n x n (shared by all candidates)
+    const size_t n_Q = n_field_candidates(s, "Q", n_diff);
+    const size_t n_R = n_field_candidates(s, "R", n_out);
+    const size_t n_P = n_field_candidates(s, "P_EKF", n_xz);
+    size_t n_candidates = n_Q;
+    if (n_R > n_candidates) n_candidates = n_R;
+    if (n_P > n_candidates) n_candidates = n_P;
+    if ((n_Q != 1 && n_Q != n_candidates) || (n_R != 1 && n_R != n_candidates) || (n_P != 1 && n_P != n_candidates)) {
+        mexErrMsgIdAndTxt(config_err_id, "Fields 'Q', 'R' and 'P_EKF' must have the same no. of candidates (or one).");
+    }
+    std::vector<tuning_candidate> candidates(n_candidates);
+    for (size_t c = 0; c < n_candidates; c++) {
+        get_candidate_matrix(s, "Q", n_diff, c, config.ekf.Q, candidates[c].Q);
+        get_candidate_matrix(s, "R", n_out, c, config.ekf.R, candidates[c].R);
+        get_candidate_matrix(s, "P_EKF", n_xz, c, P_init, candidates[c].P_init);
+    }
+
+    // One truth trajectory, shared by all candidates
+    tuning_truth_trajectory truth;
+    int status = record_truth_trajectory(plant_config, X_init_truth, config.ekf, tf, sensor_R, enable_sensor_noise, seed, truth);
+    if (status != MANDELA_EKF_SUCCESS) {
+        mexErrMsgIdAndTxt("mandela_ekf_tuning:truth", "Truth simulation failed: %s", mandela_ekf_status_message(status));
+    }
+
+    std::vector<tuning_result> results(n_candidates);
+    const int best = run_tuning_sweep(config, truth, &candidates[0], (int)n_candidates, &results[0]);
+    if (best < 0) mexWarnMsgIdAndTxt("mandela_ekf_tuning:failed", "No candidate has completed the sweep.");
+
+    // [status n_samples cost aborted], one row per candidate
+    const size_t N = n_candidates;
+    plhs[0] = mxCreateDoubleMatrix(N, 4, mxREAL);
+    double *S = mxGetPr(plhs[0]);
+    for (size_t c = 0; c < N; c++) {
+        S[c] = results[c].status;
+        S[c + N] = results[c].n_samples;
+        S[c + 2*N] = results[c].cost;
+        S[c + 3*N] = results[c].aborted ? 1 : 0;
+    }
+    if (nlhs >= 2) plhs[1] = mxCreateDoubleScalar(best >= 0 ? best + 1 : mxGetNaN());
+}
@@ -0,0 +1,35 @@
+%MANDELA_EKF_TUNING_MEX Parallel Q/R/P0 tuning sweep of the native Mandela EKF.
+%   [RESULTS,BEST] = MANDELA_EKF_TUNING_MEX(SWEEP) simulates the truth plant
+%   (BATCH_REACTOR_PLANT_MEX) once and runs the EKF (MANDELA_EKF_MEX) with
+%   every candidate (Q, R, P_EKF) against the recorded truth trajectory and
+%   measurements, on a pool of threads. SWEEP is a struct with the fields
+%       ekf_config      as for MANDELA_EKF_MEX('new',...); its Q, R and P_EKF
+%                       are used for the fields below that are missing
+%       plant_config    as for BATCH_REACTOR_PLANT_MEX('new',...) (same Ts and t0)
+%       tf              simulation end time [sec]
+%       Q               n_diff-by-n_diff-by-N candidate process noise covariances
+%       R               n_outputs-by-n_outputs-by-N measurement noise covariances
+%       P_EKF           (n_diff+n_alg)-by-(n_diff+n_alg)-by-N initial covariances
+%                       (a field with a single matrix is shared by all candidates)
+%       cost_weights    weights of the squared errors of the differential
+%                       states (n_diff-by-1, default ones)
+%       sensor_R        covariance of the sensor noise of the recorded
+%                       measurements (default ekf_config.R)
+%       enable_sensor_noise  0 or 1 (default 1)
+%       seed            seed of the sensor noise (default 0)
+%       n_threads       no. of threads (default 0: one per hardware thread)
+%
+%   The cost of a candidate is the sum over the samples of the weighted
+%   squared estimation errors of the differential states after the
+%   measurement updates. A candidate is aborted as soon as its running cost
+%   exceeds the best cost of the candidates already finished, so only the
+%   cost of the best candidate (and of those that have finished) is complete.
+%
+%   RESULTS has one row per candidate and the columns
+%       [status n_samples cost aborted]
+%   where status is 0 if the EKF has not failed (negative: see
+%   mandela_ekf.hpp), n_samples the no. of EKF steps done and aborted 1 for
+%   an aborted candidate. BEST is the index of the best candidate (NaN if
+%   none has finished).
+%
+%   See also MANDELA_EKF_MEX, BATCH_REACTOR_PLANT_MEX, MAKE_MANDELA_EKF.
@@ -0,0 +1,22 @@
+// Common interface of the native state estimators of the batch reactor (mandela_ekf, mandela_ukf,
+// mandela_mhe), so that the mex interface and the simulation drivers can use any of them
+
+#ifndef MANDELA_ESTIMATOR_HPP
+#define MANDELA_ESTIMATOR_HPP
+
+class mandela_estimator {
+public:
+    virtual ~mandela_estimator() {}
+
+    // One predict/update cycle over [t, t + Ts]; measured_outputs may be null (prediction only).
+    // T_degC is the input at t + Ts. Returns a mandela_ekf_status code.
+    virtual int step(const double *measured_outputs, double T_degC) = 0;
+
+    virtual const double *XZ() const = 0;  // estimate of the augmented state [X; Z]
+    virtual const double *P() const = 0;   // its (n_diff+n_alg) x (n_diff+n_alg) covariance
+    virtual double t() const = 0;
+    virtual double Ts() const = 0;  // sampling interval
+    virtual int n_outputs() const = 0;
+};
+
+#endif
@@ -0,0 +1,409 @@
+// Moving-horizon estimator for the batch reactor DAE (see mandela_mhe.hpp)
+
+#include "mandela_mhe.hpp"
+#include "small_dense.hpp"
+
+#include <cmath>
+
+using namespace batch_reactor;
+using namespace small_dense;
+
+// Pre-array of one node of the QR sweep: the rows [carried factor of X_k; measurements of node k;
+// process noise of interval k] and the columns [X_k X_{k+1} rhs]
+static const int pre_rows = 2*batch_reactor::n_diff + mandela_ekf_max_outputs;
+static const int pre_cols = 2*batch_reactor::n_diff + 1;
+
+mandela_mhe_options mandela_mhe_default_options()
+{
+    mandela_mhe_options options;
+    options.horizon = 10;
+    options.max_iterations = 2;
+    return options;
+}
+
+// W = inv(chol(A)), lower triangular, for a symmetric positive definite A (N x N): W*A*W' = I,
+// i.e. W whitens a residual with covariance A. Returns 0, or the return value of cholesky().
+template <int N>
+static int inverse_cholesky_factor(const double *A, double *W)
+{
+    double L[N*N];
+    copy<N, N>(A, L);
+    const int info = cholesky<N>(L);
+    if (info != 0) return info;
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < N; i++) {
+            double w = (i == j) ? 1.0 : 0.0;
+            for (int k = j; k < i; k++) w -= L[i + k*N]*W[k + j*N];
+            W[i + j*N] = (i < j) ? 0.0 : w/L[i + i*N];
+        }
+    }
+    return 0;
+}
+
+// b = R\b for an upper triangular R (N x N) with a non-zero diagonal
+template <int N>
+static void solve_upper(const double *R, double *b)
+{
+    for (int j = N - 1; j >= 0; j--) {
+        b[j] /= R[j + j*N];
+        for (int i = 0; i < j; i++) b[i] -= R[i + j*N]*b[j];
+    }
+}
+
+mandela_mhe::mandela_mhe()
+    : initialised_(false), t_(0.0), first_(0), n_nodes_(0),
+      n_iterations_(0), n_integrations_(0), n_reused_integrations_(0)
+{
+}
+
+int mandela_mhe::init(const mandela_ekf_config &config, const mandela_mhe_options &options,
+                      const double *X_init, const double *P_init)
+{
+    if (initialised_) return MANDELA_EKF_INVALID_CONFIG;
+    if (!(config.Ts > 0) || config.n_outputs < 1 || config.n_outputs > n_y ||
+        config.temperature_profile.empty() ||
+        (config.process_noise_model != MANDELA_EKF_CONTINUOUS_Q && config.process_noise_model != MANDELA_EKF_DISCRETE_Q) ||
+        options.horizon < 1 || options.max_iterations < 1) {
+        return MANDELA_EKF_INVALID_CONFIG;
+    }
+    for (int i = 0; i < config.n_outputs; i++) {
+        if (config.output_index[i] < 0 || config.output_index[i] >= n_xz) return MANDELA_EKF_INVALID_CONFIG;
+    }
+
+    config_ = config;
+    options_ = options;
+    t_ = config_.t0;
+    ida_data_.model_params = config_.model_params;
+    ida_data_.rates.reset(config_.model_params);
+    ida_data_.temperature_profile = &config_.temperature_profile;
+    ida_data_.noise_Ts = 0.0;  // the model of the estimator is noise-free
+    ida_data_.process_noise = NULL;
+
+    // Weights of the residuals: R (padded with unit variances, whose rows stay zero) and Qd
+    const int n_out = config_.n_outputs;
+    double R[n_y*n_y], Qd[n_diff*n_diff], P_xx[n_diff*n_diff];
+    identity<n_y>(R);
+    for (int j = 0; j < n_out; j++) {
+        for (int i = 0; i < n_out; i++) R[i + j*n_y] = config_.R[i + j*n_out];
+    }
+    const double scale = (config_.process_noise_model == MANDELA_EKF_CONTINUOUS_Q) ? config_.Ts : 1.0;
+    for (int i = 0; i < n_diff*n_diff; i++) Qd[i] = scale*config_.Q[i];
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_diff; i++) P_xx[i + j*n_diff] = P_init[i + j*n_xz];
+    }
+    if (inverse_cholesky_factor<n_y>(R, W_R_) != 0 || inverse_cholesky_factor<n_diff>(Qd, W_Q_) != 0 ||
+        inverse_cholesky_factor<n_diff>(P_xx, arrival_A_) != 0) {
+        return MANDELA_EKF_INVALID_CONFIG;
+    }
+    copy<n_diff, 1>(X_init, arrival_X_);
+
+    const node empty_node = node();
+    nodes_.assign(options_.horizon + 1, empty_node);
+    dX_.assign(n_diff*(options_.horizon + 1), 0.0);
+    first_ = 0;
+    n_nodes_ = 1;
+
+    // The first node, with algebraic variables consistent with the initial differential states (Z_init_guess = 0)
+    node &nd = at(0);
+    nd.t = t_;
+    for (int i = 0; i < n_diff; i++) nd.XZ[i] = X_init[i];
+    for (int i = 0; i < n_alg; i++) nd.XZ[n_diff + i] = 0.0;
+    nd.measured = false;
+    nd.integrated = false;
+    int status = project(nd);
+    if (status != MANDELA_EKF_SUCCESS) return status;
+
+    double id[n_xz];
+    for (int i = 0; i < n_xz; i++) id[i] = (i < n_diff) ? 1.0 : 0.0;
+    status = start_interval(nd);
+    if (status != MANDELA_EKF_SUCCESS) return status;
+    int flag = integrator_.create(n_xz, XZ_ida_, XZp_ida_, id, t_,
+                                  batch_reactor_ida_residual, batch_reactor_ida_jacobian, &ida_data_,
+                                  config_.rel_tol, config_.abs_tol, config_.max_num_steps);
+    if (flag == IDA_SUCCESS) flag = integrator_.init_sensitivities(n_diff, sens_, sens_p_, batch_reactor_ida_sens_residual);
+    if (flag != IDA_SUCCESS) return MANDELA_EKF_INTEGRATOR_FAILURE;
+
+    // P = Gamma*P_xx*Gamma'
+    double Gamma[n_xz*n_diff], P_xx_packed[n_diff*(n_diff + 1)/2], P_packed[n_xz*(n_xz + 1)/2];
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_diff; i++) Gamma[i + j*n_xz] = (i == j) ? 1.0 : 0.0;
+        for (int i = 0; i < n_alg; i++) Gamma[n_diff + i + j*n_xz] = nd.Gamma_bottom[i + j*n_alg];
+    }
+    sym_pack<n_diff>(P_xx, P_xx_packed);
+    sym_congruence<n_xz, n_diff>(Gamma, P_xx_packed, P_packed);
+    sym_unpack<n_xz>(P_packed, P_);
+    copy<n_xz, 1>(nd.XZ, XZ_);
+
+    initialised_ = true;
+    return MANDELA_EKF_SUCCESS;
+}
+
+// Z of a node from the algebraic equations (starting from its current Z) and Gamma_bottom = -inv(gz)*gx there
+int mandela_mhe::project(node &nd)
+{
+    double gx[n_alg*n_diff], gz[n_alg*n_alg];
+    int piv[n_alg];
+
+    if (solve_algebraic_equations(nd.XZ, config_.model_params) != 0) return MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE;
+    algebraic_jacobian(nd.XZ, config_.model_params, gx, gz);
+    if (lu_factor<n_alg>(gz, piv) != 0) return MANDELA_EKF_SINGULAR_MATRIX;
+    for (int i = 0; i < n_alg*n_diff; i++) nd.Gamma_bottom[i] = -gx[i];
+    lu_solve<n_alg, n_diff>(gz, piv, nd.Gamma_bottom);
+    return MANDELA_EKF_SUCCESS;
+}
+
+// Initial values of an interval that starts at node nd: XZ, consistent derivatives (dX/dt from the
+// state equations, dZ/dt = Gamma_bottom*dX/dt) and the sensitivities S = dXZ/dX = [I; Gamma_bottom]
+// with dS/dt = [A_x; Gamma_bottom*A_x], A_x = fx + fz*Gamma_bottom
+int mandela_mhe::start_interval(const node &nd)
+{
+    double fx[n_diff*n_diff], fz[n_diff*n_alg], gx[n_alg*n_diff], gz[n_alg*n_alg];
+    double A_x[n_diff*n_diff], Gb_A_x[n_alg*n_diff];
+    const double *Gb = nd.Gamma_bottom;
+
+    const rate_coeffs &k = ida_data_.rates.get(config_.temperature_profile.eval(nd.t));
+    copy<n_xz, 1>(nd.XZ, XZ_ida_);
+    rhs_state_eqn(XZ_ida_, k, NULL, XZp_ida_);
+    mat_mul<n_alg, n_diff, 1>(Gb, XZp_ida_, XZp_ida_ + n_diff);
+
+    linearisation(XZ_ida_, config_.model_params, k, fx, fz, gx, gz);
+    mat_mul<n_diff, n_alg, n_diff>(fz, Gb, A_x);
+    for (int i = 0; i < n_diff*n_diff; i++) A_x[i] += fx[i];
+    mat_mul<n_alg, n_diff, n_diff>(Gb, A_x, Gb_A_x);
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_diff; i++) {
+            sens_[i + j*n_xz] = (i == j) ? 1.0 : 0.0;
+            sens_p_[i + j*n_xz] = A_x[i + j*n_diff];
+        }
+        for (int i = 0; i < n_alg; i++) {
+            sens_[n_diff + i + j*n_xz] = Gb[i + j*n_alg];
+            sens_p_[n_diff + i + j*n_xz] = Gb_A_x[i + j*n_alg];
+        }
+    }
+    return MANDELA_EKF_SUCCESS;
+}
+
+// F(X_k) and phi_k = dF/dX_k of the interval [t_k, t_k + Ts] that starts at node nd. IDA restarts
+// with the step size of its previous integration (its own estimate is far too small). XZ_ida_
+// holds the full XZ(t_k + Ts) afterwards.
+int mandela_mhe::integrate_interval(node &nd)
+{
+    int status = start_interval(nd);
+    if (status != MANDELA_EKF_SUCCESS) return status;
+    double h_init = integrator_.last_step();
+    if (h_init > config_.Ts) h_init = config_.Ts;
+    if (integrator_.reinit(nd.t, h_init) != IDA_SUCCESS) return MANDELA_EKF_INTEGRATOR_FAILURE;
+    if (integrator_.advance(nd.t + config_.Ts) != IDA_SUCCESS) return MANDELA_EKF_INTEGRATOR_FAILURE;
+    n_integrations_++;
+
+    copy<n_diff, 1>(nd.XZ, nd.X_lin);
+    copy<n_diff, 1>(XZ_ida_, nd.F);
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_diff; i++) nd.phi[i + j*n_diff] = sens_[i + j*n_xz];
+    }
+    nd.integrated = true;
+    return MANDELA_EKF_SUCCESS;
+}
+
+// Structured QR of the linearised window. Node k contributes the pre-array
+//   [ Rt_k          0      | zt_k          ]   carried factor of X_k (the arrival cost at k = 0)
+//   [ W_R*C_k       0      | W_R*e_k       ]   measurements, C_k = H*Gamma_k, e_k = y_k - h(X_k)
+//   [ -W_Q*phi_k    W_Q    | W_Q*d_k       ]   process noise, d_k = F(X_k) - X_{k+1}
+// in the increments [dX_k dX_{k+1}], whose triangularisation gives the rows [R_kk R_next | b] of dX_k
+// and the factor [Rt_{k+1} | zt_{k+1}] carried to the next node. F(X_k) is F(X_lin) + phi_k*(X_k - X_lin)
+// for an interval that has not been re-integrated. The factor of X_1 is the arrival cost after the
+// window has moved on.
+int mandela_mhe::factorise()
+{
+    const int n_out = config_.n_outputs;
+    double A[pre_rows*pre_cols], Rt[n_diff*n_diff], zt[n_diff];
+    double C[n_y*n_diff], e[n_y], W_C[n_y*n_diff], W_e[n_y];
+    double W_phi[n_diff*n_diff], d[n_diff], W_d[n_diff];
+    double *rhs = A + (pre_cols - 1)*pre_rows;
+
+    copy<n_diff, n_diff>(arrival_A_, Rt);
+    for (int i = 0; i < n_diff; i++) d[i] = arrival_X_[i] - at(0).XZ[i];
+    mat_mul<n_diff, n_diff, 1>(arrival_A_, d, zt);
+
+    for (int k = 0; k < n_nodes_; k++) {
+        node &nd = at(k);
+        for (int i = 0; i < pre_rows*pre_cols; i++) A[i] = 0.0;
+        for (int j = 0; j < n_diff; j++) {
+            for (int i = 0; i < n_diff; i++) A[i + j*pre_rows] = Rt[i + j*n_diff];
+            rhs[j] = zt[j];
+        }
+
+        if (nd.measured) {
+            for (int i = 0; i < n_y*n_diff; i++) C[i] = 0.0;
+            for (int i = 0; i < n_y; i++) e[i] = 0.0;
+            for (int i = 0; i < n_out; i++) {
+                const int m = config_.output_index[i];
+                for (int j = 0; j < n_diff; j++) {
+                    C[i + j*n_y] = (m < n_diff) ? ((m == j) ? 1.0 : 0.0) : nd.Gamma_bottom[m - n_diff + j*n_alg];
+                }
+                e[i] = nd.y[i] - nd.XZ[m];
+            }
+            mat_mul<n_y, n_y, n_diff>(W_R_, C, W_C);
+            mat_mul<n_y, n_y, 1>(W_R_, e, W_e);
+            for (int i = 0; i < n_y; i++) {
+                for (int j = 0; j < n_diff; j++) A[n_diff + i + j*pre_rows] = W_C[i + j*n_y];
+                rhs[n_diff + i] = W_e[i];
+            }
+        }
+
+        if (k < n_nodes_ - 1) {
+            const node &next = at(k + 1);
+            double dX_lin[n_diff];
+            for (int i = 0; i < n_diff; i++) dX_lin[i] = nd.XZ[i] - nd.X_lin[i];
+            mat_mul<n_diff, n_diff, 1>(nd.phi, dX_lin, d);
+            for (int i = 0; i < n_diff; i++) d[i] += nd.F[i] - next.XZ[i];
+            mat_mul<n_diff, n_diff, n_diff>(W_Q_, nd.phi, W_phi);
+            mat_mul<n_diff, n_diff, 1>(W_Q_, d, W_d);
+            const int r0 = n_diff + n_y;
+            for (int i = 0; i < n_diff; i++) {
+                for (int j = 0; j < n_diff; j++) {
+                    A[r0 + i + j*pre_rows] = -W_phi[i + j*n_diff];
+                    A[r0 + i + (n_diff + j)*pre_rows] = W_Q_[i + j*n_diff];
+                }
+                rhs[r0 + i] = W_d[i];
+            }
+        }
+
+        qr_triangularise<pre_rows, pre_cols>(A);
+        for (int j = 0; j < n_diff; j++) {
+            if (A[j + j*pre_rows] == 0.0) return MANDELA_EKF_SINGULAR_MATRIX;
+            for (int i = 0; i < n_diff; i++) {
+                nd.R_kk[i + j*n_diff] = A[i + j*pre_rows];
+                nd.R_next[i + j*n_diff] = A[i + (n_diff + j)*pre_rows];
+                Rt[i + j*n_diff] = A[n_diff + i + (n_diff + j)*pre_rows];
+            }
+            nd.b[j] = rhs[j];
+            zt[j] = rhs[n_diff + j];
+        }
+
+        if (k == 0 && n_nodes_ > 1) {
+            // ||Rt*(X_1 - X_1,lin) - zt||^2 = ||Rt*(X_1 - Xbar_1)||^2 with Xbar_1 = X_1,lin + Rt\zt
+            for (int j = 0; j < n_diff; j++) {
+                if (Rt[j + j*n_diff] == 0.0) return MANDELA_EKF_SINGULAR_MATRIX;
+            }
+            copy<n_diff, n_diff>(Rt, next_arrival_A_);
+            copy<n_diff, 1>(zt, next_arrival_X_);
+            solve_upper<n_diff>(Rt, next_arrival_X_);
+            for (int i = 0; i < n_diff; i++) next_arrival_X_[i] += at(1).XZ[i];
+        }
+    }
+    return MANDELA_EKF_SUCCESS;
+}
+
+// One Gauss-Newton iteration over the window: linearisation of the intervals whose start node has
+// left the IDA tolerances of their last integration, QR sweep, block back-substitution
+// dX_k = R_kk\(b_k - R_next*dX_{k+1}), and the update of the nodes. converged is set if every
+// component of the step is within the IDA tolerances.
+int mandela_mhe::gauss_newton_step(bool &converged)
+{
+    for (int k = 0; k < n_nodes_ - 1; k++) {
+        node &nd = at(k);
+        bool reuse = nd.integrated;
+        for (int i = 0; i < n_diff && reuse; i++) {
+            reuse = std::fabs(nd.XZ[i] - nd.X_lin[i]) <= config_.rel_tol*std::fabs(nd.X_lin[i]) + config_.abs_tol;
+        }
+        if (reuse) {
+            n_reused_integrations_++;
+            continue;
+        }
+        const int status = integrate_interval(nd);
+        if (status != MANDELA_EKF_SUCCESS) return status;
+    }
+
+    int status = factorise();
+    if (status != MANDELA_EKF_SUCCESS) return status;
+    n_iterations_++;
+
+    converged = true;
+    for (int k = n_nodes_ - 1; k >= 0; k--) {
+        node &nd = at(k);
+        double *dX = &dX_[k*n_diff];
+        copy<n_diff, 1>(nd.b, dX);
+        if (k < n_nodes_ - 1) {
+            double R_dX[n_diff];
+            mat_mul<n_diff, n_diff, 1>(nd.R_next, &dX_[(k + 1)*n_diff], R_dX);
+            for (int i = 0; i < n_diff; i++) dX[i] -= R_dX[i];
+        }
+        solve_upper<n_diff>(nd.R_kk, dX);
+        for (int i = 0; i < n_diff; i++) {
+            if (std::fabs(dX[i]) > config_.rel_tol*std::fabs(nd.XZ[i]) + config_.abs_tol) converged = false;
+        }
+    }
+    for (int k = 0; k < n_nodes_; k++) {
+        node &nd = at(k);
+        for (int i = 0; i < n_diff; i++) nd.XZ[i] += dX_[k*n_diff + i];
+        status = project(nd);
+        if (status != MANDELA_EKF_SUCCESS) return status;
+    }
+    return MANDELA_EKF_SUCCESS;
+}
+
+// P = Gamma_N*inv(R_N)*inv(R_N)'*Gamma_N' at the newest node, where R_N = R_kk of that node is the
+// triangular factor of the information of X_N given the whole window
+void mandela_mhe::update_covariance()
+{
+    const node &nd = at(n_nodes_ - 1);
+    double R_inv[n_diff*n_diff], Gamma[n_xz*n_diff];
+    double P_xx_packed[n_diff*(n_diff + 1)/2], P_packed[n_xz*(n_xz + 1)/2];
+
+    identity<n_diff>(R_inv);
+    for (int j = 0; j < n_diff; j++) solve_upper<n_diff>(nd.R_kk, R_inv + j*n_diff);
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i <= j; i++) {
+            double p = 0.0;
+            for (int l = j; l < n_diff; l++) p += R_inv[i + l*n_diff]*R_inv[j + l*n_diff];
+            P_xx_packed[i + j*(j + 1)/2] = p;
+        }
+        for (int i = 0; i < n_diff; i++) Gamma[i + j*n_xz] = (i == j) ? 1.0 : 0.0;
+        for (int i = 0; i < n_alg; i++) Gamma[n_diff + i + j*n_xz] = nd.Gamma_bottom[i + j*n_alg];
+    }
+    sym_congruence<n_xz, n_diff>(Gamma, P_xx_packed, P_packed);
+    sym_unpack<n_xz>(P_packed, P_);
+}
+
+int mandela_mhe::step(const double *measured_outputs, double T_degC)
+{
+    (void)T_degC;
+    if (!initialised_) return MANDELA_EKF_NOT_INITIALISED;
+
+    // Prediction of the new node from the newest one, whose interval is integrated here for the first time
+    node &newest = at(n_nodes_ - 1);
+    int status = integrate_interval(newest);
+    if (status != MANDELA_EKF_SUCCESS) return status;
+    const double t_new = newest.t + config_.Ts;
+
+    // A full window drops its oldest node, whose information moves into the arrival cost of the next
+    if (n_nodes_ == (int)nodes_.size()) {
+        copy<n_diff, n_diff>(next_arrival_A_, arrival_A_);
+        copy<n_diff, 1>(next_arrival_X_, arrival_X_);
+        first_ = (first_ + 1) % (int)nodes_.size();
+        n_nodes_--;
+    }
+    node &nd = at(n_nodes_);
+    n_nodes_++;
+    nd.t = t_new;
+    copy<n_xz, 1>(XZ_ida_, nd.XZ);
+    nd.integrated = false;
+    nd.measured = (measured_outputs != NULL);
+    for (int i = 0; i < n_y; i++) nd.y[i] = (nd.measured && i < config_.n_outputs) ? measured_outputs[i] : 0.0;
+    status = project(nd);
+    if (status != MANDELA_EKF_SUCCESS) return status;
+
+    // Gauss-Newton from the shifted previous solution
+    for (int it = 0; it < options_.max_iterations; it++) {
+        bool converged;
+        status = gauss_newton_step(converged);
+        if (status != MANDELA_EKF_SUCCESS) return status;
+        if (converged) break;
+    }
+
+    t_ = t_new;
+    copy<n_xz, 1>(nd.XZ, XZ_);
+    update_covariance();
+    return MANDELA_EKF_SUCCESS;
+}
@@ -0,0 +1,121 @@
+// Moving-horizon estimator for the batch chemical reactor DAE, an alternative to the Mandela EKF
+// (mandela_ekf.hpp) with the same configuration and interface. At every sample it solves the
+// nonlinear least-squares problem over the differential states X_0..X_N at the last N+1 samples
+//
+//   min ||A_0*(X_0 - Xbar_0)||^2 + sum_k ||W_R*(y_k - h(X_k,Z_k))||^2 + sum_k ||W_Q*(X_{k+1} - F(X_k))||^2
+//
+// (arrival cost, measurements, process noise), where F(X_k) is the integration of the model over
+// one sampling interval by IDAS and Z_k follows from X_k through the algebraic equations (multiple
+// shooting). Each Gauss-Newton iteration takes the Jacobians from the forward sensitivities of the
+// intervals (dF/dX_k) and from Gamma = [I; -inv(gz)*gx] (outputs), and solves the block-banded
+// linearised problem by a structured QR: one Householder triangularisation of a small pre-array per
+// node, as in a square-root information smoother, followed by a block back-substitution (O(N)).
+// When the window moves on, its oldest node is dropped and the arrival cost becomes the marginal
+// factor of X_1 from the last QR sweep; the window is warm-started with the previous solution
+// shifted by one sample and the prediction of the new node. Intervals whose start node has moved
+// by less than the IDA tolerances since their integration are not re-integrated, so that a settled
+// window costs little more than the integration of its newest intervals and the QR sweeps.
+// Process noise: Qd = Q*Ts (MANDELA_EKF_CONTINUOUS_Q) or Q (MANDELA_EKF_DISCRETE_Q) per sample,
+// which must be positive definite.
+
+#ifndef MANDELA_MHE_HPP
+#define MANDELA_MHE_HPP
+
+#include "batch_reactor_model.hpp"
+#include "batch_reactor_model_ida.hpp"
+#include "dae_integrator.hpp"
+#include "mandela_ekf.hpp"
+#include "mandela_estimator.hpp"
+
+#include <vector>
+
+struct mandela_mhe_options {
+    int horizon;         // N: no. of sampling intervals of the window (N+1 nodes)
+    int max_iterations;  // Gauss-Newton iterations per sample (fewer if the step is within the IDA tolerances)
+};
+
+mandela_mhe_options mandela_mhe_default_options();  // horizon = 10, max_iterations = 2
+
+class mandela_mhe : public mandela_estimator {
+public:
+    static const int n_diff = batch_reactor::n_diff;
+    static const int n_alg  = batch_reactor::n_alg;
+    static const int n_xz   = batch_reactor::n_xz;
+    static const int n_y    = mandela_ekf_max_outputs;
+
+    mandela_mhe();
+
+    // As mandela_ekf::init(); only the n_diff x n_diff block of P_init (X) is used, as the initial
+    // arrival cost. The window is allocated here: step() does not allocate.
+    int init(const mandela_ekf_config &config, const mandela_mhe_options &options,
+             const double *X_init, const double *P_init);
+
+    // One sample, see mandela_estimator: appends the node at t + Ts with its measurements (if any)
+    // and re-solves the window. T_degC is not used: the model is integrated with the temperature
+    // profile of the configuration.
+    int step(const double *measured_outputs, double T_degC);
+
+    // Estimate at the newest node and its covariance Gamma*inv(R_N'*R_N)*Gamma', with R_N the
+    // triangular factor of X_N from the last QR sweep
+    const double *XZ() const { return XZ_; }
+    const double *P() const { return P_; }
+    double t() const { return t_; }
+    double Ts() const { return config_.Ts; }
+    int n_outputs() const { return config_.n_outputs; }
+
+    long n_iterations() const { return n_iterations_; }            // Gauss-Newton iterations since init()
+    long n_integrations() const { return n_integrations_; }        // interval integrations since init()
+    long n_reused_integrations() const { return n_reused_integrations_; }  // skipped since the start node had not moved
+
+private:
+    mandela_mhe(const mandela_mhe &);
+    mandela_mhe &operator=(const mandela_mhe &);
+
+    // One node of the window and the linearisation of the interval that starts at it
+    struct node {
+        double t;
+        double XZ[n_xz];
+        double Gamma_bottom[n_alg*n_diff];  // at XZ
+        bool measured;
+        double y[n_y];
+        bool integrated;  // F and phi are those of X_lin
+        double X_lin[n_diff], F[n_diff], phi[n_diff*n_diff];
+        double R_kk[n_diff*n_diff], R_next[n_diff*n_diff], b[n_diff];  // rows of X_k of the last QR sweep
+    };
+
+    node &at(int k) { return nodes_[(first_ + k) % nodes_.size()]; }
+    const node &at(int k) const { return nodes_[(first_ + k) % nodes_.size()]; }
+
+    int project(node &nd);
+    int start_interval(const node &nd);
+    int integrate_interval(node &nd);
+    int gauss_newton_step(bool &converged);
+    int factorise();
+    void update_covariance();
+
+    mandela_ekf_config config_;
+    mandela_mhe_options options_;
+    bool initialised_;
+    double t_;
+
+    // arrival cost ||A_0*(X_0 - Xbar_0)||^2, and that of X_1 from the last QR sweep (used when X_0 is dropped)
+    double arrival_A_[n_diff*n_diff], arrival_X_[n_diff];
+    double next_arrival_A_[n_diff*n_diff], next_arrival_X_[n_diff];
+    double W_R_[n_y*n_y], W_Q_[n_diff*n_diff];  // inv(chol(R)) (padded to n_y outputs) and inv(chol(Qd))
+
+    std::vector<node> nodes_;  // ring buffer of options_.horizon + 1 nodes
+    int first_, n_nodes_;
+
+    batch_reactor_ida_data ida_data_;
+    dae_integrator integrator_;
+    double XZ_ida_[n_xz], XZp_ida_[n_xz];
+    double sens_[n_xz*n_diff], sens_p_[n_xz*n_diff];  // dXZ/dX of the interval being integrated
+
+    double XZ_[n_xz], P_[n_xz*n_xz];
+    long n_iterations_, n_integrations_, n_reused_integrations_;
+
+    // workspace
+    std::vector<double> dX_;  // Gauss-Newton step, n_diff per node
+};
+
+#endif
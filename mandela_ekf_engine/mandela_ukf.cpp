@@ -0,0 +1,282 @@
+// Unscented Kalman filter for the batch reactor DAE (see mandela_ukf.hpp)
+
+#include "mandela_ukf.hpp"
+#include "small_dense.hpp"
+
+#include <cmath>
+
+using namespace batch_reactor;
+using namespace small_dense;
+
+mandela_ukf_options mandela_ukf_default_options()
+{
+    mandela_ukf_options options;
+    options.alpha = 1e-3;
+    options.beta = 2.0;
+    options.kappa = 0.0;
+    options.n_threads = 0;
+    return options;
+}
+
+// dX/dt from the state equations and dZ/dt = -inv(gz)*gx*dX/dt
+static int consistent_derivatives(const double *XZ, const model_params &p, const rate_coeffs &k, double *XZp)
+{
+    const int n_diff = batch_reactor::n_diff, n_alg = batch_reactor::n_alg;
+    double fx[n_diff*n_diff], fz[n_diff*n_alg], gx[n_alg*n_diff], gz[n_alg*n_alg], Gamma_bottom[n_alg*n_diff];
+    int piv[n_alg];
+
+    rhs_state_eqn(XZ, k, NULL, XZp);
+    linearisation(XZ, p, k, fx, fz, gx, gz);
+    if (lu_factor<n_alg>(gz, piv) != 0) return MANDELA_EKF_SINGULAR_MATRIX;
+    for (int i = 0; i < n_alg*n_diff; i++) Gamma_bottom[i] = -gx[i];
+    lu_solve<n_alg, n_diff>(gz, piv, Gamma_bottom);
+    mat_mul<n_alg, n_diff, 1>(Gamma_bottom, XZp, XZp + n_diff);
+    return MANDELA_EKF_SUCCESS;
+}
+
+mandela_ukf::mandela_ukf()
+    : lambda_(0.0), initialised_(false), t_(0.0)
+{
+}
+
+int mandela_ukf::init(const mandela_ekf_config &config, const mandela_ukf_options &options,
+                      const double *X_init, const double *P_init)
+{
+    if (initialised_) return MANDELA_EKF_INVALID_CONFIG;
+    if (!(config.Ts > 0) || config.n_outputs < 1 || config.n_outputs > n_y ||
+        config.temperature_profile.empty() ||
+        (config.process_noise_model != MANDELA_EKF_CONTINUOUS_Q && config.process_noise_model != MANDELA_EKF_DISCRETE_Q)) {
+        return MANDELA_EKF_INVALID_CONFIG;
+    }
+    for (int i = 0; i < config.n_outputs; i++) {
+        if (config.output_index[i] < 0 || config.output_index[i] >= n_xz) return MANDELA_EKF_INVALID_CONFIG;
+    }
+    lambda_ = options.alpha*options.alpha*(n_diff + options.kappa) - n_diff;
+    if (!(options.alpha > 0) || !(n_diff + lambda_ > 0)) return MANDELA_EKF_INVALID_CONFIG;
+
+    config_ = config;
+    t_ = config_.t0;
+
+    // Weights of the scaled unscented transform
+    Wm_[0] = lambda_/(n_diff + lambda_);
+    Wc_[0] = Wm_[0] + 1.0 - options.alpha*options.alpha + options.beta;
+    for (int i = 1; i < n_sigma; i++) Wm_[i] = Wc_[i] = 0.5/(n_diff + lambda_);
+
+    // Q is added once per sample; for a continuous-time intensity this is the first-order term Q*Ts
+    const double Q_scale = (config_.process_noise_model == MANDELA_EKF_CONTINUOUS_Q) ? config_.Ts : 1.0;
+    for (int i = 0; i < n_diff*n_diff; i++) Qd_x_[i] = Q_scale*config_.Q[i];
+
+    const int n_out = config_.n_outputs;
+    identity<n_y>(R_);
+    for (int j = 0; j < n_out; j++) {
+        for (int i = 0; i < n_out; i++) R_[i + j*n_y] = config_.R[i + j*n_out];
+    }
+
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_diff; i++) P_x_[i + j*n_diff] = P_init[i + j*n_xz];
+    }
+
+    // Algebraic variables consistent with the initial differential states (Z_init_guess = 0)
+    for (int i = 0; i < n_diff; i++) XZ_[i] = X_init[i];
+    for (int i = 0; i < n_alg; i++) XZ_[n_diff + i] = 0.0;
+    if (solve_algebraic_equations(XZ_, config_.model_params) != 0) return MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE;
+
+    // One model and IDA instance per sigma point, all starting from the consistent initial estimate
+    double id[n_xz];
+    for (int i = 0; i < n_xz; i++) id[i] = (i < n_diff) ? 1.0 : 0.0;
+    for (int s = 0; s < n_sigma; s++) {
+        sigma_point_model &sp = sigma_[s];
+        sp.temperature_profile = config_.temperature_profile;
+        sp.ida_data.model_params = config_.model_params;
+        sp.ida_data.rates.reset(config_.model_params);
+        sp.ida_data.temperature_profile = &sp.temperature_profile;
+        sp.ida_data.noise_Ts = 0.0;  // the UKF model is noise-free
+        sp.ida_data.process_noise = NULL;
+        sp.status = MANDELA_EKF_SUCCESS;
+
+        copy<n_xz, 1>(XZ_, sp.XZ);
+        const int status = consistent_derivatives(sp.XZ, config_.model_params,
+                                                  sp.ida_data.rates.get(sp.temperature_profile.eval(t_)), sp.XZp);
+        if (status != MANDELA_EKF_SUCCESS) return status;
+        if (sp.integrator.create(n_xz, sp.XZ, sp.XZp, id, t_,
+                                 batch_reactor_ida_residual, batch_reactor_ida_jacobian, &sp.ida_data,
+                                 config_.rel_tol, config_.abs_tol, config_.max_num_steps) != IDA_SUCCESS) {
+            return MANDELA_EKF_INTEGRATOR_FAILURE;
+        }
+    }
+
+    int n_threads = options.n_threads;
+    if (n_threads <= 0) n_threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (n_threads > n_sigma) n_threads = n_sigma;
+    pool_.start(n_threads);
+
+    const int status = draw_sigma_points();
+    if (status != MANDELA_EKF_SUCCESS) return status;
+    if (project_sigma_points(XZ_sigma_) != MANDELA_EKF_SUCCESS) return MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE;
+    covariance_from_sigma_points(XZ_sigma_);
+
+    initialised_ = true;
+    return MANDELA_EKF_SUCCESS;
+}
+
+// X_sigma = [m, m + sqrt(n+lambda)*L, m - sqrt(n+lambda)*L] with P_x = L*L' and m = XZ_(1:n_diff)
+int mandela_ukf::draw_sigma_points()
+{
+    copy<n_diff, n_diff>(P_x_, L_);
+    if (cholesky<n_diff>(L_) != 0) return MANDELA_EKF_SINGULAR_MATRIX;
+
+    const double c = std::sqrt(n_diff + lambda_);
+    for (int i = 0; i < n_diff; i++) X_sigma_[i] = XZ_[i];
+    for (int j = 0; j < n_diff; j++) {
+        for (int i = 0; i < n_diff; i++) {
+            X_sigma_[i + (1 + j)*n_diff]          = XZ_[i] + c*L_[i + j*n_diff];
+            X_sigma_[i + (1 + n_diff + j)*n_diff] = XZ_[i] - c*L_[i + j*n_diff];
+        }
+    }
+    return MANDELA_EKF_SUCCESS;
+}
+
+// [X_sigma; Z] with Z solved from g(X,Z) = 0, starting from the algebraic variables of XZ_
+int mandela_ukf::project_sigma_points(double *XZ_sigma)
+{
+    for (int s = 0; s < n_sigma; s++) {
+        double *XZ = XZ_sigma + s*n_xz;
+        for (int i = 0; i < n_diff; i++) XZ[i] = X_sigma_[i + s*n_diff];
+        for (int i = 0; i < n_alg; i++) XZ[n_diff + i] = XZ_[n_diff + i];
+        if (solve_algebraic_equations(XZ, config_.model_params) != 0) return MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE;
+    }
+    return MANDELA_EKF_SUCCESS;
+}
+
+// P = sum(Wc_i*(XZ_i - mean)*(XZ_i - mean)') of the projected sigma points
+void mandela_ukf::covariance_from_sigma_points(const double *XZ_sigma)
+{
+    double mean[n_xz] = {0}, d[n_xz];
+    for (int s = 0; s < n_sigma; s++) {
+        for (int i = 0; i < n_xz; i++) mean[i] += Wm_[s]*XZ_sigma[i + s*n_xz];
+    }
+    for (int i = 0; i < n_xz*n_xz; i++) P_[i] = 0.0;
+    for (int s = 0; s < n_sigma; s++) {
+        for (int i = 0; i < n_xz; i++) d[i] = XZ_sigma[i + s*n_xz] - mean[i];
+        for (int j = 0; j < n_xz; j++) {
+            for (int i = 0; i < n_xz; i++) P_[i + j*n_xz] += Wc_[s]*d[i]*d[j];
+        }
+    }
+}
+
+// Integrates sigma point i over [t, t + Ts] from its projection onto g(X,Z) = 0
+void mandela_ukf::propagate(int i)
+{
+    sigma_point_model &sp = sigma_[i];
+    for (int j = 0; j < n_diff; j++) sp.XZ[j] = X_sigma_[j + i*n_diff];
+    for (int j = 0; j < n_alg; j++) sp.XZ[n_diff + j] = XZ_[n_diff + j];
+    if (solve_algebraic_equations(sp.XZ, config_.model_params) != 0) {
+        sp.status = MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE;
+        return;
+    }
+    sp.status = consistent_derivatives(sp.XZ, config_.model_params,
+                                       sp.ida_data.rates.get(sp.temperature_profile.eval(t_)), sp.XZp);
+    if (sp.status != MANDELA_EKF_SUCCESS) return;
+
+    double h_init = sp.integrator.last_step();
+    if (h_init > config_.Ts) h_init = config_.Ts;
+    if (sp.integrator.reinit(t_, h_init) != IDA_SUCCESS || sp.integrator.advance(t_ + config_.Ts) != IDA_SUCCESS) {
+        sp.status = MANDELA_EKF_INTEGRATOR_FAILURE;
+        return;
+    }
+    for (int j = 0; j < n_xz; j++) {
+        if (!std::isfinite(sp.XZ[j])) sp.status = MANDELA_EKF_INTEGRATOR_FAILURE;
+    }
+}
+
+void mandela_ukf::propagate_task(int i, void *context)
+{
+    static_cast<mandela_ukf *>(context)->propagate(i);
+}
+
+int mandela_ukf::step(const double *measured_outputs, double T_degC)
+{
+    (void)T_degC;
+    if (!initialised_) return MANDELA_EKF_NOT_INITIALISED;
+    const int n_out = config_.n_outputs;
+
+    // Prediction: integrate every sigma point of the last estimate, concurrently
+    int status = draw_sigma_points();
+    if (status != MANDELA_EKF_SUCCESS) return status;
+    pool_.run(n_sigma, propagate_task, this);
+    for (int s = 0; s < n_sigma; s++) {
+        if (sigma_[s].status != MANDELA_EKF_SUCCESS) return sigma_[s].status;
+    }
+    t_ += config_.Ts;
+
+    // m = sum(Wm_i*X_i), P_x = sum(Wc_i*(X_i - m)*(X_i - m)') + Qd
+    double d[n_diff];
+    for (int i = 0; i < n_diff; i++) XZ_[i] = 0.0;
+    for (int s = 0; s < n_sigma; s++) {
+        for (int i = 0; i < n_diff; i++) XZ_[i] += Wm_[s]*sigma_[s].XZ[i];
+    }
+    copy<n_diff, n_diff>(Qd_x_, P_x_);
+    for (int s = 0; s < n_sigma; s++) {
+        for (int i = 0; i < n_diff; i++) d[i] = sigma_[s].XZ[i] - XZ_[i];
+        for (int j = 0; j < n_diff; j++) {
+            for (int i = 0; i < n_diff; i++) P_x_[i + j*n_diff] += Wc_[s]*d[i]*d[j];
+        }
+    }
+    // Algebraic variables of the predicted mean: warm start for the projections below
+    for (int i = 0; i < n_alg; i++) XZ_[n_diff + i] = sigma_[0].XZ[n_diff + i];
+
+    if (measured_outputs) {
+        // Measurement update with sigma points redrawn from the prediction, since the outputs are
+        // algebraic variables: y_i = XZ_i(output_index)
+        status = draw_sigma_points();
+        if (status != MANDELA_EKF_SUCCESS) return status;
+        if (project_sigma_points(XZ_sigma_) != MANDELA_EKF_SUCCESS) return MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE;
+
+        double y_mean[n_y] = {0}, dy[n_y], P_yy[n_y*n_y], P_xy[n_diff*n_y], Kt[n_y*n_diff];
+        int piv[n_y];
+        for (int s = 0; s < n_sigma; s++) {
+            for (int i = 0; i < n_out; i++) y_mean[i] += Wm_[s]*XZ_sigma_[config_.output_index[i] + s*n_xz];
+        }
+        copy<n_y, n_y>(R_, P_yy);
+        for (int i = 0; i < n_diff*n_y; i++) P_xy[i] = 0.0;
+        for (int s = 0; s < n_sigma; s++) {
+            const double *XZ = XZ_sigma_ + s*n_xz;
+            for (int i = 0; i < n_y; i++) dy[i] = (i < n_out) ? XZ[config_.output_index[i]] - y_mean[i] : 0.0;
+            for (int i = 0; i < n_diff; i++) d[i] = XZ[i] - XZ_[i];
+            for (int j = 0; j < n_out; j++) {
+                for (int i = 0; i < n_out; i++) P_yy[i + j*n_y] += Wc_[s]*dy[i]*dy[j];
+                for (int i = 0; i < n_diff; i++) P_xy[i + j*n_diff] += Wc_[s]*d[i]*dy[j];
+            }
+        }
+
+        // K = P_xy/P_yy, computed as K' = P_yy\P_xy' since P_yy is symmetric
+        if (lu_factor<n_y>(P_yy, piv) != 0) return MANDELA_EKF_SINGULAR_MATRIX;
+        for (int j = 0; j < n_diff; j++) {
+            for (int i = 0; i < n_y; i++) Kt[i + j*n_y] = P_xy[j + i*n_diff];
+        }
+        lu_solve<n_y, n_diff>(P_yy, piv, Kt);
+
+        // m = m + K*innovation, P_x = P_x - K*P_yy*K' = P_x - K*P_xy'
+        double innovation[n_y];
+        for (int i = 0; i < n_out; i++) innovation[i] = measured_outputs[i] - y_mean[i];
+        for (int j = 0; j < n_out; j++) {
+            for (int i = 0; i < n_diff; i++) XZ_[i] += Kt[j + i*n_y]*innovation[j];
+        }
+        for (int j = 0; j < n_diff; j++) {
+            for (int i = 0; i < n_diff; i++) {
+                for (int k = 0; k < n_out; k++) P_x_[i + j*n_diff] -= Kt[k + i*n_y]*P_xy[j + k*n_diff];
+            }
+        }
+        for (int j = 0; j < n_diff; j++) {
+            for (int i = 0; i < j; i++) P_x_[i + j*n_diff] = P_x_[j + i*n_diff] = 0.5*(P_x_[i + j*n_diff] + P_x_[j + i*n_diff]);
+        }
+    }
+
+    // Estimate of Z consistent with the estimate of X, and the covariance of [X; Z]
+    if (solve_algebraic_equations(XZ_, config_.model_params) != 0) return MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE;
+    status = draw_sigma_points();
+    if (status != MANDELA_EKF_SUCCESS) return status;
+    if (project_sigma_points(XZ_sigma_) != MANDELA_EKF_SUCCESS) return MANDELA_EKF_ALGEBRAIC_SOLVE_FAILURE;
+    covariance_from_sigma_points(XZ_sigma_);
+    return MANDELA_EKF_SUCCESS;
+}
@@ -0,0 +1,92 @@
+// Unscented Kalman filter for the batch chemical reactor DAE, an alternative to the linearisation
+// of the Mandela EKF (mandela_ekf.hpp) with the same configuration and interface.
+// The sigma points are drawn for the differential states X only: the algebraic variables of every
+// sigma point are obtained from the algebraic equations (solve_algebraic_equations), so that each
+// point is consistent with g(X,Z) = 0, and the covariance of [X; Z] follows from the projected points.
+// The 2*n_diff+1 sigma points are integrated concurrently on a thread pool, each by its own
+// IDA instance (created once by init()).
+// Process noise: Q*Ts (MANDELA_EKF_CONTINUOUS_Q) or Q (MANDELA_EKF_DISCRETE_Q) is added to the
+// predicted covariance of X.
+
+#ifndef MANDELA_UKF_HPP
+#define MANDELA_UKF_HPP
+
+#include "batch_reactor_model.hpp"
+#include "batch_reactor_model_ida.hpp"
+#include "dae_integrator.hpp"
+#include "input_profile.hpp"
+#include "mandela_ekf.hpp"
+#include "mandela_estimator.hpp"
+#include "thread_pool.hpp"
+
+// Scaled unscented transform (Wan and van der Merwe, 2000): lambda = alpha^2*(n_diff + kappa) - n_diff.
+// A small alpha keeps the sigma points close to the mean; with alpha = 1 they reach far outside the
+// physically meaningful states whenever P is large compared with a state (e.g. x_5 with P_EKF = 0.004*I).
+struct mandela_ukf_options {
+    double alpha, beta, kappa;
+    int n_threads;  // threads used for the sigma points (<= 0: one per hardware thread)
+};
+
+mandela_ukf_options mandela_ukf_default_options();  // alpha = 1e-3, beta = 2, kappa = 0, n_threads = 0
+
+class mandela_ukf : public mandela_estimator {
+public:
+    static const int n_diff  = batch_reactor::n_diff;
+    static const int n_alg   = batch_reactor::n_alg;
+    static const int n_xz    = batch_reactor::n_xz;
+    static const int n_y     = mandela_ekf_max_outputs;
+    static const int n_sigma = 2*n_diff + 1;
+
+    mandela_ukf();
+
+    // As mandela_ekf::init(); only the n_diff x n_diff block of P_init (X) is used
+    int init(const mandela_ekf_config &config, const mandela_ukf_options &options,
+             const double *X_init, const double *P_init);
+
+    // One predict/update cycle, see mandela_estimator. T_degC is not used: the sigma points are
+    // integrated with the temperature profile of the configuration.
+    int step(const double *measured_outputs, double T_degC);
+
+    const double *XZ() const { return XZ_; }
+    const double *P() const { return P_; }
+    double t() const { return t_; }
+    double Ts() const { return config_.Ts; }
+    int n_outputs() const { return config_.n_outputs; }
+
+private:
+    mandela_ukf(const mandela_ukf &);
+    mandela_ukf &operator=(const mandela_ukf &);
+
+    // One sigma point and the model that integrates it
+    struct sigma_point_model {
+        double XZ[n_xz], XZp[n_xz];
+        input_profile temperature_profile;  // own copy, since the profile caches its last segment
+        batch_reactor_ida_data ida_data;
+        dae_integrator integrator;
+        int status;
+    };
+
+    int draw_sigma_points();
+    int project_sigma_points(double *XZ_sigma);
+    void covariance_from_sigma_points(const double *XZ_sigma);
+    void propagate(int i);
+    static void propagate_task(int i, void *context);
+
+    mandela_ekf_config config_;
+    double lambda_, Wm_[n_sigma], Wc_[n_sigma];
+    double Qd_x_[n_diff*n_diff];
+    double R_[n_y*n_y];  // padded to n_y outputs
+    bool initialised_;
+    double t_;
+
+    double XZ_[n_xz], P_[n_xz*n_xz];
+    double P_x_[n_diff*n_diff];  // covariance of X
+
+    sigma_point_model sigma_[n_sigma];
+    thread_pool pool_;
+
+    // workspace
+    double X_sigma_[n_diff*n_sigma], XZ_sigma_[n_xz*n_sigma], L_[n_diff*n_diff];
+};
+
+#endif
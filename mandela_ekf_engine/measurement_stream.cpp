@@ -0,0 +1,131 @@
+// Streaming (real-time) estimation from a named pipe (see measurement_stream.hpp).
+// POSIX only: on Windows run_estimation_stream() returns MANDELA_EKF_INVALID_CONFIG.
+
+#include "measurement_stream.hpp"
+#include "mandela_ekf.hpp"
+
+#ifndef _WIN32
+
+#include "checkpoint_file.hpp"
+#include "line_reader.hpp"
+
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+
+int run_estimation_stream(mandela_estimator &estimator, const stream_config &config,
+                          std::vector<stream_step_timing> &timing, stream_summary &summary)
+{
+    const int n_xz = batch_reactor::n_xz;
+    const int n_out = estimator.n_outputs();
+    const double Ts = estimator.Ts();
+
+    summary.n_samples = 0;
+    summary.n_dropped = 0;
+    summary.n_deadline_misses = 0;
+    summary.max_latency_us = 0.0;
+    summary.timed_out = false;
+    summary.n_checkpoints = 0;
+
+    mandela_ekf *ekf = dynamic_cast<mandela_ekf *>(&estimator);  // irregular samples, checkpoints
+    if (config.checkpoint_path && (!ekf || config.checkpoint_interval < 1)) return MANDELA_EKF_INVALID_CONFIG;
+
+    const int fd_in = open(config.input_path, O_RDONLY);
+    if (fd_in < 0) return MANDELA_EKF_INVALID_CONFIG;
+    int fd_out = -1;
+    if (config.output_path) {
+        fd_out = open(config.output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_out < 0) {
+            close(fd_in);
+            return MANDELA_EKF_INVALID_CONFIG;
+        }
+    }
+    // A reader that goes away must not kill the process (SIGPIPE); the writes just fail
+    void (*old_sigpipe)(int) = std::signal(SIGPIPE, SIG_IGN);
+
+    const int timeout_ms = (config.idle_timeout_s > 0) ? (int)std::ceil(1000*config.idle_timeout_s) : 0;
+    const double deadline_us = 1e6*config.deadline_s;
+    line_reader reader(fd_in);
+    checkpoint_writer *checkpoints = config.checkpoint_path ? new checkpoint_writer(config.checkpoint_path) : NULL;
+    mandela_ekf_snapshot snapshot;
+    int status = MANDELA_EKF_SUCCESS;
+    char *line;
+    stream_clock::time_point arrival;
+    char out[2048];
+    int r = 1;
+
+    while (status == MANDELA_EKF_SUCCESS && (r = reader.next(&line, &arrival, timeout_ms)) == 1) {
+        if (std::strncmp(line, "end", 3) == 0) break;
+
+        double t, T_degC, y[mandela_ekf_max_outputs];
+        bool measured;
+        const double t_min = estimator.t() + (ekf ? 1e-9 : 0.5)*Ts;
+        if (!parse_sample(line, n_out, &t, &T_degC, y, &measured) || !(t > t_min)) {
+            summary.n_dropped++;
+            continue;
+        }
+
+        // Prediction over the missing samples (at the temperature of this one), then this sample
+        const stream_clock::time_point step_start = stream_clock::now();
+        while (status == MANDELA_EKF_SUCCESS && estimator.t() + 1.5*Ts < t) status = estimator.step(NULL, T_degC);
+        if (status == MANDELA_EKF_SUCCESS) {
+            status = ekf ? ekf->step_to(t, measured ? y : NULL, T_degC) : estimator.step(measured ? y : NULL, T_degC);
+        }
+        const stream_clock::time_point step_end = stream_clock::now();
+
+        const double *XZ = estimator.XZ(), *P = estimator.P();
+        int len = std::snprintf(out, sizeof(out), "%.6f %d", estimator.t(), status);
+        for (int i = 0; i < n_xz; i++) len += std::snprintf(out + len, sizeof(out) - len, " %.10g", XZ[i]);
+        for (int i = 0; i < n_xz; i++) len += std::snprintf(out + len, sizeof(out) - len, " %.6g", std::sqrt(P[i + i*n_xz]));
+        const double latency_us = microseconds(arrival, stream_clock::now());
+        len += std::snprintf(out + len, sizeof(out) - len, " %.1f\n", latency_us);
+        if (fd_out >= 0 && !write_all(fd_out, out, len)) {
+            close(fd_out);  // the reader has gone: keep estimating, without publishing
+            fd_out = -1;
+        }
+
+        stream_step_timing st;
+        st.t = t;
+        st.status = status;
+        st.latency_us = latency_us;
+        st.step_us = microseconds(step_start, step_end);
+        timing.push_back(st);
+        summary.n_samples++;
+        if (latency_us > deadline_us) summary.n_deadline_misses++;
+        if (latency_us > summary.max_latency_us) summary.max_latency_us = latency_us;
+
+        if (checkpoints && status == MANDELA_EKF_SUCCESS && summary.n_samples % config.checkpoint_interval == 0) {
+            ekf->save(snapshot);
+            checkpoints->submit(snapshot);
+        }
+    }
+    if (status == MANDELA_EKF_SUCCESS && r == -2) summary.timed_out = true;
+    if (checkpoints) {
+        const int checkpoint_status = checkpoints->flush();
+        summary.n_checkpoints = checkpoints->n_written();
+        delete checkpoints;
+        if (status == MANDELA_EKF_SUCCESS) status = checkpoint_status;
+    }
+
+    std::signal(SIGPIPE, old_sigpipe);
+    if (fd_out >= 0) close(fd_out);
+    close(fd_in);
+    return status;
+}
+
+#else
+
+int run_estimation_stream(mandela_estimator &, const stream_config &,
+                          std::vector<stream_step_timing> &, stream_summary &summary)
+{
+    summary.n_samples = summary.n_dropped = summary.n_deadline_misses = 0;
+    summary.max_latency_us = 0.0;
+    summary.timed_out = false;
+    summary.n_checkpoints = 0;
+    return MANDELA_EKF_INVALID_CONFIG;
+}
+
+#endif
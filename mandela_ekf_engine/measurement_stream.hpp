@@ -0,0 +1,61 @@
+// Streaming (real-time) estimation: the estimator is driven by timestamped samples read from a
+// named pipe (or any file that can be read sequentially), and every estimate is published on an
+// output pipe or file as soon as the sample has been processed.
+//
+// Input: one text line per sample
+//     t T_degC y_1 ... y_n_outputs
+// where t is the time of the sample [sec], T_degC the temperature at t and y_i the measurements
+// (nan: no measurement at t, only the prediction is done). With the Mandela EKF, the samples may
+// come at any time (mandela_ekf::step_to); other estimators need them at t0 + k*Ts. Gaps of more
+// than 1.5*Ts are bridged by prediction-only steps of Ts, and samples that are not later than the
+// current estimate are dropped. A line "end" or the end of the input stops the stream.
+// Output: one line per sample
+//     t status XZ_1 ... XZ_n_xz sqrt(P_11) ... sqrt(P_n_xz,n_xz) latency_us
+// where latency_us is the time from the arrival of the sample to the output of its estimate.
+// Each sample is processed with a fixed amount of work and without allocation (except for the
+// timing log), so that the latency stays bounded.
+// With a checkpoint file (Mandela EKF only), the state of the filter is saved after every
+// checkpoint_interval samples, after the estimate has been published; the file is written by a
+// background thread (checkpoint_file.hpp), so the step loop only copies the snapshot.
+
+#ifndef MEASUREMENT_STREAM_HPP
+#define MEASUREMENT_STREAM_HPP
+
+#include "mandela_estimator.hpp"
+
+#include <vector>
+
+struct stream_config {
+    const char *input_path;   // named pipe with the samples (opened for reading, blocks until a writer connects)
+    const char *output_path;  // named pipe or file for the estimates (null: none)
+    double deadline_s;        // latency budget per sample: the samples above it are counted as misses
+    double idle_timeout_s;    // stop when no data arrives for this long (<= 0: wait for the end of the input)
+    const char *checkpoint_path;  // checkpoint file (null: none)
+    int checkpoint_interval;      // samples between checkpoints
+};
+
+struct stream_step_timing {
+    double t;           // time of the sample
+    int status;         // mandela_ekf_status of the estimator step
+    double latency_us;  // arrival of the sample -> estimate published
+    double step_us;     // estimator step(s) alone
+};
+
+struct stream_summary {
+    int n_samples;          // samples processed
+    int n_dropped;          // malformed samples or samples not later than the estimate
+    int n_deadline_misses;
+    double max_latency_us;
+    bool timed_out;         // stopped by idle_timeout_s
+    long n_checkpoints;     // checkpoints written
+};
+
+// Runs the stream until "end", the end of the input, the idle timeout or a failed step, and appends
+// the timing of every processed sample to timing. Returns the mandela_ekf_status of the last step,
+// MANDELA_EKF_INVALID_CONFIG if a stream could not be opened (or a checkpoint file is given for an
+// estimator other than mandela_ekf), or MANDELA_EKF_CHECKPOINT_FAILURE if the last checkpoint could
+// not be written.
+int run_estimation_stream(mandela_estimator &estimator, const stream_config &config,
+                          std::vector<stream_step_timing> &timing, stream_summary &summary);
+
+#endif
@@ -0,0 +1,245 @@
+// Reading of configuration structs passed to the mex-files of the engine.
+// Errors are raised with mexErrMsgIdAndTxt and the identifier err_id.
+
+#ifndef MEX_CONFIG_FIELDS_HPP
+#define MEX_CONFIG_FIELDS_HPP
+
+#include "mex.h"
+#include "batch_reactor_model.hpp"
+#include "batch_reactor_plant.hpp"
+#include "input_profile.hpp"
+#include "mandela_ekf.hpp"
+#include "mandela_mhe.hpp"
+#include "mandela_ukf.hpp"
+
+#include <cstring>
+
+inline const mxArray *get_field(const mxArray *s, const char *name, bool required, const char *err_id)
+{
+    const mxArray *f = mxGetField(s, 0, name);
+    if (!f && required) mexErrMsgIdAndTxt(err_id, "Field '%s' is missing from the configuration struct.", name);
+    if (f && (!mxIsDouble(f) || mxIsComplex(f) || mxIsSparse(f))) {
+        mexErrMsgIdAndTxt(err_id, "Field '%s' must be a real, full double array.", name);
+    }
+    return f;
+}
+
+inline void get_field_array(const mxArray *s, const char *name, size_t n_expected, double *dest, const char *err_id)
+{
+    const mxArray *f = get_field(s, name, true, err_id);
+    if (mxGetNumberOfElements(f) != n_expected) {
+        mexErrMsgIdAndTxt(err_id, "Field '%s' must have %d elements.", name, (int)n_expected);
+    }
+    std::memcpy(dest, mxGetPr(f), n_expected*sizeof(double));
+}
+
+inline double get_field_scalar(const mxArray *s, const char *name, double default_value, bool required, const char *err_id)
+{
+    const mxArray *f = get_field(s, name, required, err_id);
+    if (!f) return default_value;
+    if (mxGetNumberOfElements(f) != 1) mexErrMsgIdAndTxt(err_id, "Field '%s' must be a scalar.", name);
+    return mxGetScalar(f);
+}
+
+// Fields of model_params as in the MATLAB scripts
+inline void get_model_param_fields(const mxArray *mp, batch_reactor::model_params &p, const char *err_id)
+{
+    p.alpha_1    = get_field_scalar(mp, "alpha_1", 0, true, err_id);
+    p.E1_over_R  = get_field_scalar(mp, "E1_over_R", 0, true, err_id);
+    p.alpha_m1   = get_field_scalar(mp, "alpha_m1", 0, true, err_id);
+    p.Em1_over_R = get_field_scalar(mp, "Em1_over_R", 0, true, err_id);
+    p.alpha_2    = get_field_scalar(mp, "alpha_2", 0, true, err_id);
+    p.E2_over_R  = get_field_scalar(mp, "E2_over_R", 0, true, err_id);
+    p.K1         = get_field_scalar(mp, "K1", 0, true, err_id);
+    p.K2         = get_field_scalar(mp, "K2", 0, true, err_id);
+    p.K3         = get_field_scalar(mp, "K3", 0, true, err_id);
+    p.Q_plus     = get_field_scalar(mp, "Q_plus", 0, true, err_id);
+}
+
+inline void get_model_params(const mxArray *s, batch_reactor::model_params &p, const char *err_id)
+{
+    const mxArray *mp = mxGetField(s, 0, "model_params");
+    if (!mp || !mxIsStruct(mp)) mexErrMsgIdAndTxt(err_id, "Field 'model_params' must be a struct.");
+    get_model_param_fields(mp, p, err_id);
+}
+
+// Fields time_profile (sec) and Temp_profile (degC), or profile_file: the name of a csv file with
+// time (hours) and temperature (degC) columns, as input_temperature_profile_vs_time/temperature_vs_time_profile.csv
+inline void get_temperature_profile(const mxArray *s, input_profile &profile, const char *err_id)
+{
+    const mxArray *pf = mxGetField(s, 0, "profile_file");
+    if (pf) {
+        char *file_name = mxIsChar(pf) ? mxArrayToString(pf) : NULL;
+        if (!file_name) mexErrMsgIdAndTxt(err_id, "Field 'profile_file' must be a file name.");
+        const bool loaded = profile.load_csv(file_name, 3600.0);
+        mxFree(file_name);
+        if (!loaded) mexErrMsgIdAndTxt(err_id, "Could not read an increasing time/temperature profile from 'profile_file'.");
+        return;
+    }
+
+    const mxArray *tp = get_field(s, "time_profile", true, err_id);
+    const mxArray *Tp = get_field(s, "Temp_profile", true, err_id);
+    if (mxGetNumberOfElements(tp) != mxGetNumberOfElements(Tp) ||
+        !profile.assign(mxGetPr(tp), mxGetPr(Tp), (int)mxGetNumberOfElements(tp))) {
+        mexErrMsgIdAndTxt(err_id, "time_profile must be increasing and of the same length as Temp_profile.");
+    }
+}
+
+// Fields of ekf_config (see mandela_ekf_mex.m); X_init: n_diff, P_init: n_xz x n_xz
+inline void get_ekf_config(const mxArray *s, mandela_ekf_config &config, double *X_init, double *P_init, const char *err_id)
+{
+    get_model_params(s, config.model_params, err_id);
+
+    config.Ts = get_field_scalar(s, "Ts", 0, true, err_id);
+    config.t0 = get_field_scalar(s, "t0", 0, false, err_id);
+    config.rel_tol = get_field_scalar(s, "RelTol", 1e-6, false, err_id);
+    config.abs_tol = get_field_scalar(s, "AbsTol", 1e-6, false, err_id);
+    config.max_num_steps = (long)get_field_scalar(s, "MaxNumSteps", 1500, false, err_id);
+    get_field_array(s, "Q", batch_reactor::n_diff*batch_reactor::n_diff, config.Q, err_id);
+    config.relinearisation_rel_tol = get_field_scalar(s, "RelinRelTol", 0, false, err_id);
+    config.relinearisation_abs_tol = get_field_scalar(s, "RelinAbsTol", 0, false, err_id);
+    config.relinearisation_input_tol = get_field_scalar(s, "RelinInputTol", 0, false, err_id);
+    if (!(config.relinearisation_rel_tol >= 0) || !(config.relinearisation_abs_tol >= 0) ||
+        !(config.relinearisation_input_tol >= 0)) {
+        mexErrMsgIdAndTxt(err_id, "RelinRelTol, RelinAbsTol and RelinInputTol must be non-negative.");
+    }
+
+    config.process_noise_model = MANDELA_EKF_CONTINUOUS_Q;
+    const mxArray *pn = mxGetField(s, 0, "ProcessNoise");
+    if (pn) {
+        char pn_str[16];
+        if (!mxIsChar(pn) || mxGetString(pn, pn_str, sizeof(pn_str)) != 0) {
+            mexErrMsgIdAndTxt(err_id, "Field 'ProcessNoise' must be 'continuous' or 'discrete'.");
+        }
+        if (std::strcmp(pn_str, "discrete") == 0) config.process_noise_model = MANDELA_EKF_DISCRETE_Q;
+        else if (std::strcmp(pn_str, "continuous") != 0) {
+            mexErrMsgIdAndTxt(err_id, "Field 'ProcessNoise' must be 'continuous' or 'discrete'.");
+        }
+    }
+
+    config.covariance_model = MANDELA_EKF_FULL_COVARIANCE;
+    const mxArray *cm = mxGetField(s, 0, "Covariance");
+    if (cm) {
+        char cm_str[16];
+        if (!mxIsChar(cm) || mxGetString(cm, cm_str, sizeof(cm_str)) != 0) {
+            mexErrMsgIdAndTxt(err_id, "Field 'Covariance' must be 'full' or 'reduced'.");
+        }
+        if (std::strcmp(cm_str, "reduced") == 0) config.covariance_model = MANDELA_EKF_REDUCED_COVARIANCE;
+        else if (std::strcmp(cm_str, "full") != 0) {
+            mexErrMsgIdAndTxt(err_id, "Field 'Covariance' must be 'full' or 'reduced'.");
+        }
+    }
+
+    config.measurement_update = MANDELA_EKF_SIMULTANEOUS_UPDATE;
+    const mxArray *mu = mxGetField(s, 0, "MeasurementUpdate");
+    if (mu) {
+        char mu_str[16];
+        if (!mxIsChar(mu) || mxGetString(mu, mu_str, sizeof(mu_str)) != 0) {
+            mexErrMsgIdAndTxt(err_id, "Field 'MeasurementUpdate' must be 'simultaneous' or 'sequential'.");
+        }
+        if (std::strcmp(mu_str, "sequential") == 0) config.measurement_update = MANDELA_EKF_SEQUENTIAL_UPDATE;
+        else if (std::strcmp(mu_str, "simultaneous") != 0) {
+            mexErrMsgIdAndTxt(err_id, "Field 'MeasurementUpdate' must be 'simultaneous' or 'sequential'.");
+        }
+    }
+
+    config.transition_model = MANDELA_EKF_EXPM_TRANSITION;
+    const mxArray *tm = mxGetField(s, 0, "Transition");
+    if (tm) {
+        char tm_str[16];
+        if (!mxIsChar(tm) || mxGetString(tm, tm_str, sizeof(tm_str)) != 0) {
+            mexErrMsgIdAndTxt(err_id, "Field 'Transition' must be 'expm' or 'sensitivity'.");
+        }
+        if (std::strcmp(tm_str, "sensitivity") == 0) config.transition_model = MANDELA_EKF_SENSITIVITY_TRANSITION;
+        else if (std::strcmp(tm_str, "expm") != 0) {
+            mexErrMsgIdAndTxt(err_id, "Field 'Transition' must be 'expm' or 'sensitivity'.");
+        }
+    }
+
+    const mxArray *oi = get_field(s, "output_index", true, err_id);
+    const size_t n_out = mxGetNumberOfElements(oi);
+    if (n_out < 1 || n_out > (size_t)mandela_ekf::n_y) {
+        mexErrMsgIdAndTxt(err_id, "Between 1 and %d outputs are supported.", mandela_ekf::n_y);
+    }
+    config.n_outputs = (int)n_out;
+    for (size_t i = 0; i < n_out; i++) config.output_index[i] = (int)mxGetPr(oi)[i] - 1;  // MATLAB indices are 1-based
+    get_field_array(s, "R", n_out*n_out, config.R, err_id);
+    get_temperature_profile(s, config.temperature_profile, err_id);
+
+    get_field_array(s, "X_init_ekf", batch_reactor::n_diff, X_init, err_id);
+    get_field_array(s, "P_EKF", batch_reactor::n_xz*batch_reactor::n_xz, P_init, err_id);
+}
+
+// Estimator selected by the Filter field of ekf_config
+enum mex_filter_type {
+    MEX_FILTER_EKF = 0,
+    MEX_FILTER_UKF = 1,
+    MEX_FILTER_MHE = 2
+};
+
+// Filter and the optional UKF and MHE fields of ekf_config (see mandela_ekf_mex.m); returns a mex_filter_type
+inline int get_filter_options(const mxArray *s, mandela_ukf_options &ukf_options, mandela_mhe_options &mhe_options,
+                              const char *err_id)
+{
+    int filter = MEX_FILTER_EKF;
+    const mxArray *f = mxGetField(s, 0, "Filter");
+    if (f) {
+        char f_str[8];
+        if (!mxIsChar(f) || mxGetString(f, f_str, sizeof(f_str)) != 0) {
+            mexErrMsgIdAndTxt(err_id, "Field 'Filter' must be 'ekf', 'ukf' or 'mhe'.");
+        }
+        if (std::strcmp(f_str, "ukf") == 0) filter = MEX_FILTER_UKF;
+        else if (std::strcmp(f_str, "mhe") == 0) filter = MEX_FILTER_MHE;
+        else if (std::strcmp(f_str, "ekf") != 0) {
+            mexErrMsgIdAndTxt(err_id, "Field 'Filter' must be 'ekf', 'ukf' or 'mhe'.");
+        }
+    }
+
+    ukf_options = mandela_ukf_default_options();
+    ukf_options.alpha = get_field_scalar(s, "UKFAlpha", ukf_options.alpha, false, err_id);
+    ukf_options.beta = get_field_scalar(s, "UKFBeta", ukf_options.beta, false, err_id);
+    ukf_options.kappa = get_field_scalar(s, "UKFKappa", ukf_options.kappa, false, err_id);
+    ukf_options.n_threads = (int)get_field_scalar(s, "NumThreads", ukf_options.n_threads, false, err_id);
+
+    mhe_options = mandela_mhe_default_options();
+    mhe_options.horizon = (int)get_field_scalar(s, "MHEHorizon", mhe_options.horizon, false, err_id);
+    mhe_options.max_iterations = (int)get_field_scalar(s, "MHEIterations", mhe_options.max_iterations, false, err_id);
+    return filter;
+}
+
+// Fields of plant_config (see batch_reactor_plant_mex.m); X_init: n_diff
+inline void get_plant_config(const mxArray *s, batch_reactor_plant_config &config, double *X_init, const char *err_id)
+{
+    get_model_params(s, config.model_params, err_id);
+    config.Ts = get_field_scalar(s, "Ts", 0, true, err_id);
+    config.t0 = get_field_scalar(s, "t0", 0, false, err_id);
+    config.enable_process_noise = get_field_scalar(s, "enable_process_noise", 1, false, err_id) != 0;
+
+    config.process_noise = BATCH_REACTOR_PSEUDO_WHITE_NOISE;
+    const mxArray *pn = mxGetField(s, 0, "ProcessNoise");
+    if (pn) {
+        char pn_str[24];
+        if (!mxIsChar(pn) || mxGetString(pn, pn_str, sizeof(pn_str)) != 0) {
+            mexErrMsgIdAndTxt(err_id, "Field 'ProcessNoise' must be 'pseudo_white' or 'piecewise_constant'.");
+        }
+        if (std::strcmp(pn_str, "piecewise_constant") == 0) config.process_noise = BATCH_REACTOR_PIECEWISE_CONSTANT_NOISE;
+        else if (std::strcmp(pn_str, "pseudo_white") != 0) {
+            mexErrMsgIdAndTxt(err_id, "Field 'ProcessNoise' must be 'pseudo_white' or 'piecewise_constant'.");
+        }
+    }
+    for (int i = 0; i < batch_reactor::n_diff*batch_reactor::n_diff; i++) config.noise_Q[i] = 0.0;
+    if (config.process_noise == BATCH_REACTOR_PIECEWISE_CONSTANT_NOISE) {
+        get_field_array(s, "Q", batch_reactor::n_diff*batch_reactor::n_diff, config.noise_Q, err_id);
+    }
+    config.noise_bin_width = get_field_scalar(s, "NoiseBinWidth", 0, false, err_id);
+    config.noise_seed = (uint32_t)get_field_scalar(s, "noise_seed", 0, false, err_id);
+    config.noise_stream = (uint32_t)get_field_scalar(s, "noise_stream", 0, false, err_id);
+    config.rel_tol = get_field_scalar(s, "RelTol", 1e-6, false, err_id);
+    config.abs_tol = get_field_scalar(s, "AbsTol", 1e-6, false, err_id);
+    config.max_num_steps = (long)get_field_scalar(s, "MaxNumSteps", 1500, false, err_id);
+    get_temperature_profile(s, config.temperature_profile, err_id);
+
+    get_field_array(s, "X_init", batch_reactor_plant::n_diff, X_init, err_id);
+}
+
+#endif
@@ -0,0 +1,55 @@
+// Table of the C++ objects owned by a mex-file. MATLAB refers to an object by its handle,
+// i.e. its (1-based) position in the table. Deleted slots are re-used.
+
+#ifndef MEX_INSTANCE_TABLE_HPP
+#define MEX_INSTANCE_TABLE_HPP
+
+#include "mex.h"
+
+#include <vector>
+
+template <class T>
+class mex_instance_table {
+public:
+    // Takes ownership of obj and returns its handle
+    mxArray *add(T *obj)
+    {
+        size_t idx = 0;
+        while (idx < instances_.size() && instances_[idx]) idx++;
+        if (idx == instances_.size()) instances_.push_back(obj); else instances_[idx] = obj;
+        return mxCreateDoubleScalar((double)(idx + 1));
+    }
+
+    T *get(const mxArray *h, const char *err_id) const
+    {
+        return instances_[index(h, err_id)];
+    }
+
+    void remove(const mxArray *h, const char *err_id)
+    {
+        const size_t idx = index(h, err_id);
+        delete instances_[idx];
+        instances_[idx] = NULL;
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < instances_.size(); i++) delete instances_[i];
+        instances_.clear();
+    }
+
+private:
+    size_t index(const mxArray *h, const char *err_id) const
+    {
+        if (!mxIsDouble(h) || mxGetNumberOfElements(h) != 1) mexErrMsgIdAndTxt(err_id, "Invalid handle.");
+        const double idx = mxGetScalar(h);
+        if (idx < 1 || idx > (double)instances_.size() || idx != (double)(size_t)idx || !instances_[(size_t)idx - 1]) {
+            mexErrMsgIdAndTxt(err_id, "Invalid or deleted handle.");
+        }
+        return (size_t)idx - 1;
+    }
+
+    std::vector<T *> instances_;
+};
+
+#endif
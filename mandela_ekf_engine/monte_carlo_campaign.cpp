@@ -0,0 +1,263 @@
+// Monte Carlo campaign of the Mandela EKF (see monte_carlo_campaign.hpp)
+
+#include "monte_carlo_campaign.hpp"
+#include "counter_rng.hpp"
+#include "small_dense.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace batch_reactor;
+using namespace small_dense;
+
+// Purposes of the random numbers of a run (see counter_rng::normal_stream)
+enum monte_carlo_rng_purpose {
+    RNG_INITIAL_MISMATCH = 0,
+    RNG_SENSOR_NOISE     = 1,
+    RNG_PROCESS_NOISE    = process_noise_rng_purpose  // drawn by the plant (piecewise-constant noise)
+};
+
+static const int n_y = mandela_ekf::n_y;
+
+// Estimation errors of the differential states of one run, after every measurement update
+struct run_statistics {
+    double sum_sq[n_diff], sum_nees, max_nees;
+    int n_samples;
+
+    run_statistics() : sum_nees(0.0), max_nees(0.0), n_samples(0)
+    {
+        for (int i = 0; i < n_diff; i++) sum_sq[i] = 0.0;
+    }
+
+    void add(const double *XZ_est, const double *P_est, const double *XZ_true)
+    {
+        // Normalised estimation error squared of the differential states
+        double e[n_diff], P_xx[n_diff*n_diff], Pinv_e[n_diff];
+        int piv[n_diff];
+        for (int i = 0; i < n_diff; i++) {
+            e[i] = XZ_est[i] - XZ_true[i];
+            Pinv_e[i] = e[i];
+            sum_sq[i] += e[i]*e[i];
+            for (int j = 0; j < n_diff; j++) P_xx[i + j*n_diff] = P_est[i + j*n_xz];
+        }
+        double nees = std::numeric_limits<double>::quiet_NaN();
+        if (lu_factor<n_diff>(P_xx, piv) == 0) {
+            lu_solve<n_diff, 1>(P_xx, piv, Pinv_e);
+            nees = 0.0;
+            for (int i = 0; i < n_diff; i++) nees += e[i]*Pinv_e[i];
+        }
+        sum_nees += nees;
+        if (!(nees <= max_nees)) max_nees = nees;  // propagates a NaN
+        n_samples++;
+    }
+
+    void finish(int status, monte_carlo_run_summary &summary) const
+    {
+        const double n = n_samples;
+        summary.status = status;
+        summary.n_samples = n_samples;
+        for (int i = 0; i < n_diff; i++) summary.rmse[i] = (n > 0) ? std::sqrt(sum_sq[i]/n) : std::numeric_limits<double>::quiet_NaN();
+        summary.mean_nees = (n > 0) ? sum_nees/n : std::numeric_limits<double>::quiet_NaN();
+        summary.max_nees = (n > 0) ? max_nees : std::numeric_limits<double>::quiet_NaN();
+    }
+};
+
+// Initial estimate of run (nominal + random mismatch)
+static void initial_estimate(const monte_carlo_config &config, const counter_rng::normal_stream &rng, double *X_init_ekf)
+{
+    double w[n_diff];
+    rng.draw(RNG_INITIAL_MISMATCH, 0, n_diff, w);
+    for (int i = 0; i < n_diff; i++) X_init_ekf[i] = config.X_init_ekf[i] + config.X_init_ekf_std[i]*w[i];
+}
+
+// Plant of run: its piecewise-constant process noise comes from the stream of the run
+static batch_reactor_plant_config plant_config(const monte_carlo_config &config, int run)
+{
+    batch_reactor_plant_config plant = config.plant;
+    plant.noise_seed = config.seed;
+    plant.noise_stream = (uint32_t)run;
+    return plant;
+}
+
+// Measurements of sample k: outputs of the plant + chol(R)'*randn
+static void measure(const monte_carlo_config &config, const double *chol_R, const counter_rng::normal_stream &rng,
+                    int k, const double *XZ_true, double *y)
+{
+    const int n_out = config.ekf.n_outputs;
+    double v[n_y];
+    for (int i = 0; i < n_out; i++) y[i] = XZ_true[config.ekf.output_index[i]];
+    if (config.enable_sensor_noise) {
+        rng.draw(RNG_SENSOR_NOISE, (uint32_t)k, n_out, v);
+        for (int i = 0; i < n_out; i++) {
+            for (int j = 0; j <= i; j++) y[i] += chol_R[i + j*n_y]*v[j];
+        }
+    }
+}
+
+static void run_one(const monte_carlo_config &config, const double *chol_R, int run, monte_carlo_run_summary &summary)
+{
+    const counter_rng::normal_stream rng(config.seed, (uint32_t)run);
+    const input_profile temperature_profile = config.ekf.temperature_profile;  // caches its last segment
+    run_statistics stats;
+    summary.run = run;
+
+    double X_init_ekf[n_diff];
+    initial_estimate(config, rng, X_init_ekf);
+
+    batch_reactor_plant plant;
+    mandela_ekf ekf;
+    int status = plant.init(plant_config(config, run), config.X_init_truth);
+    if (status == MANDELA_EKF_SUCCESS) status = ekf.init(config.ekf, X_init_ekf, config.P_init);
+
+    int k = 1;
+    for (double t = config.ekf.t0 + config.ekf.Ts; status == MANDELA_EKF_SUCCESS && t < config.tf; t += config.ekf.Ts, k++) {
+        status = plant.advance(t);
+        if (status != MANDELA_EKF_SUCCESS) break;
+
+        double y[n_y];
+        measure(config, chol_R, rng, k, plant.XZ(), y);
+        status = ekf.step(y, temperature_profile.eval(t));
+        if (status != MANDELA_EKF_SUCCESS) break;
+        stats.add(ekf.XZ(), ekf.P(), plant.XZ());
+    }
+    stats.finish(status, summary);
+}
+
+// Runs first_run..first_run+n_runs-1 with one mandela_ekf_batch. A run whose plant has failed
+// stays in its lane with zero innovations until the block is done.
+static void run_block(const monte_carlo_config &config, const double *chol_R, int first_run, int n_runs,
+                      monte_carlo_run_summary *summaries)
+{
+    const int lanes = mandela_ekf_lanes;
+    const int n_out = config.ekf.n_outputs;
+    const input_profile temperature_profile = config.ekf.temperature_profile;
+    std::vector<counter_rng::normal_stream> rng;
+    run_statistics stats[lanes];
+    int status[lanes];
+    double X_init_ekf[n_diff*lanes];
+
+    batch_reactor_plant plants[lanes];
+    mandela_ekf_batch *ekf = new mandela_ekf_batch();
+    int n_running = 0;
+    for (int r = 0; r < n_runs; r++) {
+        summaries[first_run + r].run = first_run + r;
+        rng.push_back(counter_rng::normal_stream(config.seed, (uint32_t)(first_run + r)));
+        initial_estimate(config, rng[r], X_init_ekf + r*n_diff);
+        status[r] = plants[r].init(plant_config(config, first_run + r), config.X_init_truth);
+        n_running += (status[r] == MANDELA_EKF_SUCCESS);
+    }
+    const int init_status = ekf->init(config.ekf, n_runs, X_init_ekf, config.P_init);
+    if (init_status != MANDELA_EKF_SUCCESS) {
+        for (int r = 0; r < n_runs; r++) {
+            if (status[r] == MANDELA_EKF_SUCCESS) status[r] = init_status;
+        }
+        n_running = 0;
+    }
+
+    int k = 1;
+    for (double t = config.ekf.t0 + config.ekf.Ts; n_running > 0 && t < config.tf; t += config.ekf.Ts, k++) {
+        double y[n_y*lanes], T_degC[lanes];
+        for (int r = 0; r < n_runs; r++) {
+            T_degC[r] = temperature_profile.eval(t);
+            if (status[r] == MANDELA_EKF_SUCCESS) status[r] = plants[r].advance(t);
+            if (status[r] == MANDELA_EKF_SUCCESS) {
+                measure(config, chol_R, rng[r], k, plants[r].XZ(), y + r*n_out);
+            } else {
+                for (int i = 0; i < n_out; i++) y[i + r*n_out] = ekf->XZ(r)[config.ekf.output_index[i]];
+            }
+        }
+        ekf->step(y, T_degC);
+
+        n_running = 0;
+        for (int r = 0; r < n_runs; r++) {
+            if (status[r] != MANDELA_EKF_SUCCESS) continue;
+            status[r] = ekf->status(r);
+            if (status[r] != MANDELA_EKF_SUCCESS) continue;
+            double P[n_xz*n_xz];
+            ekf->P(r, P);
+            stats[r].add(ekf->XZ(r), P, plants[r].XZ());
+            n_running++;
+        }
+    }
+    delete ekf;
+    for (int r = 0; r < n_runs; r++) stats[r].finish(status[r], summaries[first_run + r]);
+}
+
+void monte_carlo_write_header(std::FILE *out)
+{
+    std::fprintf(out, "run,status,n_samples");
+    for (int i = 0; i < n_diff; i++) std::fprintf(out, ",rmse_x%d", i);
+    std::fprintf(out, ",mean_nees,max_nees\n");
+    std::fflush(out);
+}
+
+static void write_summary(std::FILE *out, const monte_carlo_run_summary &s)
+{
+    std::fprintf(out, "%d,%d,%d", s.run + 1, s.status, s.n_samples);
+    for (int i = 0; i < n_diff; i++) std::fprintf(out, ",%.10g", s.rmse[i]);
+    std::fprintf(out, ",%.10g,%.10g\n", s.mean_nees, s.max_nees);
+    std::fflush(out);
+}
+
+int run_monte_carlo_campaign(const monte_carlo_config &config, std::FILE *out, monte_carlo_run_summary *summaries)
+{
+    if (config.n_runs < 1 || config.ekf.n_outputs < 1 || config.ekf.n_outputs > n_y ||
+        config.ekf.Ts != config.plant.Ts || config.ekf.t0 != config.plant.t0) {
+        return MANDELA_EKF_INVALID_CONFIG;
+    }
+    for (int i = 0; i < config.ekf.n_outputs; i++) {
+        if (config.ekf.output_index[i] < 0 || config.ekf.output_index[i] >= n_xz) return MANDELA_EKF_INVALID_CONFIG;
+    }
+
+    // Sensor noise chol(R)'*randn, with R padded to n_y x n_y
+    double chol_R[n_y*n_y];
+    const int n_out = config.ekf.n_outputs;
+    identity<n_y>(chol_R);
+    for (int j = 0; j < n_out; j++) {
+        for (int i = 0; i < n_out; i++) chol_R[i + j*n_y] = config.ekf.R[i + j*n_out];
+    }
+    if (config.enable_sensor_noise && cholesky<n_y>(chol_R) != 0) return MANDELA_EKF_INVALID_CONFIG;
+
+    int n_threads = config.n_threads;
+    if (n_threads <= 0) n_threads = (int)std::thread::hardware_concurrency();
+    if (n_threads <= 0) n_threads = 1;
+
+    // A task is one run, or a block of mandela_ekf_lanes runs in batched mode (if the batch
+    // implements the options of the EKF; otherwise the runs are done one by one)
+    const bool batched = config.batched && mandela_ekf_batch::supports(config.ekf);
+    const int runs_per_task = batched ? mandela_ekf_lanes : 1;
+    const int n_tasks = (config.n_runs + runs_per_task - 1)/runs_per_task;
+    if (n_threads > n_tasks) n_threads = n_tasks;
+
+    std::atomic<int> next_task(0), n_failed(0);
+    std::mutex out_mutex;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < n_threads; i++) {
+        workers.push_back(std::thread([&]() {
+            for (int task = next_task++; task < n_tasks; task = next_task++) {
+                const int first_run = task*runs_per_task;
+                const int n_runs = std::min(runs_per_task, config.n_runs - first_run);
+                if (batched) {
+                    run_block(config, chol_R, first_run, n_runs, summaries);
+                } else {
+                    run_one(config, chol_R, first_run, summaries[first_run]);
+                }
+                for (int run = first_run; run < first_run + n_runs; run++) {
+                    if (summaries[run].status != MANDELA_EKF_SUCCESS) n_failed++;
+                    if (out) {
+                        std::lock_guard<std::mutex> lock(out_mutex);
+                        write_summary(out, summaries[run]);
+                    }
+                }
+            }
+        }));
+    }
+    for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+
+    return n_failed;
+}
@@ -0,0 +1,53 @@
+// Monte Carlo campaign of the Mandela EKF: N independent truth (batch_reactor_plant) + EKF runs of
+// the experiment in Mandela_EKF_native_engine.m, with random sensor noise and a random initial
+// mismatch of the EKF, executed in parallel on a pool of threads.
+// Run i draws its random numbers from its own counter-based stream (counter_rng, key (seed, i)),
+// so the results do not depend on the number of threads or on the order in which runs finish.
+// In batched mode a task is a block of mandela_ekf_lanes consecutive runs, whose EKFs are stepped
+// together in lane layout (mandela_ekf_batch.hpp); the plants are still simulated one by one.
+
+#ifndef MONTE_CARLO_CAMPAIGN_HPP
+#define MONTE_CARLO_CAMPAIGN_HPP
+
+#include "batch_reactor_plant.hpp"
+#include "mandela_ekf.hpp"
+#include "mandela_ekf_batch.hpp"
+
+#include <cstdio>
+#include <stdint.h>
+
+struct monte_carlo_config {
+    mandela_ekf_config ekf;
+    batch_reactor_plant_config plant;
+    double X_init_truth[batch_reactor::n_diff];
+    double X_init_ekf[batch_reactor::n_diff];      // nominal initial estimate
+    double X_init_ekf_std[batch_reactor::n_diff];  // std. dev. of the random initial mismatch added to X_init_ekf
+    double P_init[batch_reactor::n_xz*batch_reactor::n_xz];
+    bool enable_sensor_noise;    // measurements = outputs + chol(R)'*randn
+    double tf;                   // the EKF is stepped while t < tf, as in the MATLAB scripts
+    int n_runs;
+    uint32_t seed;
+    int n_threads;               // <= 0: one per hardware thread
+    bool batched;                // step mandela_ekf_lanes runs at a time with one mandela_ekf_batch
+};
+
+// Per-run summary; the estimation errors are those of the differential states after the
+// measurement update, at every sample
+struct monte_carlo_run_summary {
+    int run;                           // 0-based
+    int status;                        // mandela_ekf_status of the run
+    int n_samples;                     // no. of EKF steps done
+    double rmse[batch_reactor::n_diff];
+    double mean_nees;                  // mean of e'*inv(P_xx)*e over the samples (expected: n_diff)
+    double max_nees;
+};
+
+// Runs the campaign and fills summaries[0..n_runs-1] (indexed by run). If out is not null, one
+// csv line per run (see monte_carlo_write_header) is written and flushed as soon as the run has
+// finished, i.e. in order of completion. Returns the no. of runs that failed, or
+// MANDELA_EKF_INVALID_CONFIG.
+int run_monte_carlo_campaign(const monte_carlo_config &config, std::FILE *out, monte_carlo_run_summary *summaries);
+
+void monte_carlo_write_header(std::FILE *out);
+
+#endif
@@ -0,0 +1,75 @@
+// Piecewise-constant process noise of the truth model (see process_noise.hpp)
+
+#include "process_noise.hpp"
+
+#include <cmath>
+
+piecewise_constant_noise::piecewise_constant_noise()
+    : rng_(0u, 0u), t0_(0.0), bin_width_(0.0), cached_bin_(-1)
+{
+    for (int i = 0; i < n_diff*n_diff; i++) L_[i] = 0.0;
+    for (int i = 0; i < n_diff; i++) w_[i] = 0.0;
+}
+
+int piecewise_constant_noise::init(const double *Q, double t0, double bin_width, uint32_t seed, uint32_t stream)
+{
+    if (!(bin_width > 0)) return -1;
+    rng_ = counter_rng::normal_stream(seed, stream);
+    t0_ = t0;
+    bin_width_ = bin_width;
+    cached_bin_ = -1;
+
+    // Cholesky factorisation of Q/bin_width that allows for zero pivots (states without noise):
+    // a pivot below the rounding level of the largest diagonal element gives a zero column
+    double d_max = 0.0;
+    for (int j = 0; j < n_diff; j++) {
+        if (Q[j + j*n_diff] > d_max) d_max = Q[j + j*n_diff];
+    }
+    const double tol = 1e-12*d_max;
+    for (int j = 0; j < n_diff; j++) {
+        double d = Q[j + j*n_diff];
+        for (int k = 0; k < j; k++) d -= L_[j + k*n_diff]*L_[j + k*n_diff];
+        if (!(d >= -tol)) return -1;
+        for (int i = 0; i < n_diff; i++) L_[i + j*n_diff] = 0.0;
+        if (d <= tol) continue;
+        d = std::sqrt(d);
+        L_[j + j*n_diff] = d;
+        for (int i = j + 1; i < n_diff; i++) {
+            double a = Q[i + j*n_diff];
+            for (int k = 0; k < j; k++) a -= L_[i + k*n_diff]*L_[j + k*n_diff];
+            L_[i + j*n_diff] = a/d;
+        }
+    }
+    const double scale = 1.0/std::sqrt(bin_width);
+    for (int i = 0; i < n_diff*n_diff; i++) L_[i] *= scale;
+    return 0;
+}
+
+// Bin of t, with a tolerance of 1e-9 bins at the edges (t0 + k*bin_width is not exact)
+long piecewise_constant_noise::bin(double t) const
+{
+    const long k = (long)std::ceil((t - t0_)/bin_width_ - 1e-9) - 1;
+    return (k > 0) ? k : 0;
+}
+
+const double *piecewise_constant_noise::eval(double t)
+{
+    const long k = bin(t);
+    if (k != cached_bin_) {
+        double z[n_diff];
+        rng_.draw(process_noise_rng_purpose, (uint32_t)k, n_diff, z);
+        for (int i = 0; i < n_diff; i++) {
+            double w = 0.0;
+            for (int j = 0; j <= i; j++) w += L_[i + j*n_diff]*z[j];
+            w_[i] = w;
+        }
+        cached_bin_ = k;
+    }
+    return w_;
+}
+
+double piecewise_constant_noise::next_edge(double t) const
+{
+    const double k = std::floor((t - t0_)/bin_width_ + 1e-9);
+    return t0_ + (k + 1.0)*bin_width_;
+}
@@ -0,0 +1,49 @@
+// Process noise of the truth model that is reproducible under adaptive stepping: piecewise-constant
+// samples w_k on the time bins (t0 + k*bin_width, t0 + (k+1)*bin_width], drawn from the
+// counter-based generator of counter_rng.hpp with the bin index k as sample index. w(t) is a pure
+// function of t, so the truth trajectory does not depend on the steps that IDA takes (nor on the
+// thread it runs on), unlike chol_Q*randn in the residual (see batchChemReactorModel.m). The
+// sample of the current bin is cached, so an evaluation in the IDA residual is a comparison.
+
+#ifndef PROCESS_NOISE_HPP
+#define PROCESS_NOISE_HPP
+
+#include "batch_reactor_model.hpp"
+#include "counter_rng.hpp"
+
+#include <stdint.h>
+
+// Purpose of the process noise in a stream of counter_rng::normal_stream (next to those of
+// monte_carlo_campaign.cpp, which shares its streams with the plants of its runs)
+const uint32_t process_noise_rng_purpose = 2u;
+
+class piecewise_constant_noise {
+public:
+    static const int n_diff = batch_reactor::n_diff;
+
+    piecewise_constant_noise();
+
+    // Q: n_diff x n_diff continuous-time intensity (positive semi-definite, e.g. zero for the
+    // states without noise). Bin k holds w_k = chol(Q/bin_width)*z_k, with z_k the normal numbers
+    // of sample k of the stream (seed, stream), so that the integral of w over a bin has
+    // covariance Q*bin_width. Returns 0, or -1 if Q is not positive semi-definite or
+    // bin_width <= 0.
+    int init(const double *Q, double t0, double bin_width, uint32_t seed, uint32_t stream);
+
+    // w(t) (n_diff); a bin edge belongs to the bin before it
+    const double *eval(double t);
+
+    // First bin edge after t (an integration that stops there never straddles a jump of w)
+    double next_edge(double t) const;
+
+private:
+    long bin(double t) const;
+
+    counter_rng::normal_stream rng_;
+    double t0_, bin_width_;
+    double L_[n_diff*n_diff];  // chol(Q/bin_width), lower triangular
+    long cached_bin_;          // bin of w_ (-1: none)
+    double w_[n_diff];
+};
+
+#endif
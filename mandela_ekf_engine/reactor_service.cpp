@@ -0,0 +1,247 @@
+// Estimator service for many reactors (see reactor_service.hpp).
+// POSIX only: on Windows reactor_service::run() returns MANDELA_EKF_INVALID_CONFIG.
+
+#include "reactor_service.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <thread>
+
+#ifndef _WIN32
+#include "line_reader.hpp"
+
+#include <csignal>
+#include <fcntl.h>
+#endif
+
+using namespace batch_reactor;
+
+reactor_service::reactor_service(const reactor_service_config &config)
+    : config_(config), filters_(config.max_reactors > 0 ? config.max_reactors : 0, (mandela_ekf *)NULL),
+      batch_(NULL), input_done_(false), timed_out_(false), n_malformed_(0)
+{
+    pool_.start(config_.n_threads);
+}
+
+reactor_service::~reactor_service()
+{
+    for (size_t i = 0; i < filters_.size(); i++) delete filters_[i];
+}
+
+int reactor_service::n_active() const
+{
+    int n = 0;
+    for (size_t i = 0; i < filters_.size(); i++) n += (filters_[i] != NULL);
+    return n;
+}
+
+// The samples of one reactor, in arrival order; only this task touches the filter of the reactor
+void reactor_service::process_reactor(int group)
+{
+    const double Ts = config_.ekf.Ts;
+    for (int j = group_start_[group]; j < group_start_[group + 1]; j++) {
+        reactor_sample &s = batch_[order_[j]];
+        mandela_ekf *&ekf = filters_[s.reactor];
+        s.processed = false;
+        if (s.reset) {
+            delete ekf;
+            ekf = NULL;
+            continue;
+        }
+        if (!ekf) {
+            ekf = new mandela_ekf();
+            const int status = ekf->init(config_.ekf, config_.X_init, config_.P_init);
+            if (status != MANDELA_EKF_SUCCESS) {
+                delete ekf;
+                ekf = NULL;
+                s.processed = true;
+                s.status = status;
+                s.t_est = s.t;
+                for (int i = 0; i < n_xz; i++) s.XZ[i] = s.sd[i] = std::numeric_limits<double>::quiet_NaN();
+                continue;
+            }
+        }
+        if (!(s.t > ekf->t() + 0.5*Ts)) continue;
+
+        // Prediction over the missing samples, then this sample
+        int status = MANDELA_EKF_SUCCESS;
+        while (status == MANDELA_EKF_SUCCESS && ekf->t() + 1.5*Ts < s.t) status = ekf->step(NULL, s.T_degC);
+        if (status == MANDELA_EKF_SUCCESS) status = ekf->step(s.measured ? s.y : NULL, s.T_degC);
+
+        s.processed = true;
+        s.status = status;
+        s.t_est = ekf->t();
+        for (int i = 0; i < n_xz; i++) {
+            s.XZ[i] = ekf->XZ()[i];
+            s.sd[i] = std::sqrt(ekf->P()[i + i*n_xz]);
+        }
+        if (status != MANDELA_EKF_SUCCESS) {  // re-created from the initial estimate at the next sample
+            delete ekf;
+            ekf = NULL;
+        }
+    }
+}
+
+void reactor_service::process_reactor_task(int group, void *context)
+{
+    static_cast<reactor_service *>(context)->process_reactor(group);
+}
+
+struct reactor_order {
+    const reactor_sample *samples;
+    bool operator()(int a, int b) const { return samples[a].reactor < samples[b].reactor; }
+};
+
+int reactor_service::process_batch(reactor_sample *samples, int n)
+{
+    // Group the samples by reactor (stable: the samples of a reactor stay in arrival order)
+    batch_ = samples;
+    order_.resize(n);
+    for (int i = 0; i < n; i++) order_[i] = i;
+    reactor_order by_reactor;
+    by_reactor.samples = samples;
+    std::stable_sort(order_.begin(), order_.end(), by_reactor);
+    group_start_.clear();
+    for (int j = 0; j < n; j++) {
+        if (j == 0 || samples[order_[j]].reactor != samples[order_[j - 1]].reactor) group_start_.push_back(j);
+    }
+    const int n_groups = (int)group_start_.size();
+    group_start_.push_back(n);
+
+    pool_.run(n_groups, process_reactor_task, this);
+    batch_ = NULL;
+    return n_groups;
+}
+
+#ifndef _WIN32
+
+// Reader thread: queues the samples as they arrive, until "end", the end of the input or the timeout
+void reactor_service::read_samples(int fd, int timeout_ms)
+{
+    const int n_out = config_.ekf.n_outputs;
+    line_reader reader(fd);
+    char *line;
+    reactor_sample s;
+    int r;
+    while ((r = reader.next(&line, &s.arrival, timeout_ms)) == 1) {
+        if (std::strncmp(line, "end", 3) == 0) break;
+        char *end;
+        s.reset = (std::strncmp(line, "reset", 5) == 0);
+        const char *p = s.reset ? line + 5 : line;
+        const long id = std::strtol(p, &end, 10);
+        bool ok = (end != p) && id >= 0 && id < (long)filters_.size();
+        if (ok && !s.reset) ok = parse_sample(end, n_out, &s.t, &s.T_degC, s.y, &s.measured);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!ok) {
+            n_malformed_++;
+            continue;
+        }
+        s.reactor = (int)id;
+        pending_.push_back(s);
+        cv_.notify_one();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    input_done_ = true;
+    timed_out_ = (r == -2);
+    cv_.notify_one();
+}
+
+int reactor_service::run(std::vector<reactor_batch_timing> &timing, reactor_service_summary &summary)
+{
+    summary.n_samples = 0;
+    summary.n_dropped = 0;
+    summary.n_failed = 0;
+    summary.max_latency_us = 0.0;
+    summary.timed_out = false;
+    if (filters_.empty() || config_.ekf.n_outputs < 1 || config_.ekf.n_outputs > mandela_ekf::n_y) return MANDELA_EKF_INVALID_CONFIG;
+
+    const int fd_in = open(config_.input_path, O_RDONLY);
+    if (fd_in < 0) return MANDELA_EKF_INVALID_CONFIG;
+    int fd_out = -1;
+    if (config_.output_path) {
+        fd_out = open(config_.output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_out < 0) {
+            close(fd_in);
+            return MANDELA_EKF_INVALID_CONFIG;
+        }
+    }
+    void (*old_sigpipe)(int) = std::signal(SIGPIPE, SIG_IGN);
+
+    input_done_ = false;
+    n_malformed_ = 0;
+    pending_.clear();
+    const int timeout_ms = (config_.idle_timeout_s > 0) ? (int)std::ceil(1000*config_.idle_timeout_s) : 0;
+    std::thread reader(&reactor_service::read_samples, this, fd_in, timeout_ms);
+
+    std::vector<reactor_sample> batch;
+    char out[2048];
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (pending_.empty() && !input_done_) cv_.wait(lock);
+            if (pending_.empty()) break;
+            batch.swap(pending_);  // everything that has arrived meanwhile is one batch
+        }
+
+        const int n = (int)batch.size();
+        const stream_clock::time_point start = stream_clock::now();
+        reactor_batch_timing bt;
+        bt.n_samples = n;
+        bt.n_reactors = process_batch(&batch[0], n);
+        bt.process_us = microseconds(start, stream_clock::now());
+        bt.max_latency_us = 0.0;
+
+        // Replies, in arrival order
+        for (int i = 0; i < n; i++) {
+            const reactor_sample &s = batch[i];
+            if (s.reset) continue;
+            if (!s.processed) {
+                summary.n_dropped++;
+                continue;
+            }
+            int len = std::snprintf(out, sizeof(out), "%d %.6f %d", s.reactor, s.t_est, s.status);
+            for (int k = 0; k < n_xz; k++) len += std::snprintf(out + len, sizeof(out) - len, " %.10g", s.XZ[k]);
+            for (int k = 0; k < n_xz; k++) len += std::snprintf(out + len, sizeof(out) - len, " %.6g", s.sd[k]);
+            const double latency_us = microseconds(s.arrival, stream_clock::now());
+            len += std::snprintf(out + len, sizeof(out) - len, " %.1f\n", latency_us);
+            if (fd_out >= 0 && !write_all(fd_out, out, len)) {
+                close(fd_out);
+                fd_out = -1;
+            }
+            summary.n_samples++;
+            if (s.status != MANDELA_EKF_SUCCESS) summary.n_failed++;
+            if (latency_us > bt.max_latency_us) bt.max_latency_us = latency_us;
+        }
+        if (bt.max_latency_us > summary.max_latency_us) summary.max_latency_us = bt.max_latency_us;
+        timing.push_back(bt);
+        batch.clear();
+    }
+    reader.join();
+    summary.n_dropped += n_malformed_;
+    summary.timed_out = timed_out_;
+
+    std::signal(SIGPIPE, old_sigpipe);
+    if (fd_out >= 0) close(fd_out);
+    close(fd_in);
+    return MANDELA_EKF_SUCCESS;
+}
+
+#else
+
+void reactor_service::read_samples(int, int)
+{
+}
+
+int reactor_service::run(std::vector<reactor_batch_timing> &, reactor_service_summary &summary)
+{
+    summary.n_samples = summary.n_dropped = summary.n_failed = 0;
+    summary.max_latency_us = 0.0;
+    summary.timed_out = false;
+    return MANDELA_EKF_INVALID_CONFIG;
+}
+
+#endif
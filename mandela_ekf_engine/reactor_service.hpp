@@ -0,0 +1,106 @@
+// Estimator service for many reactor vessels: a table of independent Mandela EKF instances (same
+// model and tuning, different states), fed with the samples of many reactors through one named
+// pipe. A reader thread queues the samples as they arrive; every cycle takes all the pending
+// samples as one batch, processes the reactors of the batch concurrently on a thread pool (the
+// samples of one reactor in order), and replies for every sample as soon as its batch is done.
+// So the larger the backlog, the larger the batches, and the cost of a cycle (wake-up, sorting,
+// output) is shared by all the reactors of the batch.
+//
+// Input: one line per sample or command
+//     id t T_degC y_1 ... y_n_outputs     sample of reactor id (0-based), as in measurement_stream.hpp
+//     reset id                            drops the filter of reactor id
+//     end                                 stops the service
+// A reactor's filter is created from the initial estimate of the configuration at its first sample
+// (and after a reset or a failed step). Samples that are not later than the estimate are dropped.
+// Output: one line per processed sample
+//     id t status XZ_1 ... XZ_n_xz sqrt(P_11) ... sqrt(P_n_xz,n_xz) latency_us
+
+#ifndef REACTOR_SERVICE_HPP
+#define REACTOR_SERVICE_HPP
+
+#include "mandela_ekf.hpp"
+#include "thread_pool.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+struct reactor_service_config {
+    mandela_ekf_config ekf;  // model and tuning of all the filters
+    double X_init[batch_reactor::n_diff];  // initial estimate of a new filter
+    double P_init[batch_reactor::n_xz*batch_reactor::n_xz];
+    int max_reactors;        // reactor ids are 0..max_reactors-1
+    int n_threads;           // <= 0: one per hardware thread
+    const char *input_path;  // named pipe with the samples
+    const char *output_path; // named pipe or file for the replies (null: none)
+    double idle_timeout_s;   // stop when no data arrives for this long (<= 0: wait for "end")
+};
+
+// One queued sample and, once processed, its estimate
+struct reactor_sample {
+    int reactor;
+    bool reset;       // "reset id" command
+    double t, T_degC, y[mandela_ekf_max_outputs];
+    bool measured;
+    std::chrono::steady_clock::time_point arrival;
+
+    bool processed;   // false: dropped (or a reset)
+    int status;       // mandela_ekf_status of the step
+    double t_est, XZ[batch_reactor::n_xz], sd[batch_reactor::n_xz];
+};
+
+struct reactor_batch_timing {
+    int n_samples;          // samples in the batch
+    int n_reactors;         // distinct reactors in the batch
+    double process_us;      // processing of the batch on the pool
+    double max_latency_us;  // latest reply of the batch, from the arrival of its sample
+};
+
+struct reactor_service_summary {
+    int n_samples;   // samples processed
+    int n_dropped;   // malformed samples, unknown ids and samples not later than the estimate
+    int n_failed;    // failed filter steps
+    double max_latency_us;
+    bool timed_out;
+};
+
+class reactor_service {
+public:
+    explicit reactor_service(const reactor_service_config &config);
+    ~reactor_service();
+
+    // Serves the input until "end", the end of the input or the idle timeout, and appends the
+    // timing of every batch. Returns MANDELA_EKF_INVALID_CONFIG if a stream could not be opened.
+    int run(std::vector<reactor_batch_timing> &timing, reactor_service_summary &summary);
+
+    // Processes samples[0..n-1] (a batch) and returns the no. of distinct reactors in it
+    int process_batch(reactor_sample *samples, int n);
+
+    int n_active() const;  // no. of reactors with a filter
+
+private:
+    reactor_service(const reactor_service &);
+    reactor_service &operator=(const reactor_service &);
+
+    void process_reactor(int group);
+    static void process_reactor_task(int group, void *context);
+    void read_samples(int fd, int timeout_ms);
+
+    reactor_service_config config_;
+    std::vector<mandela_ekf *> filters_;  // indexed by reactor id, null: no filter yet
+    thread_pool pool_;
+
+    // batch being processed, grouped by reactor
+    reactor_sample *batch_;
+    std::vector<int> order_, group_start_;
+
+    // samples queued by the reader thread
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<reactor_sample> pending_;
+    bool input_done_, timed_out_;
+    int n_malformed_;
+};
+
+#endif
@@ -0,0 +1,264 @@
+// Dense linear algebra kernels for the small, fixed-size matrices of the EKF.
+// All matrices are column-major (MATLAB layout): A(i,j) = A[i + j*rows]. Symmetric matrices
+// (covariances) may be kept in packed storage: the upper triangle column by column (the LAPACK
+// 'U' packed layout), A(i,j) = Ap[i + j*(j+1)/2] for i <= j, i.e. N*(N+1)/2 elements.
+// Dimensions are template arguments, so that every loop has a compile-time trip
+// count and no storage has to be allocated.
+
+#ifndef SMALL_DENSE_HPP
+#define SMALL_DENSE_HPP
+
+#include <cmath>
+
+namespace small_dense {
+
+template <int M, int N>
+inline void copy(const double *A, double *B)
+{
+    for (int i = 0; i < M*N; i++) B[i] = A[i];
+}
+
+template <int N>
+inline void identity(double *A)
+{
+    for (int i = 0; i < N*N; i++) A[i] = 0.0;
+    for (int i = 0; i < N; i++) A[i + i*N] = 1.0;
+}
+
+// C = A*B, with A (M x K) and B (K x N)
+template <int M, int K, int N>
+inline void mat_mul(const double *A, const double *B, double *C)
+{
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < M; i++) C[i + j*M] = 0.0;
+        for (int l = 0; l < K; l++) {
+            const double b = B[l + j*K];
+            for (int i = 0; i < M; i++) C[i + j*M] += A[i + l*M]*b;
+        }
+    }
+}
+
+// C = A*B', with A (M x K) and B (N x K)
+template <int M, int K, int N>
+inline void mat_mul_nt(const double *A, const double *B, double *C)
+{
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < M; i++) C[i + j*M] = 0.0;
+        for (int l = 0; l < K; l++) {
+            const double b = B[j + l*N];
+            for (int i = 0; i < M; i++) C[i + j*M] += A[i + l*M]*b;
+        }
+    }
+}
+
+// Infinity norm (max. row sum) of A (M x N)
+template <int M, int N>
+inline double norm_inf(const double *A)
+{
+    double nrm = 0.0;
+    for (int i = 0; i < M; i++) {
+        double row_sum = 0.0;
+        for (int j = 0; j < N; j++) row_sum += std::fabs(A[i + j*M]);
+        if (row_sum > nrm) nrm = row_sum;
+    }
+    return nrm;
+}
+
+// In-place LU factorisation with partial pivoting (LAPACK dgetrf convention, 0-based pivots).
+// Returns 0 on success and k+1 if U(k,k) is exactly zero.
+template <int N>
+inline int lu_factor(double *A, int *piv)
+{
+    int info = 0;
+    for (int k = 0; k < N; k++) {
+        int p = k;
+        double amax = std::fabs(A[k + k*N]);
+        for (int i = k + 1; i < N; i++) {
+            if (std::fabs(A[i + k*N]) > amax) {
+                amax = std::fabs(A[i + k*N]);
+                p = i;
+            }
+        }
+        piv[k] = p;
+        if (amax == 0.0) {
+            if (info == 0) info = k + 1;
+            continue;
+        }
+        if (p != k) {
+            for (int j = 0; j < N; j++) {
+                const double tmp = A[k + j*N];
+                A[k + j*N] = A[p + j*N];
+                A[p + j*N] = tmp;
+            }
+        }
+        const double inv_pivot = 1.0/A[k + k*N];
+        for (int i = k + 1; i < N; i++) A[i + k*N] *= inv_pivot;
+        for (int j = k + 1; j < N; j++) {
+            const double a_kj = A[k + j*N];
+            for (int i = k + 1; i < N; i++) A[i + j*N] -= A[i + k*N]*a_kj;
+        }
+    }
+    return info;
+}
+
+// Solves A*X = B in place (B is N x NRHS), given the output of lu_factor
+template <int N, int NRHS>
+inline void lu_solve(const double *LU, const int *piv, double *B)
+{
+    for (int r = 0; r < NRHS; r++) {
+        double *b = B + r*N;
+        for (int k = 0; k < N; k++) {
+            if (piv[k] != k) {
+                const double tmp = b[k];
+                b[k] = b[piv[k]];
+                b[piv[k]] = tmp;
+            }
+        }
+        for (int j = 0; j < N; j++) {
+            const double bj = b[j];
+            for (int i = j + 1; i < N; i++) b[i] -= LU[i + j*N]*bj;
+        }
+        for (int j = N - 1; j >= 0; j--) {
+            b[j] /= LU[j + j*N];
+            const double bj = b[j];
+            for (int i = 0; i < j; i++) b[i] -= LU[i + j*N]*bj;
+        }
+    }
+}
+
+// In-place Cholesky factorisation A = L*L' of a symmetric positive definite A (only the lower
+// triangle is read; the strict upper triangle is set to zero).
+// Returns 0 on success and k+1 if the leading minor of order k+1 is not positive definite.
+template <int N>
+inline int cholesky(double *A)
+{
+    for (int j = 0; j < N; j++) {
+        double d = A[j + j*N];
+        for (int k = 0; k < j; k++) d -= A[j + k*N]*A[j + k*N];
+        if (!(d > 0.0)) return j + 1;
+        d = std::sqrt(d);
+        A[j + j*N] = d;
+        for (int i = j + 1; i < N; i++) {
+            double a = A[i + j*N];
+            for (int k = 0; k < j; k++) a -= A[i + k*N]*A[j + k*N];
+            A[i + j*N] = a/d;
+        }
+        for (int i = 0; i < j; i++) A[i + j*N] = 0.0;
+    }
+    return 0;
+}
+
+// In-place triangularisation of a pre-array A (M x N, M >= N) by Householder reflections: A is
+// overwritten by the triangular factor R of A = Q*R (zero below the diagonal), i.e. qr1(A,0) of
+// the square-root EKF in Mandela_EKF_using_alg_measurement.m. Q is not formed; a right hand side
+// appended to A as a column is transformed with it. Zero rows (absent measurements) are allowed.
+// The diagonal of R may be negative.
+template <int M, int N>
+inline void qr_triangularise(double *A)
+{
+    for (int k = 0; k < N && k < M; k++) {
+        double *a_k = A + k*M;
+        double nrm = 0.0;
+        for (int i = k; i < M; i++) nrm += a_k[i]*a_k[i];
+        nrm = std::sqrt(nrm);
+        if (nrm == 0.0) continue;
+
+        // v = a_k(k:M-1) - alpha*e_1 with alpha = -sign(a_kk)*||a_k(k:M-1)|| (no cancellation), kept in
+        // a_k(k:M-1); then A(k:M-1,j) -= v*(2*v'*A(k:M-1,j)/(v'*v)), with v'*v = -2*alpha*v(0)
+        const double alpha = (a_k[k] > 0.0) ? -nrm : nrm;
+        a_k[k] -= alpha;
+        const double two_over_vtv = -1.0/(alpha*a_k[k]);
+        for (int j = k + 1; j < N; j++) {
+            double *a_j = A + j*M;
+            double s = 0.0;
+            for (int i = k; i < M; i++) s += a_k[i]*a_j[i];
+            s *= two_over_vtv;
+            for (int i = k; i < M; i++) a_j[i] -= s*a_k[i];
+        }
+        a_k[k] = alpha;
+        for (int i = k + 1; i < M; i++) a_k[i] = 0.0;
+    }
+}
+
+// Position of A(i,j) (either triangle) of a packed symmetric matrix
+inline int packed_index(int i, int j)
+{
+    return (i <= j) ? i + j*(j + 1)/2 : j + i*(i + 1)/2;
+}
+
+// Ap = upper triangle of A (N x N)
+template <int N>
+inline void sym_pack(const double *A, double *Ap)
+{
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i <= j; i++) Ap[i + j*(j + 1)/2] = A[i + j*N];
+    }
+}
+
+// A = the symmetric N x N matrix stored in Ap
+template <int N>
+inline void sym_unpack(const double *Ap, double *A)
+{
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i <= j; i++) {
+            A[i + j*N] = Ap[i + j*(j + 1)/2];
+            A[j + i*N] = Ap[i + j*(j + 1)/2];
+        }
+    }
+}
+
+// Bp += upper triangle of A (N x N)
+template <int N>
+inline void sym_add(const double *A, double *Bp)
+{
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i <= j; i++) Bp[i + j*(j + 1)/2] += A[i + j*N];
+    }
+}
+
+// C = A*P, with A (M x N) and P symmetric (N x N, packed)
+template <int M, int N>
+inline void sym_mul(const double *A, const double *Pp, double *C)
+{
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < M; i++) C[i + j*M] = 0.0;
+        for (int l = 0; l < N; l++) {
+            const double p = Pp[packed_index(l, j)];
+            for (int i = 0; i < M; i++) C[i + j*M] += A[i + l*M]*p;
+        }
+    }
+}
+
+// Cp = A*P*A', with A (M x N), P symmetric (N x N, packed) and C symmetric (M x M, packed).
+// Only the upper triangle of the second product is formed.
+template <int M, int N>
+inline void sym_congruence(const double *A, const double *Pp, double *Cp)
+{
+    double AP[M*N];
+    sym_mul<M, N>(A, Pp, AP);
+    for (int j = 0; j < M; j++) {
+        double *c = Cp + j*(j + 1)/2;
+        for (int i = 0; i <= j; i++) c[i] = 0.0;
+        for (int l = 0; l < N; l++) {
+            const double a = A[j + l*M];
+            for (int i = 0; i <= j; i++) c[i] += AP[i + l*M]*a;
+        }
+    }
+}
+
+// Symmetric rank-2k update Ap += X*Y' + Y*X' (upper triangle), with X and Y (N x K)
+template <int N, int K>
+inline void sym_rank_2k_update(const double *X, const double *Y, double *Ap)
+{
+    for (int j = 0; j < N; j++) {
+        double *a = Ap + j*(j + 1)/2;
+        for (int l = 0; l < K; l++) {
+            const double x_jl = X[j + l*N], y_jl = Y[j + l*N];
+            for (int i = 0; i <= j; i++) a[i] += X[i + l*N]*y_jl + Y[i + l*N]*x_jl;
+        }
+    }
+}
+
+} // namespace small_dense
+
+#endif
@@ -0,0 +1,70 @@
+// Fixed pool of worker threads for fork-join loops (see thread_pool.hpp)
+
+#include "thread_pool.hpp"
+
+#include <cstddef>
+
+thread_pool::thread_pool()
+    : stop_(false), generation_(0), active_(0), task_(NULL), context_(NULL), n_tasks_(0), next_task_(0)
+{
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (size_t i = 0; i < workers_.size(); i++) workers_[i].join();
+}
+
+void thread_pool::start(int n_threads)
+{
+    if (!workers_.empty()) return;
+    if (n_threads <= 0) n_threads = static_cast<int>(std::thread::hardware_concurrency());
+    for (int i = 1; i < n_threads; i++) workers_.push_back(std::thread(&thread_pool::worker_loop, this));
+}
+
+void thread_pool::work()
+{
+    for (int i = next_task_++; i < n_tasks_; i = next_task_++) task_(i, context_);
+}
+
+void thread_pool::worker_loop()
+{
+    unsigned long seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        while (!stop_ && generation_ == seen) start_cv_.wait(lock);
+        if (stop_) return;
+        seen = generation_;
+        lock.unlock();
+        work();
+        lock.lock();
+        if (--active_ == 0) done_cv_.notify_one();
+    }
+}
+
+void thread_pool::run(int n_tasks, task_fn task, void *context)
+{
+    if (workers_.empty() || n_tasks <= 1) {
+        for (int i = 0; i < n_tasks; i++) task(i, context);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = task;
+        context_ = context;
+        n_tasks_ = n_tasks;
+        next_task_ = 0;
+        active_ = static_cast<int>(workers_.size());
+        generation_++;
+    }
+    start_cv_.notify_all();
+    work();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (active_ > 0) done_cv_.wait(lock);
+}
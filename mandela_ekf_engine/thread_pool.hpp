@@ -0,0 +1,50 @@
+// Fixed pool of worker threads for fork-join loops (e.g. the propagation of the sigma points of
+// the UKF). The threads are started once; run() hands out the iterations of one loop and returns
+// when all of them are done, so that a loop does not create threads or allocate.
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class thread_pool {
+public:
+    typedef void (*task_fn)(int i, void *context);
+
+    thread_pool();
+    ~thread_pool();
+
+    // Starts n_threads - 1 workers (the thread calling run() is the n_threads-th);
+    // n_threads <= 0: one per hardware thread
+    void start(int n_threads);
+
+    int n_threads() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // Calls task(i, context) for i = 0..n_tasks-1, concurrently on the workers and the calling thread
+    void run(int n_tasks, task_fn task, void *context);
+
+private:
+    thread_pool(const thread_pool &);
+    thread_pool &operator=(const thread_pool &);
+
+    void work();
+    void worker_loop();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_, done_cv_;
+    bool stop_;
+    unsigned long generation_;  // incremented by every run()
+    int active_;                // workers that have not finished the current loop
+
+    task_fn task_;
+    void *context_;
+    int n_tasks_;
+    std::atomic<int> next_task_;
+};
+
+#endif
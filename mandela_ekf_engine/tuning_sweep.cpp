@@ -0,0 +1,143 @@
+// Tuning sweep of the Mandela EKF (see tuning_sweep.hpp)
+
+#include "tuning_sweep.hpp"
+#include "counter_rng.hpp"
+#include "small_dense.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <limits>
+
+using namespace batch_reactor;
+using namespace small_dense;
+
+static const int n_y = mandela_ekf::n_y;
+
+int record_truth_trajectory(const batch_reactor_plant_config &plant_config, const double *X_init,
+                            const mandela_ekf_config &ekf, double tf, const double *sensor_R,
+                            bool enable_sensor_noise, uint32_t seed, tuning_truth_trajectory &truth)
+{
+    const int n_out = ekf.n_outputs;
+    if (n_out < 1 || n_out > n_y || ekf.Ts != plant_config.Ts || ekf.t0 != plant_config.t0) return MANDELA_EKF_INVALID_CONFIG;
+    for (int i = 0; i < n_out; i++) {
+        if (ekf.output_index[i] < 0 || ekf.output_index[i] >= n_xz) return MANDELA_EKF_INVALID_CONFIG;
+    }
+
+    // Sensor noise chol(sensor_R)'*randn, with sensor_R padded to n_y x n_y
+    double chol_R[n_y*n_y];
+    identity<n_y>(chol_R);
+    for (int j = 0; j < n_out; j++) {
+        for (int i = 0; i < n_out; i++) chol_R[i + j*n_y] = sensor_R[i + j*n_out];
+    }
+    if (enable_sensor_noise && cholesky<n_y>(chol_R) != 0) return MANDELA_EKF_INVALID_CONFIG;
+    const counter_rng::normal_stream rng(seed, 0u);
+
+    truth.n_samples = 0;
+    truth.X.clear();
+    truth.y.clear();
+
+    batch_reactor_plant plant;
+    int status = plant.init(plant_config, X_init);
+    int k = 1;
+    for (double t = ekf.t0 + ekf.Ts; status == MANDELA_EKF_SUCCESS && t < tf; t += ekf.Ts, k++) {
+        status = plant.advance(t);
+        if (status != MANDELA_EKF_SUCCESS) break;
+
+        double y[n_y] = {0}, v[n_y];
+        for (int i = 0; i < n_out; i++) y[i] = plant.XZ()[ekf.output_index[i]];
+        if (enable_sensor_noise) {
+            rng.draw(0u, (uint32_t)k, n_out, v);
+            for (int i = 0; i < n_out; i++) {
+                for (int j = 0; j <= i; j++) y[i] += chol_R[i + j*n_y]*v[j];
+            }
+        }
+        truth.X.insert(truth.X.end(), plant.XZ(), plant.XZ() + n_diff);
+        truth.y.insert(truth.y.end(), y, y + n_y);
+        truth.n_samples++;
+    }
+    return status;
+}
+
+// Shared, read-only state of the sweep and the best cost so far
+struct tuning_sweep_context {
+    const tuning_sweep_config *config;
+    const tuning_truth_trajectory *truth;
+    const tuning_candidate *candidates;
+    tuning_result *results;
+    std::atomic<double> best_cost;
+};
+
+static void evaluate_candidate(int c, void *context)
+{
+    tuning_sweep_context &ctx = *static_cast<tuning_sweep_context *>(context);
+    const tuning_sweep_config &config = *ctx.config;
+    const tuning_truth_trajectory &truth = *ctx.truth;
+    tuning_result &result = ctx.results[c];
+
+    mandela_ekf_config ekf_config = config.ekf;
+    copy<n_diff, n_diff>(ctx.candidates[c].Q, ekf_config.Q);
+    for (int i = 0; i < n_y*n_y; i++) ekf_config.R[i] = ctx.candidates[c].R[i];
+    const input_profile &temperature_profile = ekf_config.temperature_profile;  // per-candidate copy, since it caches its last segment
+
+    result.n_samples = 0;
+    result.cost = 0.0;
+    result.aborted = false;
+
+    mandela_ekf ekf;
+    result.status = ekf.init(ekf_config, config.X_init_ekf, ctx.candidates[c].P_init);
+    for (int k = 0; result.status == MANDELA_EKF_SUCCESS && k < truth.n_samples; k++) {
+        const double t = ekf_config.t0 + (k + 1)*ekf_config.Ts;
+        result.status = ekf.step(&truth.y[k*n_y], temperature_profile.eval(t));
+        if (result.status != MANDELA_EKF_SUCCESS) break;
+
+        const double *X = &truth.X[k*n_diff];
+        for (int i = 0; i < n_diff; i++) {
+            const double e = ekf.XZ()[i] - X[i];
+            result.cost += config.cost_weights[i]*e*e;
+        }
+        result.n_samples++;
+        if (!(result.cost <= ctx.best_cost.load())) {  // also stops a NaN cost
+            result.aborted = true;
+            return;
+        }
+    }
+    if (result.status != MANDELA_EKF_SUCCESS) {
+        result.cost = std::numeric_limits<double>::infinity();
+        return;
+    }
+
+    double best = ctx.best_cost.load();
+    while (result.cost < best && !ctx.best_cost.compare_exchange_weak(best, result.cost)) {}
+}
+
+int run_tuning_sweep(const tuning_sweep_config &config, const tuning_truth_trajectory &truth,
+                     const tuning_candidate *candidates, int n_candidates, tuning_result *results)
+{
+    if (n_candidates < 1 || truth.n_samples < 1 ||
+        truth.X.size() != (size_t)truth.n_samples*n_diff || truth.y.size() != (size_t)truth.n_samples*n_y) {
+        return MANDELA_EKF_INVALID_CONFIG;
+    }
+
+    tuning_sweep_context ctx;
+    ctx.config = &config;
+    ctx.truth = &truth;
+    ctx.candidates = candidates;
+    ctx.results = results;
+    ctx.best_cost = std::numeric_limits<double>::infinity();
+
+    int n_threads = config.n_threads;
+    if (n_threads <= 0) n_threads = (int)std::thread::hardware_concurrency();
+    if (n_threads > n_candidates) n_threads = n_candidates;
+    thread_pool pool;
+    pool.start(n_threads);
+    pool.run(n_candidates, evaluate_candidate, &ctx);
+
+    int best = MANDELA_EKF_INVALID_CONFIG;
+    for (int c = 0; c < n_candidates; c++) {
+        if (results[c].status == MANDELA_EKF_SUCCESS && !results[c].aborted &&
+            (best < 0 || results[c].cost < results[best].cost)) {
+            best = c;
+        }
+    }
+    return best;
+}
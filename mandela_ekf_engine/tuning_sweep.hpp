@@ -0,0 +1,57 @@
+// Tuning sweep of the Mandela EKF: a set of (Q, R, P_init) candidates is evaluated in parallel
+// against one recorded truth trajectory (batch_reactor_plant with process noise, plus sensor
+// noise). The trajectory is recorded once and only read by the candidates.
+// The cost of a candidate is the weighted sum of squared estimation errors of the differential
+// states after the measurement updates. It can only grow, so a candidate is aborted as soon as
+// its running cost exceeds the best cost of the candidates that have finished. An aborted
+// candidate cannot be the best one, so the best candidate does not depend on the number of threads.
+
+#ifndef TUNING_SWEEP_HPP
+#define TUNING_SWEEP_HPP
+
+#include "batch_reactor_plant.hpp"
+#include "mandela_ekf.hpp"
+
+#include <stdint.h>
+#include <vector>
+
+// Truth and measurements at t0 + k*Ts, k = 1..n_samples
+struct tuning_truth_trajectory {
+    int n_samples;
+    std::vector<double> X;  // n_diff per sample
+    std::vector<double> y;  // mandela_ekf_max_outputs per sample (n_outputs used)
+};
+
+// Simulates the plant from X_init while t < tf and records the outputs config.output_index of
+// the EKF configuration, with sensor noise of covariance sensor_R (n_outputs x n_outputs) if
+// enable_sensor_noise (counter_rng stream (seed, 0)). Returns a mandela_ekf_status code.
+int record_truth_trajectory(const batch_reactor_plant_config &plant, const double *X_init,
+                            const mandela_ekf_config &ekf, double tf, const double *sensor_R,
+                            bool enable_sensor_noise, uint32_t seed, tuning_truth_trajectory &truth);
+
+struct tuning_candidate {
+    double Q[batch_reactor::n_diff*batch_reactor::n_diff];
+    double R[mandela_ekf_max_outputs*mandela_ekf_max_outputs];  // n_outputs x n_outputs
+    double P_init[batch_reactor::n_xz*batch_reactor::n_xz];
+};
+
+struct tuning_sweep_config {
+    mandela_ekf_config ekf;  // Q and R are those of the candidates
+    double X_init_ekf[batch_reactor::n_diff];
+    double cost_weights[batch_reactor::n_diff];  // weights of the squared errors of the states
+    int n_threads;           // <= 0: one per hardware thread
+};
+
+struct tuning_result {
+    int status;     // mandela_ekf_status of the candidate
+    int n_samples;  // no. of EKF steps done
+    double cost;    // (running) cost; infinite if the EKF failed
+    bool aborted;   // stopped early: its running cost had exceeded the best cost
+};
+
+// Evaluates candidates[0..n_candidates-1] and fills results (same indexing). Returns the index of
+// the best candidate, or MANDELA_EKF_INVALID_CONFIG (also if no candidate has succeeded).
+int run_tuning_sweep(const tuning_sweep_config &config, const tuning_truth_trajectory &truth,
+                     const tuning_candidate *candidates, int n_candidates, tuning_result *results);
+
+#endif
@@ -0,0 +1,357 @@
+// Discretisation of the linearised model with the block matrix exponential of Van Loan (1978):
+//
+//   expm([-A Qc; 0 A']*Ts) = [F11 F12; 0 F22],  phi = F22',  Qd = phi*F12
+//
+// where phi = expm(A*Ts) and Qd = int_0^Ts expm(A*t)*Qc*expm(A*t)' dt is the discrete-time
+// process noise covariance for the continuous-time noise intensity Qc = Gamma*Q*Gamma'.
+//
+// The exponentials are computed by scaling and squaring with the diagonal Pade approximants of
+// degree 3, 5, 7, 9 or 13 (Higham, SIAM J. Matrix Anal. Appl., 26(4), 2005). For the block
+// matrix, only the Pade step is done on [-A Qc; 0 A']*Ts/2^s (kept in block upper triangular
+// form, so that products and the solve only need N x N blocks). The squaring phase is then done
+// on the pair itself, phi(2h) = phi(h)^2 and Qd(2h) = phi(h)*Qd(h)*phi(h)' + Qd(h): squaring the
+// block matrix would go through F11 = expm(-A*Ts), which overflows for the stiff A*Ts of the
+// reactor model.
+// All matrices are column-major. The workspace is a member of the discretiser, so it is
+// allocated once per filter and re-used at every step.
+
+#ifndef VAN_LOAN_DISCRETISATION_HPP
+#define VAN_LOAN_DISCRETISATION_HPP
+
+#include "small_dense.hpp"
+
+#include <cmath>
+
+namespace van_loan {
+
+// N x N matrix
+template <int N>
+struct square_matrix {
+    double a[N*N];
+};
+
+// 2N x 2N block upper triangular matrix [X Y; 0 Z]
+template <int N>
+struct block_upper_matrix {
+    double X[N*N], Y[N*N], Z[N*N];
+};
+
+template <int N>
+inline void set_identity(square_matrix<N> &A, double alpha)
+{
+    for (int i = 0; i < N*N; i++) A.a[i] = 0.0;
+    for (int i = 0; i < N; i++) A.a[i + i*N] = alpha;
+}
+
+template <int N>
+inline void set_identity(block_upper_matrix<N> &A, double alpha)
+{
+    for (int i = 0; i < N*N; i++) { A.X[i] = 0.0; A.Y[i] = 0.0; A.Z[i] = 0.0; }
+    for (int i = 0; i < N; i++) { A.X[i + i*N] = alpha; A.Z[i + i*N] = alpha; }
+}
+
+// C = A*B
+template <int N>
+inline void mul(const square_matrix<N> &A, const square_matrix<N> &B, square_matrix<N> &C)
+{
+    small_dense::mat_mul<N, N, N>(A.a, B.a, C.a);
+}
+
+template <int N>
+inline void mul(const block_upper_matrix<N> &A, const block_upper_matrix<N> &B, block_upper_matrix<N> &C)
+{
+    double tmp[N*N];
+    small_dense::mat_mul<N, N, N>(A.X, B.X, C.X);
+    small_dense::mat_mul<N, N, N>(A.X, B.Y, C.Y);
+    small_dense::mat_mul<N, N, N>(A.Y, B.Z, tmp);
+    for (int i = 0; i < N*N; i++) C.Y[i] += tmp[i];
+    small_dense::mat_mul<N, N, N>(A.Z, B.Z, C.Z);
+}
+
+// C += alpha*A
+template <int N>
+inline void axpy(double alpha, const square_matrix<N> &A, square_matrix<N> &C)
+{
+    for (int i = 0; i < N*N; i++) C.a[i] += alpha*A.a[i];
+}
+
+template <int N>
+inline void axpy(double alpha, const block_upper_matrix<N> &A, block_upper_matrix<N> &C)
+{
+    for (int i = 0; i < N*N; i++) {
+        C.X[i] += alpha*A.X[i];
+        C.Y[i] += alpha*A.Y[i];
+        C.Z[i] += alpha*A.Z[i];
+    }
+}
+
+template <int N>
+inline void scale(double alpha, square_matrix<N> &A)
+{
+    for (int i = 0; i < N*N; i++) A.a[i] *= alpha;
+}
+
+template <int N>
+inline void scale(double alpha, block_upper_matrix<N> &A)
+{
+    for (int i = 0; i < N*N; i++) { A.X[i] *= alpha; A.Y[i] *= alpha; A.Z[i] *= alpha; }
+}
+
+// 1-norm (max. column sum)
+template <int N>
+inline double norm1(const square_matrix<N> &A)
+{
+    double nrm = 0.0;
+    for (int j = 0; j < N; j++) {
+        double col_sum = 0.0;
+        for (int i = 0; i < N; i++) col_sum += std::fabs(A.a[i + j*N]);
+        if (col_sum > nrm) nrm = col_sum;
+    }
+    return nrm;
+}
+
+template <int N>
+inline double norm1(const block_upper_matrix<N> &A)
+{
+    double nrm = 0.0;
+    for (int j = 0; j < N; j++) {
+        double col_sum_left = 0.0, col_sum_right = 0.0;
+        for (int i = 0; i < N; i++) {
+            col_sum_left  += std::fabs(A.X[i + j*N]);
+            col_sum_right += std::fabs(A.Y[i + j*N]) + std::fabs(A.Z[i + j*N]);
+        }
+        if (col_sum_left > nrm) nrm = col_sum_left;
+        if (col_sum_right > nrm) nrm = col_sum_right;
+    }
+    return nrm;
+}
+
+// B = D\B (D is overwritten by its LU factors). Returns 0 on success.
+template <int N>
+inline int solve(square_matrix<N> &D, square_matrix<N> &B)
+{
+    int piv[N];
+    if (small_dense::lu_factor<N>(D.a, piv) != 0) return -1;
+    small_dense::lu_solve<N, N>(D.a, piv, B.a);
+    return 0;
+}
+
+// [X Y; 0 Z] = [Dx Dy; 0 Dz]\[Bx By; 0 Bz], by block back substitution
+template <int N>
+inline int solve(block_upper_matrix<N> &D, block_upper_matrix<N> &B)
+{
+    int piv_x[N], piv_z[N];
+    double tmp[N*N];
+    if (small_dense::lu_factor<N>(D.X, piv_x) != 0) return -1;
+    if (small_dense::lu_factor<N>(D.Z, piv_z) != 0) return -1;
+    small_dense::lu_solve<N, N>(D.Z, piv_z, B.Z);
+    small_dense::mat_mul<N, N, N>(D.Y, B.Z, tmp);
+    for (int i = 0; i < N*N; i++) B.Y[i] -= tmp[i];
+    small_dense::lu_solve<N, N>(D.X, piv_x, B.Y);
+    small_dense::lu_solve<N, N>(D.X, piv_x, B.X);
+    return 0;
+}
+
+// Scaling and squaring with diagonal Pade approximants, for either of the matrix types above
+template <typename Matrix>
+class pade_expm {
+public:
+    pade_expm() : degree_(0), scaling_(0), norm_lo_(1.0), norm_hi_(0.0) {}
+
+    // E = expm(A). A is not modified. Returns 0 on success.
+    int compute(const Matrix &A, Matrix &E)
+    {
+        if (pade(A, E) != 0) return -1;
+        for (int k = 0; k < scaling_; k++) {
+            mul(E, E, tmp_);
+            E = tmp_;
+        }
+        return 0;
+    }
+
+    // E = expm(A/2^s), without the squaring phase. s is returned by scaling().
+    int pade(const Matrix &A, Matrix &E)
+    {
+        select_degree_and_scaling(norm1(A));
+
+        As_ = A;
+        if (scaling_ > 0) scale(std::ldexp(1.0, -scaling_), As_);
+
+        const double *b = coefficients(degree_);
+        mul(As_, As_, A2_);
+        if (degree_ == 13) {
+            mul(A2_, A2_, A4_);
+            mul(A4_, A2_, A6_);
+
+            // U = A*(A6*(b13*A6 + b11*A4 + b9*A2) + b7*A6 + b5*A4 + b3*A2 + b1*I)
+            set_identity(tmp_, 0.0);
+            axpy(b[13], A6_, tmp_); axpy(b[11], A4_, tmp_); axpy(b[9], A2_, tmp_);
+            mul(A6_, tmp_, V_);
+            axpy(b[7], A6_, V_); axpy(b[5], A4_, V_); axpy(b[3], A2_, V_);
+            set_identity(tmp_, b[1]);
+            axpy(1.0, tmp_, V_);
+            mul(As_, V_, U_);
+
+            // V = A6*(b12*A6 + b10*A4 + b8*A2) + b6*A6 + b4*A4 + b2*A2 + b0*I
+            set_identity(tmp_, 0.0);
+            axpy(b[12], A6_, tmp_); axpy(b[10], A4_, tmp_); axpy(b[8], A2_, tmp_);
+            mul(A6_, tmp_, V_);
+            axpy(b[6], A6_, V_); axpy(b[4], A4_, V_); axpy(b[2], A2_, V_);
+            set_identity(tmp_, b[0]);
+            axpy(1.0, tmp_, V_);
+        } else {
+            // U = A*sum(b(k+1)*A^(k-1), k odd), V = sum(b(k+1)*A^k, k even)
+            set_identity(tmp_, b[1]);
+            set_identity(V_, b[0]);
+            A4_ = A2_;  // running even power
+            for (int k = 2; k <= degree_; k += 2) {
+                axpy(b[k+1], A4_, tmp_);
+                axpy(b[k], A4_, V_);
+                if (k + 2 <= degree_) {
+                    mul(A4_, A2_, A6_);
+                    A4_ = A6_;
+                }
+            }
+            mul(As_, tmp_, U_);
+        }
+
+        // E = (V - U)\(V + U)
+        tmp_ = V_;
+        axpy(-1.0, U_, tmp_);
+        E = V_;
+        axpy(1.0, U_, E);
+        return solve(tmp_, E);
+    }
+
+    int degree() const { return degree_; }
+    int scaling() const { return scaling_; }
+
+private:
+    // The degree and the scaling only depend on the 1-norm of A. They are kept from one call to
+    // the next and only re-selected when the norm leaves the interval they were chosen for.
+    void select_degree_and_scaling(double nrm)
+    {
+        if (nrm >= norm_lo_ && nrm < norm_hi_) return;
+
+        static const int degrees[4] = {3, 5, 7, 9};
+        static const double theta[5] = {1.495585217958292e-2, 2.539398330063230e-1,
+                                        9.504178996162932e-1, 2.097847961257068e0,
+                                        5.371920351148152e0};
+        double lo = 0.0;
+        for (int i = 0; i < 4; i++) {
+            if (nrm <= theta[i]) {
+                degree_ = degrees[i];
+                scaling_ = 0;
+                norm_lo_ = lo;
+                norm_hi_ = theta[i];
+                return;
+            }
+            lo = theta[i];
+        }
+        degree_ = 13;
+        scaling_ = (nrm > theta[4]) ? static_cast<int>(std::ceil(std::log2(nrm/theta[4]))) : 0;
+        norm_lo_ = (scaling_ == 0) ? theta[3] : std::ldexp(theta[4], scaling_ - 1);
+        norm_hi_ = std::ldexp(theta[4], scaling_);
+        // the upper end of the interval is inclusive, so that exact powers of two are not re-selected
+        norm_hi_ = std::nextafter(norm_hi_, 2.0*norm_hi_);
+    }
+
+    static const double *coefficients(int degree)
+    {
+        static const double b3[]  = {120, 60, 12, 1};
+        static const double b5[]  = {30240, 15120, 3360, 420, 30, 1};
+        static const double b7[]  = {17297280, 8648640, 1995840, 277200, 25200, 1512, 56, 1};
+        static const double b9[]  = {17643225600., 8821612800., 2075673600., 302702400., 30270240.,
+                                     2162160., 110880., 3960., 90., 1.};
+        static const double b13[] = {64764752532480000., 32382376266240000., 7771770303897600.,
+                                     1187353796428800., 129060195264000., 10559470521600.,
+                                     670442572800., 33522128640., 1323241920., 40840800.,
+                                     960960., 16380., 182., 1.};
+        switch (degree) {
+            case 3:  return b3;
+            case 5:  return b5;
+            case 7:  return b7;
+            case 9:  return b9;
+            default: return b13;
+        }
+    }
+
+    int degree_, scaling_;
+    double norm_lo_, norm_hi_;
+    Matrix As_, A2_, A4_, A6_, U_, V_, tmp_;
+};
+
+// E = expm(A*Ts) of a dense N x N matrix
+template <int N>
+class dense_expm {
+public:
+    int compute(const double *A, double Ts, double *E)
+    {
+        for (int i = 0; i < N*N; i++) M_.a[i] = A[i]*Ts;
+        if (expm_.compute(M_, E_) != 0) return -1;
+        small_dense::copy<N, N>(E_.a, E);
+        return 0;
+    }
+
+    int scaling() const { return expm_.scaling(); }
+
+private:
+    square_matrix<N> M_, E_;
+    pade_expm<square_matrix<N> > expm_;
+};
+
+// phi = expm(A*Ts) and Qd = int_0^Ts expm(A*t)*Qc*expm(A*t)' dt from one block exponential
+template <int N>
+class discretiser {
+public:
+    int discretise(const double *A, const double *Qc, double Ts, double *phi, double *Qd)
+    {
+        for (int j = 0; j < N; j++) {
+            for (int i = 0; i < N; i++) {
+                M_.X[i + j*N] = -A[i + j*N]*Ts;
+                M_.Y[i + j*N] = Qc[i + j*N]*Ts;
+                M_.Z[i + j*N] = A[j + i*N]*Ts;
+            }
+        }
+        if (expm_.pade(M_, E_) != 0) return -1;
+
+        for (int j = 0; j < N; j++) {
+            for (int i = 0; i < N; i++) phi[i + j*N] = E_.Z[j + i*N];
+        }
+        small_dense::mat_mul<N, N, N>(phi, E_.Y, Qd);
+        symmetrise(Qd);
+
+        for (int k = 0; k < expm_.scaling(); k++) {
+            small_dense::mat_mul<N, N, N>(phi, Qd, tmp_);
+            small_dense::mat_mul_nt<N, N, N>(tmp_, phi, tmp2_);
+            for (int i = 0; i < N*N; i++) Qd[i] += tmp2_[i];
+            symmetrise(Qd);
+            small_dense::mat_mul<N, N, N>(phi, phi, tmp_);
+            small_dense::copy<N, N>(tmp_, phi);
+        }
+        return 0;
+    }
+
+    int scaling() const { return expm_.scaling(); }
+
+private:
+    // Qd is symmetric in exact arithmetic
+    static void symmetrise(double *Qd)
+    {
+        for (int j = 0; j < N; j++) {
+            for (int i = 0; i < j; i++) {
+                const double q = 0.5*(Qd[i + j*N] + Qd[j + i*N]);
+                Qd[i + j*N] = q;
+                Qd[j + i*N] = q;
+            }
+        }
+    }
+
+    block_upper_matrix<N> M_, E_;
+    double tmp_[N*N], tmp2_[N*N];
+    pade_expm<block_upper_matrix<N> > expm_;
+};
+
+} // namespace van_loan
+
+#endif
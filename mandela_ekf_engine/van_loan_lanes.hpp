@@ -0,0 +1,229 @@
+// Van Loan discretisation and matrix exponential of L linearised models at once, in the lane
+// layout of lane_dense.hpp. The matrix types below plug into van_loan::pade_expm, so the Pade
+// step is the one of van_loan_discretisation.hpp, with the kernels running across the lanes.
+// The degree and the scaling are common to all the lanes, selected from the largest 1-norm:
+// more squarings than a lane needs on its own only cost rounding at the level of eps.
+
+#ifndef VAN_LOAN_LANES_HPP
+#define VAN_LOAN_LANES_HPP
+
+#include "lane_dense.hpp"
+#include "van_loan_discretisation.hpp"
+
+namespace van_loan {
+
+template <int N, int L>
+struct lane_square_matrix {
+    double a[N*N*L];
+};
+
+template <int N, int L>
+struct lane_block_upper_matrix {
+    double X[N*N*L], Y[N*N*L], Z[N*N*L];
+};
+
+template <int N, int L>
+inline void set_identity(lane_square_matrix<N, L> &A, double alpha)
+{
+    for (int i = 0; i < N*N*L; i++) A.a[i] = 0.0;
+    for (int i = 0; i < N; i++) {
+        for (int l = 0; l < L; l++) A.a[(i + i*N)*L + l] = alpha;
+    }
+}
+
+template <int N, int L>
+inline void set_identity(lane_block_upper_matrix<N, L> &A, double alpha)
+{
+    for (int i = 0; i < N*N*L; i++) { A.X[i] = 0.0; A.Y[i] = 0.0; A.Z[i] = 0.0; }
+    for (int i = 0; i < N; i++) {
+        for (int l = 0; l < L; l++) { A.X[(i + i*N)*L + l] = alpha; A.Z[(i + i*N)*L + l] = alpha; }
+    }
+}
+
+template <int N, int L>
+inline void mul(const lane_square_matrix<N, L> &A, const lane_square_matrix<N, L> &B, lane_square_matrix<N, L> &C)
+{
+    lane_dense::mat_mul<N, N, N, L>(A.a, B.a, C.a);
+}
+
+template <int N, int L>
+inline void mul(const lane_block_upper_matrix<N, L> &A, const lane_block_upper_matrix<N, L> &B, lane_block_upper_matrix<N, L> &C)
+{
+    double tmp[N*N*L];
+    lane_dense::mat_mul<N, N, N, L>(A.X, B.X, C.X);
+    lane_dense::mat_mul<N, N, N, L>(A.X, B.Y, C.Y);
+    lane_dense::mat_mul<N, N, N, L>(A.Y, B.Z, tmp);
+    for (int i = 0; i < N*N*L; i++) C.Y[i] += tmp[i];
+    lane_dense::mat_mul<N, N, N, L>(A.Z, B.Z, C.Z);
+}
+
+template <int N, int L>
+inline void axpy(double alpha, const lane_square_matrix<N, L> &A, lane_square_matrix<N, L> &C)
+{
+    for (int i = 0; i < N*N*L; i++) C.a[i] += alpha*A.a[i];
+}
+
+template <int N, int L>
+inline void axpy(double alpha, const lane_block_upper_matrix<N, L> &A, lane_block_upper_matrix<N, L> &C)
+{
+    for (int i = 0; i < N*N*L; i++) {
+        C.X[i] += alpha*A.X[i];
+        C.Y[i] += alpha*A.Y[i];
+        C.Z[i] += alpha*A.Z[i];
+    }
+}
+
+template <int N, int L>
+inline void scale(double alpha, lane_square_matrix<N, L> &A)
+{
+    for (int i = 0; i < N*N*L; i++) A.a[i] *= alpha;
+}
+
+template <int N, int L>
+inline void scale(double alpha, lane_block_upper_matrix<N, L> &A)
+{
+    for (int i = 0; i < N*N*L; i++) { A.X[i] *= alpha; A.Y[i] *= alpha; A.Z[i] *= alpha; }
+}
+
+// Largest 1-norm of the lanes (NaNs of a failed lane are ignored)
+template <int N, int L>
+inline double norm1(const lane_square_matrix<N, L> &A)
+{
+    double col_sum[L], nrm[L];
+    for (int l = 0; l < L; l++) nrm[l] = 0.0;
+    for (int j = 0; j < N; j++) {
+        for (int l = 0; l < L; l++) col_sum[l] = 0.0;
+        for (int i = 0; i < N; i++) {
+            for (int l = 0; l < L; l++) col_sum[l] += std::fabs(A.a[(i + j*N)*L + l]);
+        }
+        for (int l = 0; l < L; l++) nrm[l] = (col_sum[l] > nrm[l]) ? col_sum[l] : nrm[l];
+    }
+    double nrm_max = 0.0;
+    for (int l = 0; l < L; l++) if (nrm[l] > nrm_max) nrm_max = nrm[l];
+    return nrm_max;
+}
+
+template <int N, int L>
+inline double norm1(const lane_block_upper_matrix<N, L> &A)
+{
+    double left[L], right[L], nrm[L];
+    for (int l = 0; l < L; l++) nrm[l] = 0.0;
+    for (int j = 0; j < N; j++) {
+        for (int l = 0; l < L; l++) { left[l] = 0.0; right[l] = 0.0; }
+        for (int i = 0; i < N; i++) {
+            const int ij = (i + j*N)*L;
+            for (int l = 0; l < L; l++) {
+                left[l]  += std::fabs(A.X[ij + l]);
+                right[l] += std::fabs(A.Y[ij + l]) + std::fabs(A.Z[ij + l]);
+            }
+        }
+        for (int l = 0; l < L; l++) {
+            nrm[l] = (left[l] > nrm[l]) ? left[l] : nrm[l];
+            nrm[l] = (right[l] > nrm[l]) ? right[l] : nrm[l];
+        }
+    }
+    double nrm_max = 0.0;
+    for (int l = 0; l < L; l++) if (nrm[l] > nrm_max) nrm_max = nrm[l];
+    return nrm_max;
+}
+
+// B = D\B of every lane; fails if any lane is singular
+template <int N, int L>
+inline int solve(lane_square_matrix<N, L> &D, lane_square_matrix<N, L> &B)
+{
+    int piv[N*L], info[L];
+    if (lane_dense::lu_factor<N, L>(D.a, piv, info) != 0) return -1;
+    lane_dense::lu_solve<N, N, L>(D.a, piv, B.a);
+    return 0;
+}
+
+template <int N, int L>
+inline int solve(lane_block_upper_matrix<N, L> &D, lane_block_upper_matrix<N, L> &B)
+{
+    int piv_x[N*L], piv_z[N*L], info[L];
+    double tmp[N*N*L];
+    if (lane_dense::lu_factor<N, L>(D.X, piv_x, info) != 0) return -1;
+    if (lane_dense::lu_factor<N, L>(D.Z, piv_z, info) != 0) return -1;
+    lane_dense::lu_solve<N, N, L>(D.Z, piv_z, B.Z);
+    lane_dense::mat_mul<N, N, N, L>(D.Y, B.Z, tmp);
+    for (int i = 0; i < N*N*L; i++) B.Y[i] -= tmp[i];
+    lane_dense::lu_solve<N, N, L>(D.X, piv_x, B.Y);
+    lane_dense::lu_solve<N, N, L>(D.X, piv_x, B.X);
+    return 0;
+}
+
+// E = expm(A*Ts) of every lane (see dense_expm)
+template <int N, int L>
+class lane_dense_expm {
+public:
+    int compute(const double *A, double Ts, double *E)
+    {
+        for (int i = 0; i < N*N*L; i++) M_.a[i] = A[i]*Ts;
+        if (expm_.compute(M_, E_) != 0) return -1;
+        lane_dense::copy<N, N, L>(E_.a, E);
+        return 0;
+    }
+
+private:
+    lane_square_matrix<N, L> M_, E_;
+    pade_expm<lane_square_matrix<N, L> > expm_;
+};
+
+// phi and Qd of every lane (see discretiser)
+template <int N, int L>
+class lane_discretiser {
+public:
+    int discretise(const double *A, const double *Qc, double Ts, double *phi, double *Qd)
+    {
+        for (int j = 0; j < N; j++) {
+            for (int i = 0; i < N; i++) {
+                for (int l = 0; l < L; l++) {
+                    M_.X[(i + j*N)*L + l] = -A[(i + j*N)*L + l]*Ts;
+                    M_.Y[(i + j*N)*L + l] = Qc[(i + j*N)*L + l]*Ts;
+                    M_.Z[(i + j*N)*L + l] = A[(j + i*N)*L + l]*Ts;
+                }
+            }
+        }
+        if (expm_.pade(M_, E_) != 0) return -1;
+
+        for (int j = 0; j < N; j++) {
+            for (int i = 0; i < N; i++) {
+                for (int l = 0; l < L; l++) phi[(i + j*N)*L + l] = E_.Z[(j + i*N)*L + l];
+            }
+        }
+        lane_dense::mat_mul<N, N, N, L>(phi, E_.Y, Qd);
+        symmetrise(Qd);
+
+        for (int k = 0; k < expm_.scaling(); k++) {
+            lane_dense::mat_mul<N, N, N, L>(phi, Qd, tmp_);
+            lane_dense::mat_mul_nt<N, N, N, L>(tmp_, phi, tmp2_);
+            for (int i = 0; i < N*N*L; i++) Qd[i] += tmp2_[i];
+            symmetrise(Qd);
+            lane_dense::mat_mul<N, N, N, L>(phi, phi, tmp_);
+            lane_dense::copy<N, N, L>(tmp_, phi);
+        }
+        return 0;
+    }
+
+private:
+    static void symmetrise(double *Qd)
+    {
+        for (int j = 0; j < N; j++) {
+            for (int i = 0; i < j; i++) {
+                for (int l = 0; l < L; l++) {
+                    const double q = 0.5*(Qd[(i + j*N)*L + l] + Qd[(j + i*N)*L + l]);
+                    Qd[(i + j*N)*L + l] = q;
+                    Qd[(j + i*N)*L + l] = q;
+                }
+            }
+        }
+    }
+
+    lane_block_upper_matrix<N, L> M_, E_;
+    double tmp_[N*N*L], tmp2_[N*N*L];
+    pade_expm<lane_block_upper_matrix<N, L> > expm_;
+};
+
+} // namespace van_loan
+
+#endif
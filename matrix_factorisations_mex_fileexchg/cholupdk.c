@@ -0,0 +1,335 @@
+/*
+ * Rank-k Cholesky update/downdate
+ *
+ * R1 = cholupdk(R,X)
+ * R1 = cholupdk(R,X,'+')
+ * R1 = cholupdk(R,X,'-')
+ * [R1,p] = cholupdk(R,X,'-')
+ *
+ * example compile command (see also make_factor.m):
+ * mex -O cholupdk.c
+ *
+ * R is the n-by-n upper triangular Cholesky factor of A = R'*R and X is
+ * an n-by-k matrix. All k columns of X are applied in a single sweep over
+ * the rows of R, i.e. R1'*R1 = R'*R + X*X' (update) or
+ * R1'*R1 = R'*R - X*X' (downdate). Plane rotations are used for the update
+ * and hyperbolic rotations for the downdate.
+ *
+ * The factor is held transposed in the workspace, so that every row of R
+ * is a contiguous column. For row j, the k rotations are first generated
+ * on the diagonal element and then applied to the trailing part of the row
+ * and of the k columns of X in blocks of CHOLUPDK_BLOCKSIZE elements. The
+ * inner loops are unit-stride and free of dependencies, so they are
+ * vectorized by the compiler.
+ *
+ * No BLAS/LAPACK functions are called.
+ */
+
+#include "mex.h"
+#include "factor.h"
+#include "matrix.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef CHOLUPDK_BLOCKSIZE
+#define CHOLUPDK_BLOCKSIZE 64
+#endif
+
+/* returns 0 on success, 1 if the downdated matrix is not positive definite
+ * and 2 if R has a zero diagonal element */
+static int cholupdk_kernel_double(double *Lt, double *W, double *pc, double *ps,
+        size_t n, size_t k, int downdate)
+{
+    size_t i, j, p, ib, iend;
+    double r, x, rn, c, s, t, w;
+    double *Lj, *Wp;
+
+    for (j=0; j<n; j++) {
+        Lj = Lt + j*n;
+        r = Lj[j];
+        if (r == 0) {
+            return 2;
+        }
+
+        /* generate the k rotations on the diagonal element */
+        for (p=0; p<k; p++) {
+            x = W[p*n + j];
+            if (downdate) {
+                if (fabs(x) >= fabs(r)) {
+                    return 1;
+                }
+                rn = sqrt((r - x)*(r + x));
+                pc[p] = rn/r;
+                ps[p] = x/r;
+            }
+            else {
+                rn = hypot(r, x);
+                pc[p] = r/rn;
+                ps[p] = x/rn;
+            }
+            r = rn;
+        }
+        Lj[j] = r;
+
+        /* apply them to the trailing part of row j, one block at a time */
+        for (ib=j+1; ib<n; ib+=CHOLUPDK_BLOCKSIZE) {
+            iend = min(ib + CHOLUPDK_BLOCKSIZE, n);
+            for (p=0; p<k; p++) {
+                c = pc[p];
+                s = ps[p];
+                Wp = W + p*n;
+                if (downdate) {
+                    for (i=ib; i<iend; i++) {
+                        t = (Lj[i] - s*Wp[i])/c;
+                        Wp[i] = c*Wp[i] - s*t;
+                        Lj[i] = t;
+                    }
+                }
+                else {
+                    for (i=ib; i<iend; i++) {
+                        t = Lj[i];
+                        w = Wp[i];
+                        Lj[i] = c*t + s*w;
+                        Wp[i] = c*w - s*t;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static int cholupdk_kernel_single(float *Lt, float *W, float *pc, float *ps,
+        size_t n, size_t k, int downdate)
+{
+    size_t i, j, p, ib, iend;
+    float r, x, rn, c, s, t, w;
+    float *Lj, *Wp;
+
+    for (j=0; j<n; j++) {
+        Lj = Lt + j*n;
+        r = Lj[j];
+        if (r == 0) {
+            return 2;
+        }
+
+        /* generate the k rotations on the diagonal element */
+        for (p=0; p<k; p++) {
+            x = W[p*n + j];
+            if (downdate) {
+                if (fabsf(x) >= fabsf(r)) {
+                    return 1;
+                }
+                rn = sqrtf((r - x)*(r + x));
+                pc[p] = rn/r;
+                ps[p] = x/r;
+            }
+            else {
+                rn = hypotf(r, x);
+                pc[p] = r/rn;
+                ps[p] = x/rn;
+            }
+            r = rn;
+        }
+        Lj[j] = r;
+
+        /* apply them to the trailing part of row j, one block at a time */
+        for (ib=j+1; ib<n; ib+=CHOLUPDK_BLOCKSIZE) {
+            iend = min(ib + CHOLUPDK_BLOCKSIZE, n);
+            for (p=0; p<k; p++) {
+                c = pc[p];
+                s = ps[p];
+                Wp = W + p*n;
+                if (downdate) {
+                    for (i=ib; i<iend; i++) {
+                        t = (Lj[i] - s*Wp[i])/c;
+                        Wp[i] = c*Wp[i] - s*t;
+                        Lj[i] = t;
+                    }
+                }
+                else {
+                    for (i=ib; i<iend; i++) {
+                        t = Lj[i];
+                        w = Wp[i];
+                        Lj[i] = c*t + s*w;
+                        Wp[i] = c*w - s*t;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+void cholupdk_double(int nlhs, mxArray *plhs[], size_t n, size_t k,
+        const mxArray *Rin, const mxArray *Xin, int downdate)
+{
+    double *Rpr, *Xpr, *R1pr, *Lt, *W, *pc, *ps;
+    size_t i, j, element_size = sizeof(double);
+    int status;
+
+    Rpr = mxGetData(Rin);
+    Xpr = mxGetData(Xin);
+
+    /* allocate workspace */
+    Lt = mxCalloc(n*n, element_size);
+    W = mxMalloc((k > 0 ? n*k : 1)*element_size);
+    pc = mxMalloc((k > 0 ? k : 1)*element_size);
+    ps = mxMalloc((k > 0 ? k : 1)*element_size);
+
+    /* copy the upper triangle of R transposed, so that rows are contiguous */
+    for (j=0; j<n; j++) {
+        for (i=0; i<=j; i++) {
+            Lt[i*n+j] = Rpr[j*n+i];
+        }
+    }
+    for (i=0; i<n*k; i++) {
+        W[i] = Xpr[i];
+    }
+
+    status = cholupdk_kernel_double(Lt, W, pc, ps, n, k, downdate);
+    mxFree(ps);
+    mxFree(pc);
+    mxFree(W);
+
+    if (status != 0 && nlhs < 2) {
+        mxFree(Lt);
+        if (status == 1) {
+            mexErrMsgTxt("Downdated matrix must be positive definite.");
+        }
+        else {
+            mexErrMsgTxt("R must be an upper triangular matrix with nonzero diagonal.");
+        }
+    }
+
+    /* extract upper triangular part (original R on failure) */
+    plhs[0] = mxCreateNumericMatrix(n,n,mxDOUBLE_CLASS,mxREAL);
+    R1pr = mxGetData(plhs[0]);
+    for (j=0; j<n; j++) {
+        for (i=0; i<=j; i++) {
+            R1pr[j*n+i] = (status == 0) ? Lt[i*n+j] : Rpr[j*n+i];
+        }
+    }
+    mxFree(Lt);
+
+    if (nlhs >= 2) {
+        plhs[1] = mxCreateDoubleScalar((double)status);
+    }
+}
+
+void cholupdk_single(int nlhs, mxArray *plhs[], size_t n, size_t k,
+        const mxArray *Rin, const mxArray *Xin, int downdate)
+{
+    float *Rpr, *Xpr, *R1pr, *Lt, *W, *pc, *ps;
+    size_t i, j, element_size = sizeof(float);
+    int status;
+
+    Rpr = mxGetData(Rin);
+    Xpr = mxGetData(Xin);
+
+    /* allocate workspace */
+    Lt = mxCalloc(n*n, element_size);
+    W = mxMalloc((k > 0 ? n*k : 1)*element_size);
+    pc = mxMalloc((k > 0 ? k : 1)*element_size);
+    ps = mxMalloc((k > 0 ? k : 1)*element_size);
+
+    /* copy the upper triangle of R transposed, so that rows are contiguous */
+    for (j=0; j<n; j++) {
+        for (i=0; i<=j; i++) {
+            Lt[i*n+j] = Rpr[j*n+i];
+        }
+    }
+    for (i=0; i<n*k; i++) {
+        W[i] = Xpr[i];
+    }
+
+    status = cholupdk_kernel_single(Lt, W, pc, ps, n, k, downdate);
+    mxFree(ps);
+    mxFree(pc);
+    mxFree(W);
+
+    if (status != 0 && nlhs < 2) {
+        mxFree(Lt);
+        if (status == 1) {
+            mexErrMsgTxt("Downdated matrix must be positive definite.");
+        }
+        else {
+            mexErrMsgTxt("R must be an upper triangular matrix with nonzero diagonal.");
+        }
+    }
+
+    /* extract upper triangular part (original R on failure) */
+    plhs[0] = mxCreateNumericMatrix(n,n,mxSINGLE_CLASS,mxREAL);
+    R1pr = mxGetData(plhs[0]);
+    for (j=0; j<n; j++) {
+        for (i=0; i<=j; i++) {
+            R1pr[j*n+i] = (status == 0) ? Lt[i*n+j] : Rpr[j*n+i];
+        }
+    }
+    mxFree(Lt);
+
+    if (nlhs >= 2) {
+        plhs[1] = mxCreateDoubleScalar((double)status);
+    }
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    size_t n, k;
+    int downdate = 0;
+
+    /* check for proper number of arguments */
+    if (nrhs != 2 && nrhs != 3) {
+        mexErrMsgTxt("CHOLUPDK requires two or three input arguments.");
+    }
+    if (nlhs > 2) {
+        mexErrMsgTxt("Too many output arguments.");
+    }
+    if (!mxIsNumeric(prhs[0]) || mxIsSparse(prhs[0]) || mxIsComplex(prhs[0]) ||
+        !mxIsNumeric(prhs[1]) || mxIsSparse(prhs[1]) || mxIsComplex(prhs[1])) {
+        mexErrMsgTxt( "Inputs must be full real matrices." );
+    }
+    if (mxGetClassID(prhs[0]) != mxGetClassID(prhs[1])) {
+        mexErrMsgTxt( "R and X must be of the same class." );
+    }
+
+    /* check dimensions */
+    n = mxGetM(prhs[0]);
+    if (mxGetN(prhs[0]) != n) {
+        mexErrMsgTxt( "R must be a square matrix." );
+    }
+    if (mxGetM(prhs[1]) != n) {
+        mexErrMsgTxt( "X must have as many rows as R." );
+    }
+    k = mxGetN(prhs[1]);
+
+    /* check update/downdate flag */
+    if (nrhs == 3) {
+        if (mxIsChar(prhs[2])) {
+            char *str = mxArrayToString(prhs[2]);
+            if (strcmp(str,"-") == 0) {
+                downdate = 1;
+            }
+            else if (strcmp(str,"+") != 0) {
+                mxFree(str);
+                mexErrMsgTxt( "Third input must be '+' or '-'." );
+            }
+            mxFree(str);
+        }
+        else {
+            mexErrMsgTxt( "Third input must be '+' or '-'." );
+        }
+    }
+
+    if (mxIsDouble(prhs[0])) {
+        cholupdk_double(nlhs, plhs, n, k, prhs[0], prhs[1], downdate);
+    }
+    else if (mxIsSingle(prhs[0])) {
+        cholupdk_single(nlhs, plhs, n, k, prhs[0], prhs[1], downdate);
+    }
+    else {
+        mexErrMsgTxt( "Class is not supported." );
+    }
+}
@@ -0,0 +1,20 @@
+%CHOLUPDK Rank-k update or downdate of a Cholesky factorization.
+%   R1 = CHOLUPDK(R,X), where R is the n-by-n upper triangular Cholesky
+%   factor of A = R'*R and X is an n-by-k matrix, returns the upper
+%   triangular Cholesky factor of A + X*X'. All k columns of X are applied
+%   in one sweep over R, which is equivalent to (but cheaper than) calling
+%   CHOLUPDATE once for every column of X.
+%
+%   R1 = CHOLUPDK(R,X,'+') is the same as R1 = CHOLUPDK(R,X).
+%
+%   R1 = CHOLUPDK(R,X,'-') returns the Cholesky factor of A - X*X'. An
+%   error message is reported if R is not a valid Cholesky factor or if
+%   the downdated matrix is not positive definite.
+%
+%   [R1,p] = CHOLUPDK(R,X,'-') will not return an error message. If p is 0
+%   then R1 is the Cholesky factor of A - X*X'. If p is greater than zero,
+%   then R1 is the Cholesky factor of the original A. If p is 1, CHOLUPDK
+%   failed because the downdated matrix is not positive definite. If p is 2,
+%   CHOLUPDK failed because R has a zero diagonal element.
+%
+%   See also CHOLUPDATE, CHOL, QR1.
\ No newline at end of file
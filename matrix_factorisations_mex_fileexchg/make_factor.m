@@ -1,4 +1,4 @@
-%MAKE_FACTOR Compilation of QR/QL/LQ/RQ mex-files
+%MAKE_FACTOR Compilation of QR/QL/LQ/RQ and CHOLUPDK mex-files
 MATLAB_PATH = matlabroot;
 COMPILE_OPTIONS = '';
 v = ver('matlab');
@@ -81,3 +81,5 @@ disp('Compiling rq...')
 eval(['mex ', COMPILE_OPTIONS, ' rq.c', BLAS_PATH, LAPACK_PATH]);
 disp('Compiling qr1...')
 eval(['mex ', COMPILE_OPTIONS, ' qr1.c', BLAS_PATH, LAPACK_PATH]);
+disp('Compiling cholupdk...')
+eval(['mex ', COMPILE_OPTIONS, ' cholupdk.c']);